@@ -0,0 +1,175 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChangePlan.h"
+#include "HelperAction.h"
+
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QTemporaryDir>
+#include <QTest>
+
+static bool writeFile(const QString& path, const QByteArray& contents)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(contents) == contents.size();
+}
+
+class ChangePlanTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void compute();
+    void helperChanges();
+    void operationName();
+    void describe();
+private:
+    QVector<PlannedChange> plan() const;
+
+    QTemporaryDir* dir = 0;
+    QString sldDir;
+    QString channelDir;
+};
+
+void ChangePlanTest::init()
+{
+    dir = new QTemporaryDir();
+    QVERIFY(dir->isValid());
+    sldDir = dir->path() + QLatin1String("/sources.list.d");
+    channelDir = dir->path() + QLatin1String("/channels");
+    QVERIFY(QDir().mkpath(sldDir));
+    QVERIFY(QDir().mkpath(channelDir));
+
+    const QStringList names = QStringList() << QStringLiteral("new") << QStringLiteral("enabled") << QStringLiteral("reformatted")
+        << QStringLiteral("conflicting") << QStringLiteral("replaced") << QStringLiteral("disabled") << QStringLiteral("gone")
+        << QStringLiteral("taken");
+    for(const QString& name : names) {
+        QVERIFY(writeFile(QString("%1/%2.list").arg(channelDir).arg(name), QString("deb http://example.com/%1 stable main\n").arg(name).toUtf8()));
+    }
+    QVERIFY(QFile::copy(channelDir + QLatin1String("/enabled.list"), sldDir + QLatin1String("/enabled.list")));
+    // The same sources, written differently
+    QVERIFY(writeFile(sldDir + QLatin1String("/reformatted.list"), "# Added by hand\ndeb   http://example.com/reformatted/  stable  main\n"));
+    QVERIFY(writeFile(sldDir + QLatin1String("/conflicting.list"), "deb http://example.org/conflicting stable main\n"));
+    QVERIFY(writeFile(sldDir + QLatin1String("/replaced.list"), "deb http://example.org/replaced stable main\n"));
+    QVERIFY(writeFile(sldDir + QLatin1String("/taken.list"), "deb http://example.org/taken stable main\n"));
+    // Neither has any sources in it, which makes them nothing alike, rather than the same
+    QVERIFY(writeFile(channelDir + QLatin1String("/empty.list"), "# Nothing to see here\n"));
+    QVERIFY(writeFile(sldDir + QLatin1String("/empty.list"), "# Something else entirely\nnot a source at all\n"));
+}
+
+void ChangePlanTest::cleanup()
+{
+    delete dir;
+    dir = 0;
+}
+
+QVector<PlannedChange> ChangePlanTest::plan() const
+{
+    QVariantMap changes;
+    changes[channelDir + QLatin1String("/new.list")] = int(Qt::Checked);
+    changes[channelDir + QLatin1String("/enabled.list")] = int(Qt::Checked);
+    changes[channelDir + QLatin1String("/reformatted.list")] = int(Qt::Unchecked);
+    changes[channelDir + QLatin1String("/conflicting.list")] = int(Qt::Unchecked);
+    changes[channelDir + QLatin1String("/replaced.list")] = HelperAction::ReplaceInstalled;
+    changes[channelDir + QLatin1String("/disabled.list")] = int(Qt::Unchecked);
+    changes[channelDir + QLatin1String("/gone.list")] = HelperAction::ReplaceInstalled;
+    changes[channelDir + QLatin1String("/taken.list")] = int(Qt::Checked);
+    changes[channelDir + QLatin1String("/empty.list")] = int(Qt::Unchecked);
+    return ChangePlan::compute(sldDir, changes);
+}
+
+void ChangePlanTest::compute()
+{
+    const QVector<PlannedChange> changes = plan();
+    QCOMPARE(changes.count(), 9);
+    QHash<QString, PlannedChange> byName;
+    for(const PlannedChange& change : changes) {
+        const QString name = change.channelPath.split("/").last();
+        QCOMPARE(change.targetPath, QString("%1/%2").arg(sldDir).arg(name));
+        byName.insert(name, change);
+    }
+
+    QCOMPARE(byName.value(QStringLiteral("new.list")).operation, PlannedChange::Install);
+    // Already installed, byte for byte
+    QCOMPARE(byName.value(QStringLiteral("enabled.list")).operation, PlannedChange::Unchanged);
+    // Installed with different formatting is still the channel's own file to remove
+    QCOMPARE(byName.value(QStringLiteral("reformatted.list")).operation, PlannedChange::Remove);
+    QVERIFY(byName.value(QStringLiteral("reformatted.list")).disabling);
+    // Somebody else's file by the same name is never removed
+    QCOMPARE(byName.value(QStringLiteral("conflicting.list")).operation, PlannedChange::Blocked);
+    QVERIFY(byName.value(QStringLiteral("conflicting.list")).disabling);
+    QCOMPARE(byName.value(QStringLiteral("replaced.list")).operation, PlannedChange::Replace);
+    QCOMPARE(byName.value(QStringLiteral("disabled.list")).operation, PlannedChange::Unchanged);
+    QVERIFY(byName.value(QStringLiteral("disabled.list")).disabling);
+    // Whatever was in the way went away in the meantime
+    QCOMPARE(byName.value(QStringLiteral("gone.list")).operation, PlannedChange::Install);
+    QCOMPARE(byName.value(QStringLiteral("taken.list")).operation, PlannedChange::Blocked);
+    QVERIFY(!byName.value(QStringLiteral("taken.list")).disabling);
+    QCOMPARE(byName.value(QStringLiteral("empty.list")).operation, PlannedChange::Blocked);
+}
+
+void ChangePlanTest::helperChanges()
+{
+    QVariantMap expected;
+    expected[channelDir + QLatin1String("/new.list")] = int(Qt::Checked);
+    expected[channelDir + QLatin1String("/reformatted.list")] = int(Qt::Unchecked);
+    expected[channelDir + QLatin1String("/replaced.list")] = HelperAction::ReplaceInstalled;
+    expected[channelDir + QLatin1String("/gone.list")] = int(Qt::Checked);
+    QCOMPARE(ChangePlan::helperChanges(plan()), expected);
+
+    // Asking for something which is already the case comes down to nothing at all
+    QVariantMap changes;
+    changes[channelDir + QLatin1String("/enabled.list")] = int(Qt::Checked);
+    changes[channelDir + QLatin1String("/disabled.list")] = int(Qt::Unchecked);
+    QVERIFY(ChangePlan::helperChanges(ChangePlan::compute(sldDir, changes)).isEmpty());
+
+    // As does anything the helper would refuse
+    changes.clear();
+    changes[channelDir + QLatin1String("/new.list")] = 42;
+    const QVector<PlannedChange> refused = ChangePlan::compute(sldDir, changes);
+    QCOMPARE(refused.count(), 1);
+    QCOMPARE(refused.first().operation, PlannedChange::Blocked);
+    QVERIFY(ChangePlan::helperChanges(refused).isEmpty());
+}
+
+void ChangePlanTest::operationName()
+{
+    QCOMPARE(ChangePlan::operationName(PlannedChange::Install), QStringLiteral("install"));
+    QCOMPARE(ChangePlan::operationName(PlannedChange::Replace), QStringLiteral("replace"));
+    QCOMPARE(ChangePlan::operationName(PlannedChange::Remove), QStringLiteral("remove"));
+    QCOMPARE(ChangePlan::operationName(PlannedChange::Unchanged), QStringLiteral("unchanged"));
+    QCOMPARE(ChangePlan::operationName(PlannedChange::Blocked), QStringLiteral("blocked"));
+}
+
+void ChangePlanTest::describe()
+{
+    for(const PlannedChange& change : plan()) {
+        const QString description = ChangePlan::describe(change);
+        QVERIFY2(description.contains(change.targetPath), qPrintable(description));
+    }
+}
+
+QTEST_GUILESS_MAIN(ChangePlanTest)
+
+#include "ChangePlanTest.moc"
@@ -0,0 +1,194 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChannelManifest.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+static bool writeFile(const QString& path, const QByteArray& contents)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(contents) == contents.size();
+}
+
+static const char listContents[] =
+    "# Example\n"
+    "# An example channel\n"
+    "deb [signed-by=/etc/apt/keyrings/example.gpg] http://example.com/debian stable main\n"
+    "deb-src [signed-by=/etc/apt/keyrings/example.gpg] http://example.com/debian stable main\n";
+
+static const char sourcesContents[] =
+    "Types: deb\n"
+    "URIs: http://example.com/one\n"
+    "Suites: stable\n"
+    "Components: main\n"
+    "Signed-By: /etc/apt/keyrings/one.gpg\n"
+    "\n"
+    "Types: deb\n"
+    "URIs: http://example.com/two\n"
+    "Suites: stable\n"
+    "Components: main\n"
+    "Signed-By: /etc/apt/keyrings/two.gpg\n";
+
+class ChannelManifestTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void describe();
+    void describeMissing();
+    void generateAndLoad();
+    void keyrings();
+    void noManifest();
+    void unreadableManifest_data();
+    void unreadableManifest();
+    void unsafeNames();
+private:
+    QTemporaryDir* dir = 0;
+};
+
+void ChannelManifestTest::init()
+{
+    dir = new QTemporaryDir();
+    QVERIFY(dir->isValid());
+    QVERIFY(writeFile(dir->path() + QLatin1String("/example.list"), listContents));
+    QVERIFY(writeFile(dir->path() + QLatin1String("/other.sources"), sourcesContents));
+    QVERIFY(QDir().mkpath(dir->path() + QLatin1String("/keyrings")));
+    QVERIFY(writeFile(dir->path() + QLatin1String("/keyrings/example.gpg"), "not really a keyring"));
+}
+
+void ChannelManifestTest::cleanup()
+{
+    delete dir;
+    dir = 0;
+}
+
+void ChannelManifestTest::describe()
+{
+    const ManifestEntry entry = ChannelManifest::describe(dir->path() + QLatin1String("/example.list"));
+    QCOMPARE(entry.file, QStringLiteral("example.list"));
+    QCOMPARE(entry.title, QStringLiteral("Example"));
+    QCOMPARE(entry.description, QStringLiteral("An example channel"));
+    QCOMPARE(entry.sha256, QCryptographicHash::hash(listContents, QCryptographicHash::Sha256));
+    QCOMPARE(entry.signingKey, QStringLiteral("/etc/apt/keyrings/example.gpg"));
+
+    // No comments to take a title from, and sources which do not agree on a keyring
+    const ManifestEntry other = ChannelManifest::describe(dir->path() + QLatin1String("/other.sources"));
+    QCOMPARE(other.file, QStringLiteral("other.sources"));
+    QVERIFY(other.title.isEmpty());
+    QVERIFY(other.description.isEmpty());
+    QVERIFY(other.signingKey.isEmpty());
+}
+
+void ChannelManifestTest::describeMissing()
+{
+    const ManifestEntry entry = ChannelManifest::describe(dir->path() + QLatin1String("/missing.list"));
+    QCOMPARE(entry.file, QStringLiteral("missing.list"));
+    QVERIFY(entry.sha256.isEmpty());
+}
+
+void ChannelManifestTest::generateAndLoad()
+{
+    // Neither an existing manifest nor its signature are channels
+    QVERIFY(writeFile(dir->path() + QLatin1String("/") + ChannelManifest::fileName(), "{}"));
+    QVERIFY(writeFile(dir->path() + QLatin1String("/") + ChannelManifest::signatureFileName(), "signature"));
+    QVERIFY(writeFile(dir->path() + QLatin1String("/") + ChannelManifest::fileName(), ChannelManifest::generate(dir->path())));
+
+    const QHash<QString, ManifestEntry> entries = ChannelManifest::load(dir->path());
+    QCOMPARE(entries.count(), 2);
+    QVERIFY(entries.contains(QStringLiteral("example.list")));
+    QVERIFY(entries.contains(QStringLiteral("other.sources")));
+
+    const ManifestEntry expected = ChannelManifest::describe(dir->path() + QLatin1String("/example.list"));
+    const ManifestEntry loaded = entries.value(QStringLiteral("example.list"));
+    QCOMPARE(loaded.file, expected.file);
+    QCOMPARE(loaded.title, expected.title);
+    QCOMPARE(loaded.description, expected.description);
+    QCOMPARE(loaded.sha256, expected.sha256);
+    QCOMPARE(loaded.signingKey, expected.signingKey);
+    QVERIFY(entries.value(QStringLiteral("other.sources")).signingKey.isEmpty());
+}
+
+void ChannelManifestTest::keyrings()
+{
+    QVERIFY(writeFile(dir->path() + QLatin1String("/") + ChannelManifest::fileName(), ChannelManifest::generate(dir->path())));
+    const QHash<QString, QByteArray> keyrings = ChannelManifest::loadKeyrings(dir->path());
+    QCOMPARE(keyrings.count(), 1);
+    QCOMPARE(keyrings.value(QStringLiteral("example.gpg")), QCryptographicHash::hash("not really a keyring", QCryptographicHash::Sha256));
+}
+
+void ChannelManifestTest::noManifest()
+{
+    QVERIFY(ChannelManifest::load(dir->path()).isEmpty());
+    QVERIFY(ChannelManifest::loadKeyrings(dir->path()).isEmpty());
+}
+
+void ChannelManifestTest::unreadableManifest_data()
+{
+    QTest::addColumn<QByteArray>("manifest");
+    QTest::newRow("not json") << QByteArray("channels: example.list");
+    QTest::newRow("not an object") << QByteArray("[]");
+    QTest::newRow("unknown version") << QByteArray("{\"version\": 2, \"channels\": [{\"file\": \"example.list\", \"title\": \"Example\"}]}");
+    QTest::newRow("no version") << QByteArray("{\"channels\": [{\"file\": \"example.list\", \"title\": \"Example\"}]}");
+}
+
+void ChannelManifestTest::unreadableManifest()
+{
+    QFETCH(QByteArray, manifest);
+    QVERIFY(writeFile(dir->path() + QLatin1String("/") + ChannelManifest::fileName(), manifest));
+    QVERIFY(ChannelManifest::load(dir->path()).isEmpty());
+    QVERIFY(ChannelManifest::loadKeyrings(dir->path()).isEmpty());
+}
+
+void ChannelManifestTest::unsafeNames()
+{
+    QVERIFY(writeFile(dir->path() + QLatin1String("/") + ChannelManifest::fileName(),
+        "{\"version\": 1,"
+        " \"channels\": ["
+        "  {\"file\": \"../../etc/passwd\", \"title\": \"Outside\"},"
+        "  {\"file\": \"\", \"title\": \"Nameless\"},"
+        "  {\"file\": \"index.json\", \"title\": \"Itself\"},"
+        "  {\"file\": \"index.json.sig\", \"title\": \"Its signature\"},"
+        "  {\"file\": \"example.list\", \"title\": \"Example\"}"
+        " ],"
+        " \"keyrings\": ["
+        "  {\"file\": \"../example.gpg\", \"sha256\": \"00\"},"
+        "  {\"file\": \"unhashed.gpg\"},"
+        "  {\"file\": \"example.gpg\", \"sha256\": \"0a0b\"}"
+        " ]"
+        "}"));
+    const QHash<QString, ManifestEntry> entries = ChannelManifest::load(dir->path());
+    QCOMPARE(QStringList(entries.keys()), QStringList() << QStringLiteral("example.list"));
+    QCOMPARE(entries.value(QStringLiteral("example.list")).title, QStringLiteral("Example"));
+
+    const QHash<QString, QByteArray> keyrings = ChannelManifest::loadKeyrings(dir->path());
+    QCOMPARE(QStringList(keyrings.keys()), QStringList() << QStringLiteral("example.gpg"));
+    QCOMPARE(keyrings.value(QStringLiteral("example.gpg")), QByteArray("\x0a\x0b"));
+}
+
+QTEST_GUILESS_MAIN(ChannelManifestTest)
+
+#include "ChannelManifestTest.moc"
@@ -0,0 +1,196 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LineDiff.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+// The text on one side of a diff: everything but what only the other side has
+static QStringList side(const QVector<DiffLine>& diff, DiffLine::Kind otherSide)
+{
+    QStringList lines;
+    for(const DiffLine& line : diff) {
+        if(line.kind != otherSide) {
+            lines << line.text;
+        }
+    }
+    return lines;
+}
+
+static int changeCount(const QVector<DiffLine>& diff)
+{
+    int count = 0;
+    for(const DiffLine& line : diff) {
+        if(line.kind != DiffLine::Unchanged) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+static QStringList numberedLines(int count)
+{
+    QStringList lines;
+    for(int i = 0; i < count; ++i) {
+        lines << QString("line %1").arg(i);
+    }
+    return lines;
+}
+
+class LineDiffTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void identical();
+    void empty();
+    void allAdded();
+    void allRemoved();
+    void changedLine();
+    void repeatedLines();
+    void scatteredChanges();
+    void veryDifferent();
+    void files();
+};
+
+void LineDiffTest::identical()
+{
+    const QStringList lines = QStringList() << QStringLiteral("a") << QStringLiteral("b") << QStringLiteral("c");
+    const QVector<DiffLine> diff = LineDiff::diff(lines, lines);
+    QCOMPARE(diff.count(), 3);
+    QCOMPARE(changeCount(diff), 0);
+    QCOMPARE(side(diff, DiffLine::Added), lines);
+}
+
+void LineDiffTest::empty()
+{
+    QVERIFY(LineDiff::diff(QStringList(), QStringList()).isEmpty());
+}
+
+void LineDiffTest::allAdded()
+{
+    const QStringList lines = QStringList() << QStringLiteral("a") << QStringLiteral("b");
+    const QVector<DiffLine> diff = LineDiff::diff(QStringList(), lines);
+    QCOMPARE(diff.count(), 2);
+    for(const DiffLine& line : diff) {
+        QCOMPARE(line.kind, DiffLine::Added);
+    }
+    QCOMPARE(side(diff, DiffLine::Removed), lines);
+}
+
+void LineDiffTest::allRemoved()
+{
+    const QStringList lines = QStringList() << QStringLiteral("a") << QStringLiteral("b");
+    const QVector<DiffLine> diff = LineDiff::diff(lines, QStringList());
+    QCOMPARE(diff.count(), 2);
+    for(const DiffLine& line : diff) {
+        QCOMPARE(line.kind, DiffLine::Removed);
+    }
+    QCOMPARE(side(diff, DiffLine::Added), lines);
+}
+
+void LineDiffTest::changedLine()
+{
+    const QStringList from = QStringList() << QStringLiteral("a") << QStringLiteral("b") << QStringLiteral("c");
+    const QStringList to = QStringList() << QStringLiteral("a") << QStringLiteral("x") << QStringLiteral("c");
+    const QVector<DiffLine> diff = LineDiff::diff(from, to);
+    QCOMPARE(diff.count(), 4);
+    QCOMPARE(changeCount(diff), 2);
+    QCOMPARE(diff.first().kind, DiffLine::Unchanged);
+    QCOMPARE(diff.last().kind, DiffLine::Unchanged);
+    QCOMPARE(side(diff, DiffLine::Added), from);
+    QCOMPARE(side(diff, DiffLine::Removed), to);
+}
+
+void LineDiffTest::repeatedLines()
+{
+    // Three lines in common, whichever way they are matched up
+    const QStringList from = QStringList() << QStringLiteral("a") << QStringLiteral("a") << QStringLiteral("b") << QStringLiteral("a");
+    const QStringList to = QStringList() << QStringLiteral("a") << QStringLiteral("b") << QStringLiteral("a") << QStringLiteral("a");
+    const QVector<DiffLine> diff = LineDiff::diff(from, to);
+    QCOMPARE(changeCount(diff), 2);
+    QCOMPARE(side(diff, DiffLine::Added), from);
+    QCOMPARE(side(diff, DiffLine::Removed), to);
+}
+
+void LineDiffTest::scatteredChanges()
+{
+    // Every seventh line taken out, and a new line put in after every eleventh one
+    const QStringList from = numberedLines(500);
+    QStringList to;
+    int expectedChanges = 0;
+    for(int i = 0; i < from.count(); ++i) {
+        if(i % 7 == 3) {
+            ++expectedChanges;
+        }
+        else {
+            to << from.at(i);
+        }
+        if(i % 11 == 5) {
+            to << QString("new line %1").arg(i);
+            ++expectedChanges;
+        }
+    }
+    const QVector<DiffLine> diff = LineDiff::diff(from, to);
+    QCOMPARE(changeCount(diff), expectedChanges);
+    QCOMPARE(side(diff, DiffLine::Added), from);
+    QCOMPARE(side(diff, DiffLine::Removed), to);
+}
+
+void LineDiffTest::veryDifferent()
+{
+    // Different enough for the search to be cut short, which may make the result longer than
+    // it needs to be, but never wrong
+    const QStringList from = numberedLines(5000);
+    QStringList to;
+    for(int i = 0; i < from.count(); ++i) {
+        to << (i % 3 ? QString("other line %1").arg(i) : from.at(i));
+    }
+    const QVector<DiffLine> diff = LineDiff::diff(from, to);
+    QVERIFY(changeCount(diff) >= 2 * (from.count() - from.count() / 3 - 1));
+    QCOMPARE(side(diff, DiffLine::Added), from);
+    QCOMPARE(side(diff, DiffLine::Removed), to);
+}
+
+void LineDiffTest::files()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.path() + QLatin1String("/example.list");
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("deb http://example.com/debian stable main\ndeb-src http://example.com/debian stable main\n");
+    file.close();
+
+    // The final newline does not make for an empty last line, and a missing file is empty
+    const QVector<DiffLine> diff = LineDiff::diffFiles(dir.path() + QLatin1String("/missing.list"), path);
+    QCOMPARE(diff.count(), 2);
+    QCOMPARE(changeCount(diff), 2);
+    QCOMPARE(side(diff, DiffLine::Removed), QStringList()
+        << QStringLiteral("deb http://example.com/debian stable main")
+        << QStringLiteral("deb-src http://example.com/debian stable main"));
+
+    QCOMPARE(changeCount(LineDiff::diffFiles(path, path)), 0);
+}
+
+QTEST_GUILESS_MAIN(LineDiffTest)
+
+#include "LineDiffTest.moc"
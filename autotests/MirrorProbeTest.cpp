@@ -0,0 +1,243 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChannelModel.h"
+#include "MirrorProbe.h"
+
+#include <QHash>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTest>
+#include <QTimer>
+
+/**
+ * Answers HEAD requests on the loopback interface with a fixed status for each path (and 404 for
+ * everything else), after a delay, keeping count of what it was asked and how much at once
+ */
+class MirrorServer
+{
+public:
+    MirrorServer()
+        : delay(0)
+        , active(0)
+        , mostActive(0)
+    {
+        QObject::connect(&server, &QTcpServer::newConnection, [this](){
+            while(QTcpSocket* socket = server.nextPendingConnection()) {
+                QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+                QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket](){
+                    const QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+                    socket->setProperty("request", request);
+                    if(!request.contains("\r\n\r\n")) {
+                        return;
+                    }
+                    socket->setProperty("request", QByteArray());
+                    const QByteArray path = request.split(' ').value(1);
+                    requests << path;
+                    mostActive = qMax(mostActive, ++active);
+                    const int status = statuses.value(path, 404);
+                    QTimer::singleShot(delay, socket, [this, socket, status](){
+                        --active;
+                        socket->write("HTTP/1.1 " + QByteArray::number(status) + " Whatever\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+                        socket->disconnectFromHost();
+                    });
+                });
+            }
+        });
+    }
+
+    bool listen()
+    {
+        return server.listen(QHostAddress::LocalHost);
+    }
+
+    QByteArray base() const
+    {
+        return QString("http://127.0.0.1:%1/mirror/").arg(server.serverPort()).toLatin1();
+    }
+
+    QHash<QByteArray, int> statuses;
+    int delay;
+    QList<QByteArray> requests;
+    int active;
+    int mostActive;
+private:
+    QTcpServer server;
+};
+
+static QVector<SourceEntry> entries(const QByteArray& lines)
+{
+    return SourcesParser::parseList(lines);
+}
+
+class MirrorProbeTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void init();
+    void cleanup();
+    void probe_data();
+    void probe();
+    void nothingToProbe();
+    void sharedRepository();
+    void poolLimit();
+private:
+    MirrorServer* server;
+    MirrorProbe* probe;
+    ChannelModel* model;
+
+    QModelIndex indexOf(const QString& name) const;
+};
+
+QModelIndex MirrorProbeTest::indexOf(const QString& name) const
+{
+    return model->match(model->index(0), ChannelModel::PathRole, QString("/channels/%1.list").arg(name), 1, Qt::MatchExactly).value(0);
+}
+
+void MirrorProbeTest::init()
+{
+    server = new MirrorServer();
+    QVERIFY(server->listen());
+    // Everything goes to the local server, whatever host the sources name
+    qputenv("KCMREPOTOGGLE_PROBE_BASE", server->base());
+    probe = new MirrorProbe();
+    model = new ChannelModel();
+    QVector<Channel> channels;
+    for(const QString& name : {QStringLiteral("one"), QStringLiteral("two"), QStringLiteral("three"), QStringLiteral("four"), QStringLiteral("five"), QStringLiteral("six")}) {
+        Channel channel;
+        channel.path = QString("/channels/%1.list").arg(name);
+        channel.fileName = name + QLatin1String(".list");
+        channel.title = name;
+        channels << channel;
+    }
+    model->setChannels(channels);
+    // The same as the module does
+    connect(probe, &MirrorProbe::probed, model, [this](const QString& path, bool reachable, int latency){
+        model->setProbeState(path, reachable ? ChannelModel::Reachable : ChannelModel::Unreachable, latency);
+    });
+}
+
+void MirrorProbeTest::cleanup()
+{
+    delete model;
+    delete probe;
+    delete server;
+    qunsetenv("KCMREPOTOGGLE_PROBE_BASE");
+}
+
+void MirrorProbeTest::probe_data()
+{
+    QTest::addColumn<QByteArray>("sources");
+    QTest::addColumn<QList<QByteArray> >("found");
+    QTest::addColumn<bool>("reachable");
+    QTest::newRow("inrelease") << QByteArray("deb http://example.com/debian stable main\n")
+        << (QList<QByteArray>() << "/mirror/debian/dists/stable/InRelease") << true;
+    QTest::newRow("release only") << QByteArray("deb https://example.com/debian stable main\n")
+        << (QList<QByteArray>() << "/mirror/debian/dists/stable/Release") << true;
+    QTest::newRow("missing") << QByteArray("deb http://example.com/debian stable main\n")
+        << QList<QByteArray>() << false;
+    QTest::newRow("one of two missing") << QByteArray("deb http://example.com/debian stable main\ndeb http://example.org/ubuntu focal main\n")
+        << (QList<QByteArray>() << "/mirror/debian/dists/stable/InRelease") << false;
+}
+
+void MirrorProbeTest::probe()
+{
+    QFETCH(QByteArray, sources);
+    QFETCH(QList<QByteArray>, found);
+    QFETCH(bool, reachable);
+    for(const QByteArray& path : found) {
+        server->statuses.insert(path, 200);
+    }
+    QSignalSpy probed(probe, SIGNAL(probed(QString,bool,int)));
+    QSignalSpy finished(probe, SIGNAL(finished()));
+    const QModelIndex index = indexOf(QStringLiteral("one"));
+    probe->probe(index.data(ChannelModel::PathRole).toString(), entries(sources));
+    QVERIFY(probe->isRunning());
+    QVERIFY(finished.wait(5000));
+    QVERIFY(!probe->isRunning());
+
+    QCOMPARE(probed.count(), 1);
+    QCOMPARE(probed.first().at(0).toString(), QStringLiteral("/channels/one.list"));
+    QCOMPARE(probed.first().at(1).toBool(), reachable);
+    const int latency = probed.first().at(2).toInt();
+    QVERIFY(latency >= 0);
+    QCOMPARE(index.data(ChannelModel::ProbeStateRole).toInt(), int(reachable ? ChannelModel::Reachable : ChannelModel::Unreachable));
+    QCOMPARE(index.data(ChannelModel::LatencyRole).toInt(), latency);
+}
+
+void MirrorProbeTest::nothingToProbe()
+{
+    // Neither counts against the channel, and there is no latency to speak of
+    QSignalSpy probed(probe, SIGNAL(probed(QString,bool,int)));
+    probe->probe(QStringLiteral("/channels/one.list"), entries("deb cdrom:[Example]/ stable main\ndeb file:///srv/mirror stable main\n"));
+    QCOMPARE(probed.count(), 1);
+    QCOMPARE(probed.first().at(1).toBool(), true);
+    QCOMPARE(probed.first().at(2).toInt(), -1);
+    QVERIFY(!probe->isRunning());
+    QVERIFY(server->requests.isEmpty());
+    const QModelIndex index = indexOf(QStringLiteral("one"));
+    QCOMPARE(index.data(ChannelModel::ProbeStateRole).toInt(), int(ChannelModel::Reachable));
+    QCOMPARE(index.data(ChannelModel::LatencyRole).toInt(), -1);
+}
+
+void MirrorProbeTest::sharedRepository()
+{
+    server->statuses.insert("/mirror/debian/dists/stable/InRelease", 200);
+    QSignalSpy probed(probe, SIGNAL(probed(QString,bool,int)));
+    QSignalSpy finished(probe, SIGNAL(finished()));
+    probe->probe(QStringLiteral("/channels/one.list"), entries("deb http://example.com/debian stable main\ndeb-src http://example.com/debian stable main\n"));
+    probe->probe(QStringLiteral("/channels/two.list"), entries("deb http://example.com/debian stable contrib\n"));
+    QVERIFY(finished.wait(5000));
+    QCOMPARE(probed.count(), 2);
+    // Asked once, for both channels and both types
+    QCOMPARE(server->requests, QList<QByteArray>() << "/mirror/debian/dists/stable/InRelease");
+
+    // And not again once it has answered
+    probe->probe(QStringLiteral("/channels/three.list"), entries("deb http://example.com/debian stable non-free\n"));
+    QCOMPARE(probed.count(), 3);
+    QCOMPARE(server->requests.count(), 1);
+    QCOMPARE(indexOf(QStringLiteral("three")).data(ChannelModel::ProbeStateRole).toInt(), int(ChannelModel::Reachable));
+    QCOMPARE(indexOf(QStringLiteral("three")).data(ChannelModel::LatencyRole).toInt(), indexOf(QStringLiteral("one")).data(ChannelModel::LatencyRole).toInt());
+}
+
+void MirrorProbeTest::poolLimit()
+{
+    server->delay = 100;
+    probe->setMaximumConcurrent(2);
+    QSignalSpy finished(probe, SIGNAL(finished()));
+    for(int row = 0; row < model->rowCount(); ++row) {
+        const QString name = model->index(row).data(ChannelModel::TitleRole).toString();
+        server->statuses.insert(QString("/mirror/%1/dists/stable/InRelease").arg(name).toLatin1(), 200);
+        probe->probe(model->index(row).data(ChannelModel::PathRole).toString(), entries(QString("deb http://example.com/%1 stable main\n").arg(name).toLatin1()));
+    }
+    QVERIFY(finished.wait(10000));
+    QCOMPARE(server->requests.count(), 6);
+    QCOMPARE(server->mostActive, 2);
+    for(int row = 0; row < model->rowCount(); ++row) {
+        QCOMPARE(model->index(row).data(ChannelModel::ProbeStateRole).toInt(), int(ChannelModel::Reachable));
+        // The server takes its time answering every one of them (give or take the timer's slack)
+        QVERIFY(model->index(row).data(ChannelModel::LatencyRole).toInt() >= 50);
+    }
+}
+
+QTEST_GUILESS_MAIN(MirrorProbeTest)
+
+#include "MirrorProbeTest.moc"
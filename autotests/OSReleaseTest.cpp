@@ -0,0 +1,115 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "OSRelease.h"
+
+#include <QTest>
+
+class OSReleaseTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void defaults();
+    void fields();
+    void ignoredLines();
+    void unquote_data();
+    void unquote();
+};
+
+void OSReleaseTest::defaults()
+{
+    const OSRelease release{QByteArray()};
+    QCOMPARE(release.name, QStringLiteral("Linux"));
+    QCOMPARE(release.id, QStringLiteral("linux"));
+    QCOMPARE(release.prettyName, QStringLiteral("Linux"));
+    QVERIFY(release.versionId.isEmpty());
+    QVERIFY(release.idLike.isEmpty());
+}
+
+void OSReleaseTest::fields()
+{
+    const OSRelease release(
+        "NAME=\"KDE neon\"\n"
+        "VERSION=\"5.12\"\n"
+        "ID=neon\n"
+        "ID_LIKE=\"ubuntu  debian\"\n"
+        "PRETTY_NAME=\"KDE neon User Edition 5.12\"\n"
+        "VERSION_ID=\"16.04\"\n"
+        "HOME_URL=\"http://neon.kde.org/\"\n"
+        "VERSION_CODENAME=xenial\n");
+    QCOMPARE(release.name, QStringLiteral("KDE neon"));
+    QCOMPARE(release.version, QStringLiteral("5.12"));
+    QCOMPARE(release.id, QStringLiteral("neon"));
+    QCOMPARE(release.idLike, QStringList() << QStringLiteral("ubuntu") << QStringLiteral("debian"));
+    QCOMPARE(release.prettyName, QStringLiteral("KDE neon User Edition 5.12"));
+    QCOMPARE(release.versionId, QStringLiteral("16.04"));
+    QCOMPARE(release.homeUrl, QStringLiteral("http://neon.kde.org/"));
+    // Vendor specific additions are kept as they are
+    QCOMPARE(release.extra.value(QStringLiteral("VERSION_CODENAME")), QStringLiteral("xenial"));
+}
+
+void OSReleaseTest::ignoredLines()
+{
+    const OSRelease release(
+        "# NAME=Commented\n"
+        "\n"
+        "=no key\n"
+        "NAME no equals sign\n"
+        "   ID=neon  \r\n");
+    QCOMPARE(release.name, QStringLiteral("Linux"));
+    QCOMPARE(release.id, QStringLiteral("neon"));
+    QVERIFY(release.extra.isEmpty());
+}
+
+void OSReleaseTest::unquote_data()
+{
+    QTest::addColumn<QByteArray>("value");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("plain") << QByteArray("plain") << QStringLiteral("plain");
+    QTest::newRow("equals sign") << QByteArray("http://example.com/?a=b") << QStringLiteral("http://example.com/?a=b");
+    QTest::newRow("double quotes") << QByteArray("\"two words\"") << QStringLiteral("two words");
+    QTest::newRow("single quotes") << QByteArray("'two words'") << QStringLiteral("two words");
+    QTest::newRow("nothing special in single quotes") << QByteArray("'a \\\"b\\\" $c \\\\'") << QStringLiteral("a \\\"b\\\" $c \\\\");
+    QTest::newRow("double quotes inside single quotes") << QByteArray("'say \"hi\"'") << QStringLiteral("say \"hi\"");
+    QTest::newRow("single quotes inside double quotes") << QByteArray("\"it's\"") << QStringLiteral("it's");
+    QTest::newRow("escapes in double quotes") << QByteArray("\"\\\"hi\\\" \\$x \\`y\\` \\\\z\"") << QStringLiteral("\"hi\" $x `y` \\z");
+    QTest::newRow("other backslashes in double quotes") << QByteArray("\"\\q \\n\"") << QStringLiteral("\\q \\n");
+    QTest::newRow("escapes outside quotes") << QByteArray("a\\ b\\q\\\\") << QStringLiteral("a bq\\");
+    QTest::newRow("joined quoting") << QByteArray("\"KDE\"' neon'\\!") << QStringLiteral("KDE neon!");
+    QTest::newRow("line continuation") << QByteArray("\"http://exa\\\nmple.com/\"") << QStringLiteral("http://example.com/");
+    QTest::newRow("unquoted line continuation") << QByteArray("exa\\\nmple") << QStringLiteral("example");
+    QTest::newRow("utf-8") << QByteArray("\"K\xc3\xa4se\"") << QString::fromUtf8("K\xc3\xa4se");
+}
+
+void OSReleaseTest::unquote()
+{
+    QFETCH(QByteArray, value);
+    QFETCH(QString, expected);
+
+    const OSRelease release(QByteArray("VALUE=") + value + QByteArray("\nID=neon\n"));
+    QCOMPARE(release.extra.value(QStringLiteral("VALUE")), expected);
+    // Whatever the value did, it did not run into the next line
+    QCOMPARE(release.id, QStringLiteral("neon"));
+}
+
+QTEST_GUILESS_MAIN(OSReleaseTest)
+
+#include "OSReleaseTest.moc"
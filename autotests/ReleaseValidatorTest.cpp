@@ -0,0 +1,220 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ReleaseValidator.h"
+
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QUrl>
+
+static const QByteArray release =
+    "Origin: Example\n"
+    "Suite: stable\n"
+    "Architectures: amd64 i386\n"
+    "Components: main contrib\n"
+    "Description: An example\n"
+    " repository, over two lines\n";
+
+static bool writeFile(const QString& path, const QByteArray& data)
+{
+    QDir().mkpath(path.left(path.lastIndexOf(QLatin1Char('/'))));
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+static QVector<SourceEntry> entries(const QString& line)
+{
+    return SourcesParser::parseList(line.toUtf8());
+}
+
+/**
+ * Just enough of a web server on the loopback interface to answer the validator: a fixed
+ * status, body and (for redirects) location for each path, and 404 for everything else
+ */
+class ReleaseServer
+{
+public:
+    struct Response
+    {
+        int status;
+        QByteArray body;
+        QByteArray location;
+    };
+
+    ReleaseServer()
+    {
+        QObject::connect(&server, &QTcpServer::newConnection, [this](){
+            while(QTcpSocket* socket = server.nextPendingConnection()) {
+                QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+                QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket](){
+                    // The validator asks for more than one file at a time, so each connection keeps its own
+                    const QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+                    socket->setProperty("request", request);
+                    if(!request.contains("\r\n\r\n")) {
+                        return;
+                    }
+                    const QByteArray path = request.split(' ').value(1);
+                    answer(socket, responses.value(path, Response{404, QByteArray("Not Found"), QByteArray()}));
+                });
+            }
+        });
+    }
+
+    bool listen()
+    {
+        return server.listen(QHostAddress::LocalHost);
+    }
+
+    QString url(const QString& path) const
+    {
+        return QString("http://127.0.0.1:%1%2").arg(server.serverPort()).arg(path);
+    }
+
+    QHash<QByteArray, Response> responses;
+private:
+    QTcpServer server;
+
+    static void answer(QTcpSocket* socket, const Response& response)
+    {
+        QByteArray reply = "HTTP/1.1 " + QByteArray::number(response.status) + " Whatever\r\n";
+        if(!response.location.isEmpty()) {
+            reply += "Location: " + response.location + "\r\n";
+        }
+        reply += "Content-Length: " + QByteArray::number(response.body.size()) + "\r\nConnection: close\r\n\r\n" + response.body;
+        socket->write(reply);
+        socket->disconnectFromHost();
+    }
+};
+
+class ReleaseValidatorTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void parseRelease();
+    void parseClearSigned();
+    void validateFile_data();
+    void validateFile();
+    void validateReleaseFallback();
+    void validateRedirect();
+    void validateRedirectLoop();
+};
+
+void ReleaseValidatorTest::parseRelease()
+{
+    const QHash<QString, QString> fields = ReleaseValidator::parseRelease(QByteArray(release).replace("Suite: stable\n", "Suite: stable\r\n"));
+    QCOMPARE(fields.value(QStringLiteral("Origin")), QStringLiteral("Example"));
+    QCOMPARE(fields.value(QStringLiteral("Suite")), QStringLiteral("stable"));
+    QCOMPARE(fields.value(QStringLiteral("Architectures")), QStringLiteral("amd64 i386"));
+    // Continuation lines are joined up
+    QCOMPARE(fields.value(QStringLiteral("Description")), QStringLiteral("An example\nrepository, over two lines"));
+}
+
+void ReleaseValidatorTest::parseClearSigned()
+{
+    const QHash<QString, QString> fields = ReleaseValidator::parseRelease(
+        "-----BEGIN PGP SIGNED MESSAGE-----\n"
+        "Hash: SHA512\n"
+        "\n"
+        "Origin: Example\n"
+        "- Label: Dash escaped\n"
+        "Components: main\n"
+        "-----BEGIN PGP SIGNATURE-----\n"
+        "\n"
+        "iQIzBAEBCgAdFiEE\n"
+        "-----END PGP SIGNATURE-----\n");
+    // Neither the armor headers nor the signature are fields
+    QCOMPARE(fields.count(), 3);
+    QCOMPARE(fields.value(QStringLiteral("Origin")), QStringLiteral("Example"));
+    QCOMPARE(fields.value(QStringLiteral("Label")), QStringLiteral("Dash escaped"));
+    QCOMPARE(fields.value(QStringLiteral("Components")), QStringLiteral("main"));
+    QVERIFY(!fields.contains(QStringLiteral("Hash")));
+}
+
+void ReleaseValidatorTest::validateFile_data()
+{
+    QTest::addColumn<QString>("source");
+    QTest::addColumn<QString>("problem");
+    // Signatures need gpgv and real keys, so these are all trusted
+    QTest::newRow("works") << QStringLiteral("deb [trusted=yes] %1 stable main") << QString();
+    QTest::newRow("prefixed component") << QStringLiteral("deb [trusted=yes] %1 stable updates/contrib") << QString();
+    QTest::newRow("source packages") << QStringLiteral("deb-src [trusted=yes arch=arm64] %1 stable main") << QString();
+    QTest::newRow("no component") << QStringLiteral("deb [trusted=yes] %1 stable non-free") << QStringLiteral("does not have the component non-free");
+    QTest::newRow("no architecture") << QStringLiteral("deb [trusted=yes arch=arm64] %1 stable main") << QStringLiteral("does not have packages for arm64");
+    QTest::newRow("no suite") << QStringLiteral("deb [trusted=yes] %1 unstable main") << QStringLiteral("There is no Release file");
+    QTest::newRow("unsigned") << QStringLiteral("deb %1 unsigned main") << QStringLiteral("is not signed");
+}
+
+void ReleaseValidatorTest::validateFile()
+{
+    QFETCH(QString, source);
+    QFETCH(QString, problem);
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(writeFile(dir.path() + QLatin1String("/dists/stable/InRelease"), release));
+    QVERIFY(writeFile(dir.path() + QLatin1String("/dists/unsigned/Release"), release));
+
+    const QStringList problems = ReleaseValidator::validate(entries(source.arg(QUrl::fromLocalFile(dir.path()).toString())), QStringList() << QStringLiteral("amd64"), QHash<QString, QString>());
+    if(problem.isEmpty()) {
+        QVERIFY2(problems.isEmpty(), qPrintable(problems.join(QLatin1Char('\n'))));
+    }
+    else {
+        QCOMPARE(problems.count(), 1);
+        QVERIFY2(problems.first().contains(problem), qPrintable(problems.first()));
+    }
+}
+
+void ReleaseValidatorTest::validateReleaseFallback()
+{
+    ReleaseServer server;
+    QVERIFY(server.listen());
+    server.responses.insert("/debian/dists/stable/Release", ReleaseServer::Response{200, release, QByteArray()});
+    const QStringList problems = ReleaseValidator::validate(entries(QString("deb [trusted=yes] %1 stable main").arg(server.url(QStringLiteral("/debian")))), QStringList() << QStringLiteral("i386"), QHash<QString, QString>());
+    QVERIFY2(problems.isEmpty(), qPrintable(problems.join(QLatin1Char('\n'))));
+}
+
+void ReleaseValidatorTest::validateRedirect()
+{
+    ReleaseServer server;
+    QVERIFY(server.listen());
+    server.responses.insert("/old/dists/stable/InRelease", ReleaseServer::Response{301, QByteArray(), "/new/dists/stable/InRelease"});
+    server.responses.insert("/new/dists/stable/InRelease", ReleaseServer::Response{302, QByteArray(), server.url(QStringLiteral("/newer/dists/stable/InRelease")).toLatin1()});
+    server.responses.insert("/newer/dists/stable/InRelease", ReleaseServer::Response{200, release, QByteArray()});
+    const QStringList problems = ReleaseValidator::validate(entries(QString("deb [trusted=yes] %1 stable contrib").arg(server.url(QStringLiteral("/old")))), QStringList() << QStringLiteral("amd64"), QHash<QString, QString>());
+    QVERIFY2(problems.isEmpty(), qPrintable(problems.join(QLatin1Char('\n'))));
+}
+
+void ReleaseValidatorTest::validateRedirectLoop()
+{
+    ReleaseServer server;
+    QVERIFY(server.listen());
+    server.responses.insert("/loop/dists/stable/InRelease", ReleaseServer::Response{302, QByteArray(), "/loop/dists/stable/InRelease"});
+    const QStringList problems = ReleaseValidator::validate(entries(QString("deb [trusted=yes] %1 stable main").arg(server.url(QStringLiteral("/loop")))), QStringList() << QStringLiteral("amd64"), QHash<QString, QString>());
+    QCOMPARE(problems.count(), 1);
+    QVERIFY2(problems.first().contains(QLatin1String("Too many redirects")), qPrintable(problems.first()));
+}
+
+QTEST_GUILESS_MAIN(ReleaseValidatorTest)
+
+#include "ReleaseValidatorTest.moc"
@@ -0,0 +1,274 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChannelScanner.h"
+#include "OSRelease.h"
+#include "SourcesParser.h"
+#include "SourcesTransaction.h"
+
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QTemporaryDir>
+#include <QTest>
+
+// A generated tree, and what scanning and parsing it should come out as
+struct SyntheticTree
+{
+    QTemporaryDir* root = 0;
+    QString channelDir;
+    QString sldDir;
+    QStringList channelFiles;
+    int entries = 0;
+    int enabled = 0;
+    int conflicts = 0;
+};
+
+static QByteArray channelContents(int number, bool deb822, const char* suite)
+{
+    if(deb822) {
+        return QString("# Channel %1\n"
+                       "# Synthetic channel number %1\n"
+                       "Types: deb deb-src\n"
+                       "URIs: http://archive%1.example.org/debian\n"
+                       "Suites: %2 %2-updates\n"
+                       "Components: main contrib\n"
+                       "Signed-By: /usr/share/keyrings/channel%1.gpg\n").arg(number).arg(QLatin1String(suite)).toUtf8();
+    }
+    return QString("# Channel %1\n"
+                   "# Synthetic channel number %1\n"
+                   "deb [arch=amd64 signed-by=/usr/share/keyrings/channel%1.gpg] http://archive%1.example.org/debian %2 main contrib\n"
+                   "deb-src http://archive%1.example.org/debian %2 main\n").arg(number).arg(QLatin1String(suite)).toUtf8();
+}
+
+static bool writeFile(const QString& path, const QByteArray& contents)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(contents) == contents.size();
+}
+
+/**
+ * Measures how the parts of the module which touch the disk cope with channel directories of
+ * 10, 1,000 and 50,000 files. Each tree is generated once, the first time it is needed. Every
+ * other channel is in deb822 format, and of the channels, some are installed exactly as they
+ * are, some installed with different formatting, and some have a conflicting file installed.
+ */
+class ScanBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void cleanupTestCase();
+
+    void scan_data();
+    void scan();
+    void parse_data();
+    void parse();
+    void osRelease_data();
+    void osRelease();
+    void osReleaseCurrent();
+    void apply_data();
+    void apply();
+private:
+    const SyntheticTree& tree(int files);
+    QHash<int, SyntheticTree> trees;
+};
+
+const SyntheticTree& ScanBenchmark::tree(int files)
+{
+    QHash<int, SyntheticTree>::const_iterator existing = trees.constFind(files);
+    if(existing != trees.constEnd()) {
+        return existing.value();
+    }
+
+    SyntheticTree& generated = trees[files];
+    generated.root = new QTemporaryDir();
+    generated.channelDir = generated.root->path() + QLatin1String("/channels");
+    generated.sldDir = generated.root->path() + QLatin1String("/sources.list.d");
+    QDir().mkpath(generated.channelDir);
+    QDir().mkpath(generated.sldDir);
+    for(int i = 0; i < files; ++i) {
+        const bool deb822 = i % 2;
+        const QString name = QString("channel%1.%2").arg(i).arg(deb822 ? QLatin1String("sources") : QLatin1String("list"));
+        const QByteArray contents = channelContents(i, deb822, "stable");
+        writeFile(QString("%1/%2").arg(generated.channelDir).arg(name), contents);
+        generated.channelFiles << QString("%1/%2").arg(generated.channelDir).arg(name);
+        generated.entries += deb822 ? 4 : 2;
+
+        const QString installed = QString("%1/%2").arg(generated.sldDir).arg(name);
+        switch(i % 10) {
+        case 0:
+        case 4:
+        case 8:
+            writeFile(installed, contents);
+            ++generated.enabled;
+            break;
+        case 2:
+            // The same sources, only not byte for byte the same file
+            writeFile(installed, QByteArray("# Installed by hand\n\n") + contents);
+            ++generated.enabled;
+            break;
+        case 6:
+            writeFile(installed, channelContents(i, deb822, "testing"));
+            ++generated.conflicts;
+            break;
+        default:
+            break;
+        }
+    }
+    return generated;
+}
+
+void ScanBenchmark::cleanupTestCase()
+{
+    for(const SyntheticTree& synthetic : trees) {
+        delete synthetic.root;
+    }
+    trees.clear();
+}
+
+void ScanBenchmark::scan_data()
+{
+    QTest::addColumn<int>("files");
+    QTest::newRow("10 files") << 10;
+    QTest::newRow("1000 files") << 1000;
+    QTest::newRow("50000 files") << 50000;
+}
+
+void ScanBenchmark::scan()
+{
+    QFETCH(int, files);
+    const SyntheticTree& synthetic = tree(files);
+
+    // Without the persistent cache, so every iteration reads the whole tree, as on a first run
+    ChannelScanState state;
+    QBENCHMARK {
+        state = ChannelScanner::scan(synthetic.sldDir, QStringList() << synthetic.channelDir, false);
+    }
+
+    const QVector<Channel> channels = ChannelScanner::channels(state);
+    QCOMPARE(channels.count(), files);
+    int enabled = 0;
+    int conflicts = 0;
+    for(const Channel& channel : channels) {
+        enabled += channel.state == Qt::Checked ? 1 : 0;
+        conflicts += channel.conflict ? 1 : 0;
+    }
+    QCOMPARE(enabled, synthetic.enabled);
+    QCOMPARE(conflicts, synthetic.conflicts);
+}
+
+void ScanBenchmark::parse_data()
+{
+    scan_data();
+}
+
+void ScanBenchmark::parse()
+{
+    QFETCH(int, files);
+    const SyntheticTree& synthetic = tree(files);
+
+    int entries = 0;
+    QBENCHMARK {
+        entries = 0;
+        for(const QString& path : synthetic.channelFiles) {
+            entries += SourcesParser::parseFile(path).count();
+        }
+    }
+    QCOMPARE(entries, synthetic.entries);
+}
+
+void ScanBenchmark::osRelease_data()
+{
+    QTest::addColumn<QByteArray>("contents");
+    QTest::newRow("plain") << QByteArray(
+        "NAME=KDE neon\n"
+        "VERSION=5.12\n"
+        "ID=neon\n"
+        "ID_LIKE=ubuntu debian\n"
+        "PRETTY_NAME=KDE neon User Edition 5.12\n"
+        "VERSION_ID=16.04\n"
+        "HOME_URL=http://neon.kde.org/\n"
+        "SUPPORT_URL=http://neon.kde.org/\n"
+        "BUG_REPORT_URL=http://bugs.kde.org/\n"
+        "VERSION_CODENAME=xenial\n"
+        "UBUNTU_CODENAME=xenial\n");
+    QTest::newRow("quoted") << QByteArray(
+        "NAME=\"KDE neon\"\n"
+        "VERSION=\"5.12\"\n"
+        "ID=neon\n"
+        "ID_LIKE=\"ubuntu debian\"\n"
+        "PRETTY_NAME=\"KDE neon User Edition \\\"5.12\\\"\"\n"
+        "VERSION_ID='16.04'\n"
+        "HOME_URL=\"http://neon.kde.org/\"\n"
+        "SUPPORT_URL=\"http://neon.kde.org/\"\n"
+        "BUG_REPORT_URL=\"http://bugs.kde.org/\"\n"
+        "VERSION_CODENAME=xenial\n"
+        "UBUNTU_CODENAME=xenial\n");
+}
+
+void ScanBenchmark::osRelease()
+{
+    QFETCH(QByteArray, contents);
+    QString id;
+    QBENCHMARK {
+        OSRelease release(contents);
+        id = release.id;
+    }
+    QCOMPARE(id, QStringLiteral("neon"));
+}
+
+void ScanBenchmark::osReleaseCurrent()
+{
+    // The cached lookup, which is what all but the first caller get
+    OSRelease::current();
+    QBENCHMARK {
+        OSRelease::current();
+    }
+}
+
+void ScanBenchmark::apply_data()
+{
+    scan_data();
+}
+
+void ScanBenchmark::apply()
+{
+    QFETCH(int, files);
+    const SyntheticTree& synthetic = tree(files);
+    QTemporaryDir target;
+    QVERIFY(target.isValid());
+
+    // Enabling every channel at once, and then undoing it again for the next iteration
+    QBENCHMARK {
+        SourcesTransaction transaction(target.path());
+        for(const QString& path : synthetic.channelFiles) {
+            const QString name = path.split("/").last();
+            transaction.install(path, path, name);
+        }
+        QVERIFY2(transaction.commit(), qPrintable(transaction.errorString()));
+        QCOMPARE(QDir(target.path()).entryList(QDir::Files).count(), files);
+        QVERIFY(transaction.rollback());
+    }
+    QVERIFY(QDir(target.path()).entryList(QDir::Files).isEmpty());
+}
+
+QTEST_GUILESS_MAIN(ScanBenchmark)
+
+#include "ScanBenchmark.moc"
@@ -0,0 +1,198 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SourcesParser.h"
+
+#include <QTest>
+
+class SourcesParserTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void oneLine();
+    void oneLineOptions();
+    void oneLineInvalid();
+    void deb822();
+    void deb822Disabled();
+    void deb822EmbeddedKeyring();
+    void formatFor();
+    void digestIgnoresFormatting();
+    void digestSeesDifferences();
+    void listsPrefix();
+};
+
+void SourcesParserTest::oneLine()
+{
+    const QVector<SourceEntry> entries = SourcesParser::parseList(
+        "# A comment\n"
+        "\n"
+        "deb http://example.com/debian stable main contrib main\n"
+        "  deb-src http://example.com/debian/ stable main # and a trailing comment\n");
+    QCOMPARE(entries.count(), 2);
+
+    QCOMPARE(entries.at(0).type, QStringLiteral("deb"));
+    QCOMPARE(entries.at(0).uri, QStringLiteral("http://example.com/debian/"));
+    QCOMPARE(entries.at(0).suite, QStringLiteral("stable"));
+    QCOMPARE(entries.at(0).components, QStringList() << QStringLiteral("contrib") << QStringLiteral("main"));
+    QVERIFY(entries.at(0).options.isEmpty());
+
+    QCOMPARE(entries.at(1).type, QStringLiteral("deb-src"));
+    QCOMPARE(entries.at(1).uri, QStringLiteral("http://example.com/debian/"));
+    QCOMPARE(entries.at(1).components, QStringList() << QStringLiteral("main"));
+}
+
+void SourcesParserTest::oneLineOptions()
+{
+    const QVector<SourceEntry> entries = SourcesParser::parseList(
+        "deb [ arch=i386,amd64 signed-by=/etc/apt/keyrings/example.gpg ] http://example.com/ focal universe\n");
+    QCOMPARE(entries.count(), 1);
+    QCOMPARE(entries.at(0).options.count(), 2);
+    QCOMPARE(entries.at(0).options.value(QStringLiteral("arch")), QStringLiteral("amd64,i386"));
+    QCOMPARE(entries.at(0).options.value(QStringLiteral("signed-by")), QStringLiteral("/etc/apt/keyrings/example.gpg"));
+    QCOMPARE(entries.at(0).uri, QStringLiteral("http://example.com/"));
+    QCOMPARE(entries.at(0).toString(), QStringLiteral("deb [arch=amd64,i386 signed-by=/etc/apt/keyrings/example.gpg] http://example.com/ focal universe"));
+}
+
+void SourcesParserTest::oneLineInvalid()
+{
+    // No suite, an unknown type, and options which never end
+    const QVector<SourceEntry> entries = SourcesParser::parseList(
+        "deb http://example.com/debian\n"
+        "rpm http://example.com/fedora stable main\n"
+        "deb [arch=amd64 http://example.com/debian stable main\n");
+    QVERIFY(entries.isEmpty());
+}
+
+void SourcesParserTest::deb822()
+{
+    const QVector<SourceEntry> entries = SourcesParser::parseDeb822(
+        "# A comment\n"
+        "Types: deb deb-src\n"
+        "URIs: http://example.com/debian\n"
+        "Suites: stable stable-updates\n"
+        "Components: main contrib\n"
+        "Architectures: amd64\n"
+        "\n"
+        "Types: deb\n"
+        "URIs: http://example.org/\n"
+        "Suites: focal\n"
+        "Components: universe\n");
+    // Every combination of types and suites in the first stanza, and the second one
+    QCOMPARE(entries.count(), 5);
+    QStringList lines;
+    for(const SourceEntry& entry : entries) {
+        lines << entry.toString();
+    }
+    lines.sort();
+    QCOMPARE(lines, QStringList()
+        << QStringLiteral("deb [arch=amd64] http://example.com/debian/ stable contrib main")
+        << QStringLiteral("deb [arch=amd64] http://example.com/debian/ stable-updates contrib main")
+        << QStringLiteral("deb http://example.org/ focal universe")
+        << QStringLiteral("deb-src [arch=amd64] http://example.com/debian/ stable contrib main")
+        << QStringLiteral("deb-src [arch=amd64] http://example.com/debian/ stable-updates contrib main"));
+}
+
+void SourcesParserTest::deb822Disabled()
+{
+    const QVector<SourceEntry> entries = SourcesParser::parseDeb822(
+        "Types: deb\n"
+        "URIs: http://example.com/debian\n"
+        "Suites: stable\n"
+        "Components: main\n"
+        "Enabled: no\n"
+        "\n"
+        "Types: deb\n"
+        "URIs: http://example.org/\n"
+        "Suites: focal\n"
+        "Components: universe\n"
+        "Enabled: yes\n");
+    QCOMPARE(entries.count(), 1);
+    QCOMPARE(entries.at(0).uri, QStringLiteral("http://example.org/"));
+    QVERIFY(!entries.at(0).options.contains(QStringLiteral("enabled")));
+}
+
+void SourcesParserTest::deb822EmbeddedKeyring()
+{
+    const QVector<SourceEntry> entries = SourcesParser::parseDeb822(
+        "Types: deb\n"
+        "URIs: http://example.com/debian\n"
+        "Suites: stable\n"
+        "Components: main\n"
+        "Signed-By:\n"
+        " -----BEGIN PGP PUBLIC KEY BLOCK-----\n"
+        " .\n"
+        " mQINBFit2ioBEADhWpZ8/wvZ6hUTiXOwQHXMAlaFHcPH9hAtr4F1y2+OYdbtMuth\n"
+        " -----END PGP PUBLIC KEY BLOCK-----\n");
+    QCOMPARE(entries.count(), 1);
+    // Left exactly as it is, rather than taken for a list of keyrings
+    QCOMPARE(entries.at(0).options.value(QStringLiteral("signed-by")), QStringLiteral(
+        "\n-----BEGIN PGP PUBLIC KEY BLOCK-----"
+        "\n"
+        "\nmQINBFit2ioBEADhWpZ8/wvZ6hUTiXOwQHXMAlaFHcPH9hAtr4F1y2+OYdbtMuth"
+        "\n-----END PGP PUBLIC KEY BLOCK-----"));
+}
+
+void SourcesParserTest::formatFor()
+{
+    QCOMPARE(SourcesParser::formatFor(QStringLiteral("/etc/apt/sources.list.d/example.sources")), SourcesParser::Deb822Format);
+    QCOMPARE(SourcesParser::formatFor(QStringLiteral("/etc/apt/sources.list.d/example.list")), SourcesParser::ListFormat);
+    QCOMPARE(SourcesParser::formatFor(QStringLiteral("/etc/apt/sources.list")), SourcesParser::ListFormat);
+}
+
+void SourcesParserTest::digestIgnoresFormatting()
+{
+    const QByteArray list = SourcesParser::digest(SourcesParser::parseList(
+        "# Example\n"
+        "deb [arch=amd64] http://example.com/debian stable main contrib\n"
+        "deb [arch=amd64] http://example.com/debian stable main contrib\n"));
+    const QByteArray deb822 = SourcesParser::digest(SourcesParser::parseDeb822(
+        "Types: deb\n"
+        "URIs: http://example.com/debian/\n"
+        "Suites: stable\n"
+        "Components: contrib main\n"
+        "Architectures: amd64\n"));
+    QCOMPARE(list, deb822);
+}
+
+void SourcesParserTest::digestSeesDifferences()
+{
+    const QByteArray stable = SourcesParser::digest(SourcesParser::parseList("deb http://example.com/debian stable main\n"));
+    const QByteArray testing = SourcesParser::digest(SourcesParser::parseList("deb http://example.com/debian testing main\n"));
+    const QByteArray signedBy = SourcesParser::digest(SourcesParser::parseList("deb [signed-by=/etc/apt/keyrings/example.gpg] http://example.com/debian stable main\n"));
+    QVERIFY(stable != testing);
+    QVERIFY(stable != signedBy);
+}
+
+void SourcesParserTest::listsPrefix()
+{
+    SourceEntry entry;
+    entry.type = QStringLiteral("deb");
+    entry.uri = QStringLiteral("http://example.com/debian/");
+    entry.suite = QStringLiteral("stable");
+    QCOMPARE(SourcesParser::listsPrefix(entry), QStringLiteral("example.com_debian_dists_stable_"));
+
+    // A flat repository
+    entry.suite = QStringLiteral("./");
+    QCOMPARE(SourcesParser::listsPrefix(entry), QStringLiteral("example.com_debian_._"));
+}
+
+QTEST_GUILESS_MAIN(SourcesParserTest)
+
+#include "SourcesParserTest.moc"
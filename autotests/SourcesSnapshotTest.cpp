@@ -0,0 +1,312 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SourcesSnapshot.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+static bool writeFile(const QString& path, const QByteArray& contents)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(contents) == contents.size();
+}
+
+static QByteArray readFile(const QString& path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+// The files in a directory, with their contents
+static QMap<QString, QByteArray> contents(const QString& path)
+{
+    QMap<QString, QByteArray> files;
+    const QDir dir(path);
+    for(const QString& name : dir.entryList(QDir::Files)) {
+        files[name] = readFile(dir.filePath(name));
+    }
+    return files;
+}
+
+class SourcesSnapshotTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void isValidId_data();
+    void isValidId();
+    void take();
+    void takeUnchanged();
+    void restore();
+    void restoreUnknown_data();
+    void restoreUnknown();
+    void restoreIncomplete();
+    void restoreLists();
+    void prune();
+private:
+    QString takeSnapshot(const QString& profile = QString());
+
+    QTemporaryDir* dir = 0;
+    QString store;
+    QString sldDir;
+    QString keyringDir;
+};
+
+void SourcesSnapshotTest::init()
+{
+    dir = new QTemporaryDir();
+    QVERIFY(dir->isValid());
+    store = dir->path() + QLatin1String("/snapshots");
+    sldDir = dir->path() + QLatin1String("/sources.list.d");
+    keyringDir = dir->path() + QLatin1String("/keyrings");
+    QVERIFY(QDir().mkpath(sldDir));
+    QVERIFY(QDir().mkpath(keyringDir));
+    QVERIFY(writeFile(sldDir + QLatin1String("/one.list"), "deb http://example.com/one stable main\n"));
+    QVERIFY(writeFile(sldDir + QLatin1String("/two.list"), "deb http://example.com/two stable main\n"));
+    QVERIFY(writeFile(keyringDir + QLatin1String("/example.gpg"), "not really a keyring"));
+}
+
+void SourcesSnapshotTest::cleanup()
+{
+    delete dir;
+    dir = 0;
+}
+
+QString SourcesSnapshotTest::takeSnapshot(const QString& profile)
+{
+    QString error;
+    const QString id = SourcesSnapshot::take(store, sldDir, keyringDir, &error, profile);
+    if(id.isEmpty()) {
+        qWarning() << "Failed to take a snapshot:" << error;
+    }
+    return id;
+}
+
+void SourcesSnapshotTest::isValidId_data()
+{
+    QTest::addColumn<QString>("id");
+    QTest::addColumn<bool>("valid");
+    QTest::newRow("plain") << QStringLiteral("20171024-153012-042") << true;
+    QTest::newRow("numbered") << QStringLiteral("20171024-153012-042-2") << true;
+    QTest::newRow("empty") << QString() << false;
+    QTest::newRow("path") << QStringLiteral("../20171024-153012-042") << false;
+    QTest::newRow("trailing path") << QStringLiteral("20171024-153012-042/..") << false;
+    QTest::newRow("short") << QStringLiteral("20171024-153012") << false;
+    QTest::newRow("letters") << QStringLiteral("2017102a-153012-042") << false;
+}
+
+void SourcesSnapshotTest::isValidId()
+{
+    QFETCH(QString, id);
+    QFETCH(bool, valid);
+    QCOMPARE(SourcesSnapshot::isValidId(id), valid);
+}
+
+void SourcesSnapshotTest::take()
+{
+    QVERIFY(SourcesSnapshot::list(store).isEmpty());
+    const QString id = takeSnapshot(QStringLiteral("Testing"));
+    QVERIFY(SourcesSnapshot::isValidId(id));
+
+    const QVector<SnapshotInfo> snapshots = SourcesSnapshot::list(store);
+    QCOMPARE(snapshots.count(), 1);
+    QCOMPARE(snapshots.first().id, id);
+    QCOMPARE(snapshots.first().sources, QStringList() << QStringLiteral("one.list") << QStringLiteral("two.list"));
+    QCOMPARE(snapshots.first().profile, QStringLiteral("Testing"));
+    QVERIFY(snapshots.first().created.isValid());
+    QVERIFY(!snapshots.first().hasLists);
+
+    // The contents are kept once each, by their hash
+    QCOMPARE(QDir(store + QLatin1String("/objects")).entryList(QDir::Files).count(), 3);
+}
+
+void SourcesSnapshotTest::takeUnchanged()
+{
+    const QString first = takeSnapshot();
+    QVERIFY(!first.isEmpty());
+    QCOMPARE(takeSnapshot(), first);
+    QCOMPARE(SourcesSnapshot::list(store).count(), 1);
+
+    QVERIFY(writeFile(sldDir + QLatin1String("/two.list"), "deb http://example.com/two testing main\n"));
+    const QString second = takeSnapshot();
+    QVERIFY(!second.isEmpty());
+    QVERIFY(second != first);
+    const QVector<SnapshotInfo> snapshots = SourcesSnapshot::list(store);
+    QCOMPARE(snapshots.count(), 2);
+    // Newest first
+    QCOMPARE(snapshots.at(0).id, second);
+    QCOMPARE(snapshots.at(1).id, first);
+    // Only the changed file needed storing again
+    QCOMPARE(QDir(store + QLatin1String("/objects")).entryList(QDir::Files).count(), 4);
+}
+
+void SourcesSnapshotTest::restore()
+{
+    const QMap<QString, QByteArray> sources = contents(sldDir);
+    const QMap<QString, QByteArray> keyrings = contents(keyringDir);
+    const QString id = takeSnapshot();
+    QVERIFY(!id.isEmpty());
+
+    // A changed file, a removed one, one added by the helper and one by somebody else, and a lost
+    // and a new keyring
+    QVERIFY(writeFile(sldDir + QLatin1String("/one.list"), "deb http://example.com/one testing main\n"));
+    QVERIFY(QFile::remove(sldDir + QLatin1String("/two.list")));
+    QVERIFY(writeFile(sldDir + QLatin1String("/three.list"), "deb http://example.com/three stable main\n"));
+    QVERIFY(SourcesSnapshot::recordInstalled(store, id, QStringList() << QStringLiteral("three.list")));
+    QVERIFY(writeFile(sldDir + QLatin1String("/four.list"), "deb http://example.com/four stable main\n"));
+    QVERIFY(QFile::remove(keyringDir + QLatin1String("/example.gpg")));
+    QVERIFY(writeFile(keyringDir + QLatin1String("/new.gpg"), "not really a keyring either"));
+    QCOMPARE(SourcesSnapshot::list(store).first().installed, QStringList() << QStringLiteral("three.list"));
+    QStringList byHelper;
+    QStringList byOthers;
+    SourcesSnapshot::addedSince(store, id, sldDir, &byHelper, &byOthers);
+    QCOMPARE(byHelper, QStringList() << QStringLiteral("three.list"));
+    QCOMPARE(byOthers, QStringList() << QStringLiteral("four.list"));
+
+    SourcesTransaction sourcesTransaction(sldDir);
+    SourcesTransaction keyringsTransaction(keyringDir);
+    QStringList removedFiles;
+    QStringList addedFiles;
+    QString error;
+    QVERIFY2(SourcesSnapshot::restore(store, id, sldDir, keyringDir, sourcesTransaction, keyringsTransaction, &removedFiles, &addedFiles, &error), qPrintable(error));
+    removedFiles.sort();
+    addedFiles.sort();
+    QCOMPARE(removedFiles, QStringList() << QStringLiteral("one.list") << QStringLiteral("three.list"));
+    QCOMPARE(addedFiles, QStringList() << QStringLiteral("one.list") << QStringLiteral("two.list"));
+
+    QVERIFY2(sourcesTransaction.commit(), qPrintable(sourcesTransaction.errorString()));
+    QVERIFY2(keyringsTransaction.commit(), qPrintable(keyringsTransaction.errorString()));
+    // Whatever somebody else added since is not ours to take away
+    QMap<QString, QByteArray> expectedSources = sources;
+    expectedSources[QStringLiteral("four.list")] = "deb http://example.com/four stable main\n";
+    QCOMPARE(contents(sldDir), expectedSources);
+    // Keyrings are only ever put back, never removed
+    QMap<QString, QByteArray> expectedKeyrings = keyrings;
+    expectedKeyrings[QStringLiteral("new.gpg")] = "not really a keyring either";
+    QCOMPARE(contents(keyringDir), expectedKeyrings);
+}
+
+void SourcesSnapshotTest::restoreUnknown_data()
+{
+    QTest::addColumn<QString>("id");
+    QTest::newRow("empty") << QString();
+    QTest::newRow("never taken") << QStringLiteral("20171024-153012-042");
+    QTest::newRow("outside the store") << QStringLiteral("../snapshots/20171024-153012-042");
+    QTest::newRow("not an id") << QStringLiteral("objects");
+}
+
+void SourcesSnapshotTest::restoreUnknown()
+{
+    QFETCH(QString, id);
+    QVERIFY(!takeSnapshot().isEmpty());
+
+    SourcesTransaction sourcesTransaction(sldDir);
+    SourcesTransaction keyringsTransaction(keyringDir);
+    QStringList removedFiles;
+    QStringList addedFiles;
+    QString error;
+    QVERIFY(!SourcesSnapshot::restore(store, id, sldDir, keyringDir, sourcesTransaction, keyringsTransaction, &removedFiles, &addedFiles, &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(sourcesTransaction.isEmpty());
+    QVERIFY(keyringsTransaction.isEmpty());
+}
+
+void SourcesSnapshotTest::restoreIncomplete()
+{
+    const QString id = takeSnapshot();
+    QVERIFY(!id.isEmpty());
+    const QDir objects(store + QLatin1String("/objects"));
+    for(const QString& name : objects.entryList(QDir::Files)) {
+        QVERIFY(QFile::remove(objects.filePath(name)));
+    }
+
+    SourcesTransaction sourcesTransaction(sldDir);
+    SourcesTransaction keyringsTransaction(keyringDir);
+    QStringList removedFiles;
+    QStringList addedFiles;
+    QString error;
+    QVERIFY(!SourcesSnapshot::restore(store, id, sldDir, keyringDir, sourcesTransaction, keyringsTransaction, &removedFiles, &addedFiles, &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(sourcesTransaction.isEmpty());
+    QVERIFY(keyringsTransaction.isEmpty());
+}
+
+void SourcesSnapshotTest::restoreLists()
+{
+    const QString id = takeSnapshot();
+    QVERIFY(!id.isEmpty());
+    const QString kept = SourcesSnapshot::listsDirectory(store, id);
+    const QString lists = dir->path() + QLatin1String("/lists");
+    QVERIFY(QDir().mkpath(kept));
+    QVERIFY(QDir().mkpath(lists));
+    QVERIFY(writeFile(kept + QLatin1String("/example.com_one_dists_stable_InRelease"), "kept"));
+    QVERIFY(writeFile(kept + QLatin1String("/example.com_two_dists_stable_InRelease"), "kept"));
+    QVERIFY(writeFile(lists + QLatin1String("/example.com_two_dists_stable_InRelease"), "downloaded again"));
+    QVERIFY(SourcesSnapshot::list(store).first().hasLists);
+
+    // Whatever apt has downloaded again since is newer, and left alone
+    QCOMPARE(SourcesSnapshot::restoreLists(store, id, lists), 1);
+    QCOMPARE(readFile(lists + QLatin1String("/example.com_one_dists_stable_InRelease")), QByteArray("kept"));
+    QCOMPARE(readFile(lists + QLatin1String("/example.com_two_dists_stable_InRelease")), QByteArray("downloaded again"));
+    QCOMPARE(SourcesSnapshot::restoreLists(store, QStringLiteral("../lists"), lists), 0);
+}
+
+void SourcesSnapshotTest::prune()
+{
+    const QString first = takeSnapshot();
+    QVERIFY(writeFile(sldDir + QLatin1String("/two.list"), "deb http://example.com/two testing main\n"));
+    const QString second = takeSnapshot();
+    QVERIFY(QFile::remove(sldDir + QLatin1String("/one.list")));
+    const QString third = takeSnapshot();
+    QVERIFY(!first.isEmpty() && !second.isEmpty() && !third.isEmpty());
+    QVERIFY(QDir().mkpath(SourcesSnapshot::listsDirectory(store, first)));
+    QVERIFY(writeFile(SourcesSnapshot::listsDirectory(store, first) + QLatin1String("/example_InRelease"), "kept"));
+    QCOMPARE(QDir(store + QLatin1String("/objects")).entryList(QDir::Files).count(), 4);
+
+    SourcesSnapshot::prune(store, 2);
+    const QVector<SnapshotInfo> snapshots = SourcesSnapshot::list(store);
+    QCOMPARE(snapshots.count(), 2);
+    QCOMPARE(snapshots.at(0).id, third);
+    QCOMPARE(snapshots.at(1).id, second);
+    QVERIFY(!QDir(SourcesSnapshot::listsDirectory(store, first)).exists());
+    // The first version of two.list was only needed by the first snapshot
+    QCOMPARE(QDir(store + QLatin1String("/objects")).entryList(QDir::Files).count(), 3);
+
+    // Everything the remaining snapshots need is still there
+    SourcesTransaction sourcesTransaction(sldDir);
+    SourcesTransaction keyringsTransaction(keyringDir);
+    QStringList removedFiles;
+    QStringList addedFiles;
+    QString error;
+    QVERIFY2(SourcesSnapshot::restore(store, second, sldDir, keyringDir, sourcesTransaction, keyringsTransaction, &removedFiles, &addedFiles, &error), qPrintable(error));
+}
+
+QTEST_GUILESS_MAIN(SourcesSnapshotTest)
+
+#include "SourcesSnapshotTest.moc"
@@ -0,0 +1,220 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SourcesTransaction.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+static bool writeFile(const QString& path, const QByteArray& contents)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(contents) == contents.size();
+}
+
+static QByteArray readFile(const QString& path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+// Everything in a directory, with the contents of each file, so a whole directory can be compared at once
+static QMap<QString, QByteArray> contents(const QString& path)
+{
+    QMap<QString, QByteArray> files;
+    const QDir dir(path);
+    for(const QString& name : dir.entryList(QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot)) {
+        files[name] = readFile(dir.filePath(name));
+    }
+    return files;
+}
+
+class SourcesTransactionTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void empty();
+    void commit();
+    void rollback();
+    void installOverExisting();
+    void replaceMissing();
+    void removeMissing();
+    void failureUndoesEarlierSteps();
+private:
+    QTemporaryDir* dir = 0;
+    QString target;
+    QString channels;
+};
+
+void SourcesTransactionTest::init()
+{
+    dir = new QTemporaryDir();
+    QVERIFY(dir->isValid());
+    target = dir->path() + QLatin1String("/sources.list.d");
+    channels = dir->path() + QLatin1String("/channels");
+    QVERIFY(QDir().mkpath(target));
+    QVERIFY(QDir().mkpath(channels));
+
+    QVERIFY(writeFile(channels + QLatin1String("/new.list"), "deb http://example.com/new stable main\n"));
+    QVERIFY(writeFile(channels + QLatin1String("/replaced.list"), "deb http://example.com/replacement stable main\n"));
+    QVERIFY(writeFile(target + QLatin1String("/replaced.list"), "deb http://example.com/original stable main\n"));
+    QVERIFY(writeFile(target + QLatin1String("/removed.list"), "deb http://example.com/removed stable main\n"));
+    QVERIFY(writeFile(target + QLatin1String("/untouched.list"), "deb http://example.com/untouched stable main\n"));
+}
+
+void SourcesTransactionTest::cleanup()
+{
+    delete dir;
+    dir = 0;
+}
+
+void SourcesTransactionTest::empty()
+{
+    const QMap<QString, QByteArray> before = contents(target);
+    SourcesTransaction transaction(target);
+    QVERIFY(transaction.isEmpty());
+    QVERIFY(transaction.commit());
+    QCOMPARE(contents(target), before);
+}
+
+void SourcesTransactionTest::commit()
+{
+    {
+        SourcesTransaction transaction(target + QLatin1String("/"));
+        transaction.install(QStringLiteral("new"), channels + QLatin1String("/new.list"), QStringLiteral("new.list"));
+        transaction.replace(QStringLiteral("replaced"), channels + QLatin1String("/replaced.list"), QStringLiteral("replaced.list"));
+        transaction.remove(QStringLiteral("removed"), QStringLiteral("removed.list"));
+        QVERIFY(!transaction.isEmpty());
+        QVERIFY2(transaction.commit(), qPrintable(transaction.errorString()));
+
+        QVariantMap expected;
+        expected[QStringLiteral("new")] = QStringLiteral("applied");
+        expected[QStringLiteral("replaced")] = QStringLiteral("applied");
+        expected[QStringLiteral("removed")] = QStringLiteral("applied");
+        QCOMPARE(transaction.results(), expected);
+    }
+
+    // Once the transaction is gone, so is its staging directory
+    QMap<QString, QByteArray> expected;
+    expected[QStringLiteral("new.list")] = "deb http://example.com/new stable main\n";
+    expected[QStringLiteral("replaced.list")] = "deb http://example.com/replacement stable main\n";
+    expected[QStringLiteral("untouched.list")] = "deb http://example.com/untouched stable main\n";
+    QCOMPARE(contents(target), expected);
+}
+
+void SourcesTransactionTest::rollback()
+{
+    const QMap<QString, QByteArray> before = contents(target);
+    SourcesTransaction transaction(target);
+    // Rolling back something which was never committed does nothing
+    QVERIFY(!transaction.rollback());
+
+    transaction.install(QStringLiteral("new"), channels + QLatin1String("/new.list"), QStringLiteral("new.list"));
+    transaction.replace(QStringLiteral("replaced"), channels + QLatin1String("/replaced.list"), QStringLiteral("replaced.list"));
+    transaction.remove(QStringLiteral("removed"), QStringLiteral("removed.list"));
+    QVERIFY2(transaction.commit(), qPrintable(transaction.errorString()));
+    QVERIFY(QFile::exists(target + QLatin1String("/new.list")));
+
+    QVERIFY2(transaction.rollback(), qPrintable(transaction.errorString()));
+    QVariantMap expected;
+    expected[QStringLiteral("new")] = QStringLiteral("rolled-back");
+    expected[QStringLiteral("replaced")] = QStringLiteral("rolled-back");
+    expected[QStringLiteral("removed")] = QStringLiteral("rolled-back");
+    QCOMPARE(transaction.results(), expected);
+
+    QMap<QString, QByteArray> after = contents(target);
+    // All that is left over is the empty staging directory, until the transaction goes away
+    QCOMPARE(after.count(), before.count() + 1);
+    for(QMap<QString, QByteArray>::const_iterator it = before.constBegin(); it != before.constEnd(); ++it) {
+        QCOMPARE(after.value(it.key()), it.value());
+    }
+}
+
+void SourcesTransactionTest::installOverExisting()
+{
+    const QMap<QString, QByteArray> before = contents(target);
+    SourcesTransaction transaction(target);
+    transaction.install(QStringLiteral("new"), channels + QLatin1String("/new.list"), QStringLiteral("new.list"));
+    transaction.install(QStringLiteral("untouched"), channels + QLatin1String("/new.list"), QStringLiteral("untouched.list"));
+    QVERIFY(!transaction.commit());
+    QVERIFY(!transaction.errorString().isEmpty());
+    QCOMPARE(transaction.results().value(QStringLiteral("new")).toString(), QStringLiteral("not-attempted"));
+    QCOMPARE(transaction.results().value(QStringLiteral("untouched")).toString(), QStringLiteral("failed"));
+    QVERIFY(!QFile::exists(target + QLatin1String("/new.list")));
+    QCOMPARE(readFile(target + QLatin1String("/untouched.list")), before.value(QStringLiteral("untouched.list")));
+}
+
+void SourcesTransactionTest::replaceMissing()
+{
+    SourcesTransaction transaction(target);
+    transaction.replace(QStringLiteral("new"), channels + QLatin1String("/new.list"), QStringLiteral("new.list"));
+    QVERIFY(!transaction.commit());
+    QCOMPARE(transaction.results().value(QStringLiteral("new")).toString(), QStringLiteral("failed"));
+    QVERIFY(!QFile::exists(target + QLatin1String("/new.list")));
+}
+
+void SourcesTransactionTest::removeMissing()
+{
+    SourcesTransaction transaction(target);
+    transaction.remove(QStringLiteral("removed"), QStringLiteral("removed.list"));
+    transaction.remove(QStringLiteral("missing"), QStringLiteral("missing.list"));
+    QVERIFY(!transaction.commit());
+    QCOMPARE(transaction.results().value(QStringLiteral("removed")).toString(), QStringLiteral("not-attempted"));
+    QCOMPARE(transaction.results().value(QStringLiteral("missing")).toString(), QStringLiteral("failed"));
+    QVERIFY(QFile::exists(target + QLatin1String("/removed.list")));
+}
+
+void SourcesTransactionTest::failureUndoesEarlierSteps()
+{
+    const QMap<QString, QByteArray> before = contents(target);
+    {
+        SourcesTransaction transaction(target);
+        transaction.replace(QStringLiteral("replaced"), channels + QLatin1String("/replaced.list"), QStringLiteral("replaced.list"));
+        transaction.remove(QStringLiteral("removed"), QStringLiteral("removed.list"));
+        transaction.install(QStringLiteral("new"), channels + QLatin1String("/new.list"), QStringLiteral("new.list"));
+        // Neither file exists when the files are staged, so this only fails once the first one is
+        // in place, which is just what a file appearing in the meantime looks like
+        transaction.install(QStringLiteral("new again"), channels + QLatin1String("/replaced.list"), QStringLiteral("new.list"));
+        QVERIFY(!transaction.commit());
+        QVERIFY(!transaction.errorString().isEmpty());
+
+        QVariantMap expected;
+        expected[QStringLiteral("replaced")] = QStringLiteral("rolled-back");
+        expected[QStringLiteral("removed")] = QStringLiteral("rolled-back");
+        expected[QStringLiteral("new")] = QStringLiteral("rolled-back");
+        expected[QStringLiteral("new again")] = QStringLiteral("failed");
+        QCOMPARE(transaction.results(), expected);
+        // A transaction which failed to commit has nothing to roll back
+        QVERIFY(!transaction.rollback());
+    }
+    QCOMPARE(contents(target), before);
+}
+
+QTEST_GUILESS_MAIN(SourcesTransactionTest)
+
+#include "SourcesTransactionTest.moc"
@@ -0,0 +1,80 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "AptConfig.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <apt-pkg/aptconfiguration.h>
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/init.h>
+
+// pkgInitConfig fills in the global _config, so make sure only one of us does that, and
+// only once, even when asked from a scanning thread
+static QMutex configMutex;
+static bool configInitialised = false;
+
+static bool initialiseConfig()
+{
+    if(!configInitialised) {
+        configInitialised = pkgInitConfig(*_config);
+    }
+    return configInitialised;
+}
+
+QString AptConfig::findDirectory(const QString& key, const QString& fallback)
+{
+    QMutexLocker locker(&configMutex);
+    if(!initialiseConfig()) {
+        return fallback;
+    }
+    const std::string directory = _config->FindDir(key.toLatin1().constData(), QFile::encodeName(fallback).constData());
+    return QFile::decodeName(directory.c_str());
+}
+
+QString AptConfig::findFile(const QString& key, const QString& fallback)
+{
+    QMutexLocker locker(&configMutex);
+    if(!initialiseConfig()) {
+        return fallback;
+    }
+    const std::string file = _config->FindFile(key.toLatin1().constData(), QFile::encodeName(fallback).constData());
+    return QFile::decodeName(file.c_str());
+}
+
+QString AptConfig::sourcePartsDirectory()
+{
+    return findDirectory(QLatin1String("Dir::Etc::sourceparts"), QLatin1String("/etc/apt/sources.list.d/"));
+}
+
+QStringList AptConfig::architectures()
+{
+    QMutexLocker locker(&configMutex);
+    QStringList architectures;
+    if(!initialiseConfig()) {
+        return architectures;
+    }
+    for(const std::string& architecture : APT::Configuration::getArchitectures()) {
+        architectures << QString::fromStdString(architecture);
+    }
+    return architectures;
+}
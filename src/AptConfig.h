@@ -0,0 +1,62 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef APTCONFIG_H
+#define APTCONFIG_H
+
+#include <QString>
+#include <QStringList>
+
+/**
+ * Access to apt's configuration, and nothing else. Unlike QApt::Backend, this does not
+ * load the package cache, which is a lot of work to do when all you want is to know
+ * where sources.list.d lives.
+ */
+class AptConfig
+{
+public:
+    /**
+     * Look up a directory in the apt configuration
+     *
+     * @param key The configuration key, e.g. Dir::Etc::sourceparts
+     * @param fallback The directory to return if the key is not set, or the configuration could not be read
+     */
+    static QString findDirectory(const QString& key, const QString& fallback = QString());
+
+    /**
+     * Look up a file in the apt configuration
+     *
+     * @param key The configuration key, e.g. Dir::Etc::sourcelist
+     * @param fallback The file to return if the key is not set, or the configuration could not be read
+     */
+    static QString findFile(const QString& key, const QString& fallback = QString());
+
+    /**
+     * The location of apt's sources.list.d
+     */
+    static QString sourcePartsDirectory();
+
+    /**
+     * The architectures apt fetches packages for, the native one first
+     */
+    static QStringList architectures();
+};
+
+#endif//APTCONFIG_H
@@ -19,79 +19,585 @@
 */
 
 #include "AuthHelper.h"
+#include "AptConfig.h"
+#include "ChangePlan.h"
+#include "ChannelScanner.h"
+#include "ChannelVerifier.h"
+#include "HelperAction.h"
+#include "Logging.h"
+#include "ReleaseValidator.h"
+#include "SourcesParser.h"
+#include "SourcesSnapshot.h"
+#include "SourcesTransaction.h"
+#include "Tracing.h"
 
 #include <KLocalizedString>
 
 #include <QApt/Backend>
-#include <QApt/Config>
+#include <QApt/DownloadProgress>
 
-#include <QCoreApplication>
-#include <QDebug>
+#include <QEventLoop>
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QSet>
+#include <QTemporaryDir>
+#include <QTimer>
+
+// Options (like /refreshCache) are passed alongside the channels, and are told apart
+// from them by not being full paths
+static bool isOption(const QString& key)
+{
+    return key.lastIndexOf(QLatin1Char('/')) == 0;
+}
 
 ActionReply Helper::save(const QVariantMap& args)
+{
+    // Whatever we time in here is sent back along with the reply, so the module can show it
+    // alongside its own timings
+    Tracing::setCollecting(true);
+    ActionReply reply = apply(args);
+    reply.addData(QLatin1String("timings"), Tracing::takeRecords());
+    return reply;
+}
+
+ActionReply Helper::apply(const QVariantMap& args)
 {
     ActionReply reply;
 
-    QApt::Backend *backend = new QApt::Backend();
-    backend->init();
-    QString sldDir(backend->config()->findDirectory("Dir::Etc::sourceparts", QLatin1String("/etc/apt/sources.list.d/")));
-    for(const QString& key : args.keys()) {
-        if(key == QLatin1String("/refreshCache")) {
-            continue;
-        }
-        QString listsFile = QString("%1/%2").arg(sldDir).arg(key.split("/").last());
-        bool result = false;
-        switch(args.value(key).toInt()) {
-        case 0:
-            // disable - remove the file
-            result = QFile::remove(listsFile);
-            if(!result) {
+    // Loading the package cache is expensive, and all we need to put the files in place is
+    // to know where they go, so only bring up the full backend if we're refreshing
+    QString sldDir;
+    {
+        ScopedTimer timer(KCMREPOTOGGLE_HELPER(), QLatin1String("apt config"));
+        sldDir = AptConfig::sourcePartsDirectory();
+    }
+    // Collect all the changes first, and then apply them in one go, so that a failure
+    // half way through does not leave sources.list.d in some state nobody asked for
+    SourcesTransaction transaction(sldDir);
+    // Keyrings which come with the channels go in along with them, so they're ready by the time
+    // apt goes looking. They are only ever added, as other sources may well be using them as well.
+    SourcesTransaction keyrings(ChannelVerifier::keyringDirectory());
+    QSet<QString> keyringTargets;
+    const QStringList channelDirs = ChannelScanner::channelDirectories();
+    QStringList added;
+    QVector<SourceEntry> removed;
+    // The files this change puts into sources.list.d which were not there before
+    QStringList installedFiles;
+    const QString store = SourcesSnapshot::storeDirectory();
+    const bool revert = args.contains(QLatin1String("/revert"));
+    QString revertTo;
+    if(revert) {
+        // Going back to a snapshot is the same as any other set of changes, it's just that
+        // the snapshot decides what they are
+        revertTo = args.value(QLatin1String("/revert")).toString();
+        if(revertTo.isEmpty()) {
+            const QVector<SnapshotInfo> snapshots = SourcesSnapshot::list(store);
+            if(!snapshots.isEmpty()) {
+                revertTo = snapshots.first().id;
+            }
+        }
+        QStringList removedFiles;
+        QStringList addedFiles;
+        QString error = i18nc("Error string used when asked to revert the software channels, but there is nothing to revert to", "There are no earlier states of the software channels to go back to");
+        if(revertTo.isEmpty() || !SourcesSnapshot::restore(store, revertTo, sldDir, ChannelVerifier::keyringDirectory(), transaction, keyrings, &removedFiles, &addedFiles, &error)) {
+            reply.setType(KAuth::ActionReply::HelperErrorType);
+            reply.setErrorDescription(error);
+            return reply;
+        }
+        for(const QString& fileName : removedFiles) {
+            removed << SourcesParser::parseFile(QString("%1/%2").arg(sldDir).arg(fileName));
+        }
+        for(const QString& fileName : addedFiles) {
+            added << QString("%1/%2").arg(sldDir).arg(fileName);
+            if(!removedFiles.contains(fileName)) {
+                installedFiles << fileName;
+            }
+        }
+    }
+    else {
+        // What the new channels' sources are, so their repositories can be checked before anything is changed
+        QVector<SourceEntry> newEntries;
+        QHash<QString, QString> newKeyrings;
+        for(const QString& key : args.keys()) {
+            if(isOption(key)) {
+                continue;
+            }
+            QString fileName = key.split("/").last();
+            const QString installedPath = QString("%1/%2").arg(sldDir).arg(fileName);
+            const int change = args.value(key).toInt();
+            // Whoever asked us may not be who they claim to be, so make sure that what we're about to
+            // put into (or take out of) sources.list.d actually is a channel, and the one it is meant to be
+            VerifiedChannel verified;
+            if(change == 0 || change == 2 || change == HelperAction::ReplaceInstalled) {
+                QString error;
+                if(!ChannelVerifier::verify(key, channelDirs, &verified, &error)) {
+                    qCWarning(KCMREPOTOGGLE_HELPER) << "Refusing to change" << key << error;
+                    reply.setType(KAuth::ActionReply::HelperErrorType);
+                    reply.setErrorDescription(error);
+                    return reply;
+                }
+            }
+            if(change == 2 || change == HelperAction::ReplaceInstalled) {
+                if(!verified.keyring.isEmpty() && !keyringTargets.contains(verified.keyringTarget)) {
+                    keyringTargets << verified.keyringTarget;
+                    addKeyring(keyrings, verified);
+                    newKeyrings.insert(verified.keyringTarget, verified.keyring);
+                }
+                newEntries << SourcesParser::parseFile(verified.path);
+            }
+            switch(change) {
+            case 0:
+                // disable - remove the file, but remember what was in it so we can clear out its lists later.
+                // Only ever take out what the channel put there, never somebody else's file of the same name.
+                if(QFileInfo::exists(installedPath) && !ChangePlan::sameSources(verified.path, installedPath)) {
+                    qCWarning(KCMREPOTOGGLE_HELPER) << "Refusing to remove" << fileName << "as it was not installed from" << key;
+                    reply.setType(KAuth::ActionReply::HelperErrorType);
+                    reply.setErrorDescription(i18nc("Error string used when a software channel could not be disabled because the file by its name in the apt sources lists directory is a different one", "Failed to disable %1 - %2 has different contents, and was not installed from it", key, installedPath));
+                    return reply;
+                }
+                removed << SourcesParser::parseFile(installedPath);
+                transaction.remove(key, fileName);
+                break;
+            case 2:
+                // enable - copy the file into its new location
+                added << installedPath;
+                installedFiles << fileName;
+                transaction.install(key, verified.path, fileName);
+                break;
+            case HelperAction::ReplaceInstalled:
+                // replace - swap whatever is installed by that name for the channel's file. The old file's
+                // lists are dealt with like those of a removed channel, so anything the new one still
+                // uses is kept.
+                removed << SourcesParser::parseFile(installedPath);
+                added << installedPath;
+                transaction.replace(key, verified.path, fileName);
+                break;
+            case 1:
+            default:
+                // nothing - this should not really be possible, but switches should handle all inputs, so...
+                qCWarning(KCMREPOTOGGLE_HELPER) << "Attempted to do nothing with an apt source lists file. This should not be possible." << key;
                 reply.setType(KAuth::ActionReply::HelperErrorType);
-                reply.setErrorDescription(i18nc("Error string used when a software channel could not be removed because the file representing it could not be deleted", "Failed to disable %1 - could not remove the file %2").arg(key).arg(listsFile));
+                reply.setErrorDescription(i18nc("Error string used in the very uncommon case that an unknown configuration was attempted", "Failed to change status of %1 to the unknown middle state - this should not really be possible").arg(key));
+                return reply;
             }
-            break;
-        case 2:
-            // enable - copy the file into its new location
-            result = QFile::copy(key, listsFile);
-            if(!result) {
+        }
+
+        // A channel whose repositories do not have what it asks for would only make the refresh fail
+        // afterwards, so when asked to, find out now, while it is easy to say no
+        if(args.value(QLatin1String("/validate")).toInt() == 2 && !newEntries.isEmpty()) {
+            ScopedTimer timer(KCMREPOTOGGLE_HELPER(), QLatin1String("validate"));
+            const QStringList problems = ReleaseValidator::validate(newEntries, AptConfig::architectures(), newKeyrings, [](){ return HelperSupport::isStopped(); });
+            // Whatever went wrong after being told to stop is only because we stopped
+            if(HelperSupport::isStopped()) {
+                cancelled = true;
+                return cancelledReply(transaction, keyrings);
+            }
+            if(!problems.isEmpty()) {
+                qCWarning(KCMREPOTOGGLE_HELPER) << "Refusing to install channels with broken repositories" << problems;
+                reply.setType(KAuth::ActionReply::HelperErrorType);
+                reply.setErrorDescription(i18nc("Error string used when the repositories of the channels to enable are not usable, followed by a list of the problems", "The software channels were left the way they were, as some of the new ones do not work:\n%1", problems.join(QLatin1Char('\n'))));
+                return reply;
+            }
+        }
+    }
+
+    // Nothing has been touched yet, so if we've already been told to stop, this is easy
+    cancelled = HelperSupport::isStopped();
+    if(cancelled) {
+        return cancelledReply(transaction, keyrings);
+    }
+
+    // Whatever we're about to do, it should be possible to go back to how things are right now.
+    // Not being able to is no reason to stop the user from making changes, though. When nothing
+    // is about to change (such as when only refreshing), there is nothing to go back from.
+    QString snapshot;
+    const QString profile = args.value(QLatin1String("/profile")).toString();
+    if(!profile.isEmpty()) {
+        qCDebug(KCMREPOTOGGLE_HELPER) << "Switching to the channel profile" << profile;
+    }
+    if(!transaction.isEmpty() || !keyrings.isEmpty()) {
+        ScopedTimer timer(KCMREPOTOGGLE_HELPER(), QLatin1String("snapshot"));
+        QString error;
+        snapshot = SourcesSnapshot::take(store, sldDir, ChannelVerifier::keyringDirectory(), &error, profile);
+        if(snapshot.isEmpty()) {
+            qCWarning(KCMREPOTOGGLE_HELPER) << "Could not take a snapshot before applying the changes:" << error;
+        }
+    }
+
+    bool committed = false;
+    {
+        ScopedTimer timer(KCMREPOTOGGLE_HELPER(), QLatin1String("file apply"));
+        // The keyrings first, as there's no harm in having one which nothing uses, and then the
+        // channels. If those fail, the keyrings are taken back out again.
+        if((revert || !keyringTargets.isEmpty()) && !QDir().mkpath(ChannelVerifier::keyringDirectory())) {
+            reply.setType(KAuth::ActionReply::HelperErrorType);
+            reply.setErrorDescription(i18nc("Error string used when the directory for the keyrings of software channels could not be created", "Failed to create %1", ChannelVerifier::keyringDirectory()));
+            return reply;
+        }
+        if(!keyrings.commit()) {
+            reply.addData(QLatin1String("results"), results(transaction, keyrings));
+            reply.setType(KAuth::ActionReply::HelperErrorType);
+            reply.setErrorDescription(keyrings.errorString());
+            return reply;
+        }
+        committed = transaction.commit();
+        if(!committed) {
+            keyrings.rollback();
+        }
+    }
+    reply.addData(QLatin1String("results"), results(transaction, keyrings));
+    if(!committed) {
+        reply.setType(KAuth::ActionReply::HelperErrorType);
+        reply.setErrorDescription(transaction.errorString());
+        return reply;
+    }
+    // Reverting to this snapshot, or an older one, should take these out again, but nothing else
+    // which turned up in sources.list.d since
+    if(!snapshot.isEmpty() && !installedFiles.isEmpty()) {
+        SourcesSnapshot::recordInstalled(store, snapshot, installedFiles);
+    }
+    if(revert && args.value(QLatin1String("/reuseLists")).toInt() == 2) {
+        // The lists of the channels which are coming back, if we still have them, so there's
+        // nothing to download again for those
+        const int restored = SourcesSnapshot::restoreLists(store, revertTo, AptConfig::findDirectory(QLatin1String("Dir::State::lists"), QLatin1String("/var/lib/apt/lists/")));
+        qCDebug(KCMREPOTOGGLE_HELPER) << "Put back" << restored << "package lists kept with the snapshot" << revertTo;
+    }
+    SourcesSnapshot::prune(store, SourcesSnapshot::keepCount());
+
+    if(args.value(QLatin1String("/refreshCache")).toInt() == 2) {
+        bool refreshed = true;
+        const bool fullRefresh = args.value(QLatin1String("/fullRefresh")).toInt() == 2;
+        {
+            ScopedTimer timer(KCMREPOTOGGLE_HELPER(), QLatin1String("cache refresh"));
+            if(fullRefresh) {
+                refreshed = refreshEverything(reply);
+            }
+            else if(!added.isEmpty()) {
+                // Only the channels which were just added have anything new to download
+                refreshed = refreshSources(added, reply);
+            }
+        }
+
+        if(cancelled) {
+            // Put everything back the way it was, including getting rid of whatever lists
+            // were already downloaded for the channels which are now not going to be added
+            QVector<SourceEntry> unwanted;
+            for(const QString& listsFile : added) {
+                unwanted << SourcesParser::parseFile(listsFile);
+            }
+            if(!transaction.rollback()) {
                 reply.setType(KAuth::ActionReply::HelperErrorType);
-                reply.setErrorDescription(i18nc("Error string used when a software channel could not be enabled because the file representing it could not be copied to the apt sources lists directory", "Failed to enable %1 - could not copy it to %2").arg(key).arg(listsFile));
+                reply.setErrorDescription(transaction.errorString());
+                reply.addData(QLatin1String("results"), results(transaction, keyrings));
+                return reply;
             }
+            keyrings.rollback();
+            pruneLists(unwanted, sldDir, QString());
+            return cancelledReply(transaction, keyrings);
+        }
+
+        // The channels which were removed only need their lists thrown away, but don't do
+        // that until we know we're not going to be putting them back
+        if(refreshed && !fullRefresh) {
+            pruneLists(removed, sldDir, snapshot);
+        }
+    }
+
+    return reply;
+}
+
+void Helper::addKeyring(SourcesTransaction& keyrings, const VerifiedChannel& channel)
+{
+    const QString fileName = channel.keyringTarget.split("/").last();
+    QFile installed(channel.keyringTarget);
+    if(!installed.exists()) {
+        keyrings.install(channel.keyringTarget, channel.keyring, fileName);
+        return;
+    }
+    QFile shipped(channel.keyring);
+    if(installed.open(QIODevice::ReadOnly) && shipped.open(QIODevice::ReadOnly) && installed.readAll() == shipped.readAll()) {
+        return;
+    }
+    keyrings.replace(channel.keyringTarget, channel.keyring, fileName);
+}
+
+QVariantMap Helper::results(const SourcesTransaction& transaction, const SourcesTransaction& keyrings)
+{
+    QVariantMap results = transaction.results();
+    const QVariantMap keyringResults = keyrings.results();
+    for(QVariantMap::const_iterator it = keyringResults.constBegin(); it != keyringResults.constEnd(); ++it) {
+        results[it.key()] = it.value();
+    }
+    return results;
+}
+
+ActionReply Helper::cancelledReply(const SourcesTransaction& transaction, const SourcesTransaction& keyrings)
+{
+    ActionReply reply(KAuth::ActionReply::HelperErrorType);
+    reply.setErrorDescription(i18nc("Error string used when applying changes to the software channels was cancelled", "Applying the changes was cancelled, and the software channels have been left the way they were"));
+    reply.addData(QLatin1String("cancelled"), true);
+    reply.addData(QLatin1String("results"), results(transaction, keyrings));
+    return reply;
+}
+
+bool Helper::refreshEverything(ActionReply& reply)
+{
+    QApt::Backend backend;
+    {
+        ScopedTimer timer(KCMREPOTOGGLE_HELPER(), QLatin1String("backend init"));
+        backend.init();
+    }
+    QApt::Transaction* updateTransaction = backend.updateCache();
+    connect(updateTransaction, SIGNAL(progressChanged(int)), this, SLOT(updatePercentage(int)));
+    connect(updateTransaction, SIGNAL(statusChanged(QApt::TransactionStatus)), this, SLOT(statusChanged(QApt::TransactionStatus)));
+    connect(updateTransaction, &QApt::Transaction::downloadProgressChanged, this, [this](const QApt::DownloadProgress& progress){
+        QVariantMap record;
+        record[QLatin1String("uri")] = progress.uri();
+        record[QLatin1String("item")] = progress.shortDescription();
+        record[QLatin1String("bytes")] = progress.partialSize();
+        record[QLatin1String("total")] = progress.fileSize();
+        switch(progress.status()) {
+        case QApt::DoneState:
+            record[QLatin1String("itemStatus")] = QLatin1String("done");
+            break;
+        case QApt::HitState:
+            record[QLatin1String("itemStatus")] = QLatin1String("hit");
+            break;
+        case QApt::ErrorState:
+            record[QLatin1String("itemStatus")] = QLatin1String("error");
+            break;
+        case QApt::IgnoredState:
+            record[QLatin1String("itemStatus")] = QLatin1String("ignored");
             break;
-        case 1:
         default:
-            // nothing - this should not really be possible, but switches should handle all inputs, so...
-            qWarning() << "Attempted to do nothing with an apt source lists file. This should not be possible." << key;
-            reply.setType(KAuth::ActionReply::HelperErrorType);
-            reply.setErrorDescription(i18nc("Error string used in the very uncommon case that an unknown configuration was attempted", "Failed to change status of %1 to the unknown middle state - this should not really be possible").arg(key));
+            record[QLatin1String("itemStatus")] = QLatin1String("fetching");
             break;
         }
-        if(!result) {
-            break;
+        // Finishing an item is worth telling about straight away, progress within one less so
+        reportProgress(record, progress.status() != QApt::FetchingState);
+    });
+    connect(updateTransaction, &QApt::Transaction::downloadSpeedChanged, this, [this](quint64 speed){
+        QVariantMap record;
+        record[QLatin1String("speed")] = speed;
+        reportProgress(record);
+    });
+    connect(updateTransaction, &QApt::Transaction::downloadETAChanged, this, [this](quint64 eta){
+        QVariantMap record;
+        record[QLatin1String("eta")] = eta;
+        reportProgress(record);
+    });
+
+    // Sit in an event loop rather than spinning, so we are idle while apt is downloading. The
+    // only thing we need to go and look for ourselves is whether we have been asked to stop.
+    QEventLoop loop;
+    connect(updateTransaction, &QApt::Transaction::finished, &loop, &QEventLoop::quit);
+    connect(updateTransaction, &QApt::Transaction::statusChanged, &loop, [&loop](QApt::TransactionStatus status){
+        if(status == QApt::FinishedStatus) {
+            loop.quit();
         }
+    });
+    QTimer cancelPoll;
+    cancelPoll.setInterval(250);
+    connect(&cancelPoll, &QTimer::timeout, &loop, [this, updateTransaction, &loop](){
+        if(HelperSupport::isStopped()) {
+            // Even if apt can't stop right now, we won't be waiting for it any longer, as
+            // whatever it's doing is about to be undone anyway
+            qCDebug(KCMREPOTOGGLE_HELPER) << "Cancel requested, telling updateTransaction to stop, if it can." << updateTransaction->isCancellable();
+            cancelled = true;
+            if(updateTransaction->isCancellable()) {
+                updateTransaction->cancel();
+            }
+            loop.quit();
+        }
+    });
+    cancelPoll.start();
+    updateTransaction->run();
+    if(updateTransaction->status() != QApt::FinishedStatus) {
+        loop.exec();
     }
+    cancelPoll.stop();
+    const bool success = updateTransaction->exitStatus() == QApt::ExitSuccess;
+    if(!success && !cancelled) {
+        reply.setType(KAuth::ActionReply::HelperErrorType);
+        reply.setErrorDescription(i18nc("Error string used when refreshing the package cache failed", "Failed to refresh the package cache: %1", updateTransaction->errorDetails()));
+    }
+    updateTransaction->deleteLater();
+    return success;
+}
 
-    if(args.value(QLatin1String("/refreshCache")).toInt() == 2) {
-        QApt::Transaction* updateTransaction = backend->updateCache();
-        connect(updateTransaction, SIGNAL(progressChanged(int)), this, SLOT(updatePercentage(int)));
-        connect(updateTransaction, SIGNAL(statusChanged(QApt::TransactionStatus)), this, SLOT(statusChanged(QApt::TransactionStatus)));
-        updateTransaction->run();
-
-        bool cancelBegun = false;
-        while(updateTransaction->status() != QApt::FinishedStatus) {
-            if(!cancelBegun && HelperSupport::isStopped()) {
-                qDebug() << "Cancel requested, telling updateTransaction to stop, if it can." << updateTransaction->isCancellable();
-                if(updateTransaction->isCancellable()) {
-                    updateTransaction->cancel();
-                    cancelBegun = true;
+bool Helper::refreshSources(const QStringList& listsFiles, ActionReply& reply)
+{
+    // Point apt at a sources.list.d of our own, which holds nothing but the files we were
+    // given, and tell it to leave the lists of all the other sources alone. We also stop
+    // it from building the binary caches, as they would only contain these sources (apt
+    // will simply build them again next time it needs them).
+    QTemporaryDir parts;
+    if(!parts.isValid()) {
+        reply.setType(KAuth::ActionReply::HelperErrorType);
+        reply.setErrorDescription(i18nc("Error string used when the directory used for refreshing only some software channels could not be created", "Failed to create a temporary directory for refreshing the package cache"));
+        return false;
+    }
+    for(const QString& listsFile : listsFiles) {
+        // apt-get would quite happily refresh without a source it cannot see, and say it all went well
+        if(!QFile::link(listsFile, QString("%1/%2").arg(parts.path()).arg(listsFile.split("/").last()))) {
+            reply.setType(KAuth::ActionReply::HelperErrorType);
+            reply.setErrorDescription(i18nc("Error string used when a software channel could not be included in refreshing the package cache", "Failed to refresh the package cache for %1", listsFile));
+            return false;
+        }
+    }
+
+    QStringList arguments;
+    arguments << QLatin1String("update")
+              << QLatin1String("-o") << QLatin1String("Dir::Etc::sourcelist=/dev/null")
+              << QLatin1String("-o") << QString("Dir::Etc::sourceparts=%1").arg(parts.path())
+              << QLatin1String("-o") << QLatin1String("APT::Get::List-Cleanup=0")
+              << QLatin1String("-o") << QLatin1String("Dir::Cache::pkgcache=")
+              << QLatin1String("-o") << QLatin1String("Dir::Cache::srcpkgcache=")
+              << QLatin1String("-o") << QLatin1String("APT::Status-Fd=1");
+
+    QVariantMap phase;
+    phase[QLatin1String("phase")] = QLatin1String("downloading");
+    reportProgress(phase, true);
+    QProcess apt;
+    QEventLoop loop;
+    connect(&apt, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), &loop, &QEventLoop::quit);
+    connect(&apt, &QProcess::readyReadStandardOutput, &loop, [this, &apt](){
+        // Status lines look like dlstatus:<item>:<percent>:<description>, and the lines apt-get
+        // writes for people look like Get:<item> <uri> <suite> <file> [<size>] (or Hit, Ign, Err)
+        static const QRegularExpression itemLine(QLatin1String("^(Get|Hit|Ign|Err):\\d+ (\\S+) (.*?)(?: \\[(.+)\\])?$"));
+        while(apt.canReadLine()) {
+            const QString line = QString::fromLocal8Bit(apt.readLine()).trimmed();
+            if(line.startsWith(QLatin1String("dlstatus:"))) {
+                const QStringList fields = line.split(QLatin1Char(':'));
+                if(fields.count() > 2) {
+                    HelperSupport::progressStep(int(fields.at(2).toDouble()));
+                }
+                continue;
+            }
+            QRegularExpressionMatch match = itemLine.match(line);
+            if(match.hasMatch()) {
+                static const QMap<QString, QString> states{
+                    {QLatin1String("Get"), QLatin1String("done")},
+                    {QLatin1String("Hit"), QLatin1String("hit")},
+                    {QLatin1String("Ign"), QLatin1String("ignored")},
+                    {QLatin1String("Err"), QLatin1String("error")}
+                };
+                QVariantMap record;
+                record[QLatin1String("uri")] = match.captured(2);
+                record[QLatin1String("item")] = match.captured(3);
+                record[QLatin1String("itemStatus")] = states.value(match.captured(1));
+                if(!match.captured(4).isEmpty()) {
+                    record[QLatin1String("size")] = match.captured(4);
                 }
+                reportProgress(record, true);
             }
-            qApp->processEvents();
         }
+    });
+    QTimer cancelPoll;
+    cancelPoll.setInterval(250);
+    connect(&cancelPoll, &QTimer::timeout, &loop, [this, &apt](){
+        if(!cancelled && HelperSupport::isStopped() && apt.state() != QProcess::NotRunning) {
+            qCDebug(KCMREPOTOGGLE_HELPER) << "Cancel requested, stopping apt-get";
+            cancelled = true;
+            apt.terminate();
+            // apt-get lets go of its lock and cleans up on SIGTERM, but don't wait forever for it
+            QTimer::singleShot(5000, &apt, &QProcess::kill);
+        }
+    });
+    apt.start(QLatin1String("apt-get"), arguments);
+    if(!apt.waitForStarted()) {
+        reply.setType(KAuth::ActionReply::HelperErrorType);
+        reply.setErrorDescription(i18nc("Error string used when refreshing the package cache failed", "Failed to refresh the package cache: %1", apt.errorString()));
+        return false;
+    }
+    cancelPoll.start();
+    if(apt.state() != QProcess::NotRunning) {
+        loop.exec();
+    }
+    cancelPoll.stop();
+    qCDebug(KCMREPOTOGGLE_HELPER) << "Refreshed" << listsFiles.count() << "sources";
+    if(cancelled) {
+        return false;
     }
 
-    return reply;
+    if(apt.exitStatus() != QProcess::NormalExit || apt.exitCode() != 0) {
+        reply.setType(KAuth::ActionReply::HelperErrorType);
+        reply.setErrorDescription(i18nc("Error string used when refreshing the package cache failed", "Failed to refresh the package cache: %1", QString::fromLocal8Bit(apt.readAllStandardError()).trimmed()));
+        return false;
+    }
+    return true;
+}
+
+void Helper::pruneLists(const QVector<SourceEntry>& removed, const QString& sldDir, const QString& snapshot)
+{
+    if(removed.isEmpty()) {
+        return;
+    }
+    ScopedTimer timer(KCMREPOTOGGLE_HELPER(), QLatin1String("prune lists"));
+    // Anything still configured keeps its lists, even if a removed channel shared them
+    QSet<QString> inUse;
+    QVector<SourceEntry> remaining = SourcesParser::parseFile(AptConfig::findFile(QLatin1String("Dir::Etc::sourcelist"), QLatin1String("/etc/apt/sources.list")));
+    QDir sld(sldDir);
+    for(const QString& entry : sld.entryList(QStringList() << QLatin1String("*.list") << QLatin1String("*.sources"), QDir::Files)) {
+        remaining << SourcesParser::parseFile(sld.filePath(entry));
+    }
+    for(const SourceEntry& entry : remaining) {
+        inUse << SourcesParser::listsPrefix(entry);
+    }
+
+    QSet<QString> prefixes;
+    for(const SourceEntry& entry : removed) {
+        const QString prefix = SourcesParser::listsPrefix(entry);
+        if(!inUse.contains(prefix)) {
+            prefixes << prefix;
+        }
+    }
+    if(prefixes.isEmpty()) {
+        return;
+    }
+    QDir lists(AptConfig::findDirectory(QLatin1String("Dir::State::lists"), QLatin1String("/var/lib/apt/lists/")));
+    // Kept with the snapshot taken before the channels were removed, so going back to it does not
+    // mean downloading them all over again. They're thrown away along with the snapshot.
+    QDir kept;
+    if(!snapshot.isEmpty()) {
+        kept.setPath(SourcesSnapshot::listsDirectory(SourcesSnapshot::storeDirectory(), snapshot));
+        if(!QDir().mkpath(kept.path())) {
+            kept.setPath(QString());
+        }
+    }
+    for(const QString& entry : lists.entryList(QDir::Files)) {
+        for(const QString& prefix : prefixes) {
+            if(entry.startsWith(prefix)) {
+                if(!kept.path().isEmpty() && lists.rename(entry, kept.filePath(entry))) {
+                    break;
+                }
+                if(!lists.remove(entry)) {
+                    qCWarning(KCMREPOTOGGLE_HELPER) << "Failed to remove the lists file" << entry << "of a removed software channel";
+                }
+                break;
+            }
+        }
+    }
+}
+
+void Helper::reportProgress(const QVariantMap& record, bool immediately)
+{
+    // Apt will happily tell us about progress many times a second for each item it's fetching,
+    // which is a lot more than is useful to send over dbus, so only pass on the most recent
+    // record a few times a second, unless we're told something which should not be missed.
+    for(QVariantMap::const_iterator it = record.constBegin(); it != record.constEnd(); ++it) {
+        progressRecord[it.key()] = it.value();
+    }
+    if(!immediately && progressTimer.isValid() && progressTimer.elapsed() < 250) {
+        return;
+    }
+    progressTimer.start();
+    HelperSupport::progressStep(progressRecord);
+    // Per-item details only make sense alongside the item they came with
+    progressRecord.remove(QLatin1String("size"));
 }
 
 void Helper::updatePercentage(int percent)
@@ -102,12 +608,25 @@ void Helper::updatePercentage(int percent)
 void Helper::statusChanged(QApt::TransactionStatus status)
 {
     QApt::Transaction* updateTransaction = qobject_cast<QApt::Transaction*>(sender());
-    if(status == QApt::FinishedStatus) {
-        QVariantMap newStatus;
+    QVariantMap newStatus;
+    switch(status) {
+    case QApt::DownloadingStatus:
+        newStatus["phase"] = QLatin1String("downloading");
+        break;
+    case QApt::LoadingCacheStatus:
+    case QApt::CommittingStatus:
+        newStatus["phase"] = QLatin1String("processing");
+        break;
+    case QApt::FinishedStatus:
+        newStatus["phase"] = QLatin1String("finished");
         newStatus["status"] = updateTransaction->status();
         newStatus["statusDetails"] = updateTransaction->statusDetails();
-        HelperSupport::progressStep(newStatus);
+        break;
+    default:
+        newStatus["phase"] = QLatin1String("waiting");
+        break;
     }
+    reportProgress(newStatus, true);
 }
 
 
@@ -21,6 +21,11 @@
 #ifndef AUTHHELPER_H
 #define AUTHHELPER_H
 
+#include "ChannelVerifier.h"
+#include "SourcesParser.h"
+#include "SourcesTransaction.h"
+
+#include <QElapsedTimer>
 #include <QFile>
 
 #include <KAuth>
@@ -35,6 +40,54 @@ public Q_SLOTS:
     ActionReply save(const QVariantMap& args);
     void updatePercentage(int percent);
     void statusChanged(QApt::TransactionStatus status);
+private:
+    /**
+     * Everything save() does, other than sending back how long it all took
+     */
+    ActionReply apply(const QVariantMap& args);
+
+    /**
+     * Set once we notice that whoever started us has asked us to stop
+     */
+    bool cancelled = false;
+    /**
+     * The reply to send when we have stopped on request, after putting everything back, with
+     * the results of both the channels and the keyrings
+     */
+    ActionReply cancelledReply(const SourcesTransaction& transaction, const SourcesTransaction& keyrings);
+
+    /**
+     * Pass a progress record on to whoever is waiting for us, though not too often
+     *
+     * @param record The fields which changed since the last record
+     * @param immediately Send this one even if we just sent another
+     */
+    void reportProgress(const QVariantMap& record, bool immediately = false);
+    QVariantMap progressRecord;
+    QElapsedTimer progressTimer;
+
+    /**
+     * Add the keyring a channel comes with to the keyrings transaction, unless it is already installed as is
+     */
+    void addKeyring(SourcesTransaction& keyrings, const VerifiedChannel& channel);
+    /**
+     * The results of the channels and the keyrings transactions, together
+     */
+    QVariantMap results(const SourcesTransaction& transaction, const SourcesTransaction& keyrings);
+
+    /**
+     * Refresh the indexes of all configured sources, through QApt
+     */
+    bool refreshEverything(ActionReply& reply);
+    /**
+     * Refresh the indexes of only the sources found in the given lists files
+     */
+    bool refreshSources(const QStringList& listsFiles, ActionReply& reply);
+    /**
+     * Remove the downloaded indexes of the given sources, unless something else still uses them.
+     * If a snapshot is given, they are moved in with that, rather than deleted.
+     */
+    void pruneLists(const QVector<SourceEntry>& removed, const QString& sldDir, const QString& snapshot);
 };
 
 #endif//AUTHHELPER_H
@@ -0,0 +1,157 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChangePlan.h"
+
+#include "FileHash.h"
+#include "HelperAction.h"
+#include "SourcesParser.h"
+
+#include <KLocalizedString>
+
+#include <QFileInfo>
+
+// The same test the scanner uses to decide whether a channel is enabled. Files with no sources
+// in them (nothing but comments, say, or nothing apt would understand) have nothing to compare
+// by, so unless they are byte for byte the same, they are not the same.
+bool ChangePlan::sameSources(const QString& channelPath, const QString& installedPath)
+{
+    if(QFileInfo(channelPath).size() == QFileInfo(installedPath).size()) {
+        const QByteArray channelHash = FileHash::sha256(channelPath);
+        if(!channelHash.isEmpty() && channelHash == FileHash::sha256(installedPath)) {
+            return true;
+        }
+    }
+    const QVector<SourceEntry> channelEntries = SourcesParser::parseFile(channelPath);
+    const QVector<SourceEntry> installedEntries = SourcesParser::parseFile(installedPath);
+    if(channelEntries.isEmpty() || installedEntries.isEmpty()) {
+        return false;
+    }
+    return SourcesParser::digest(channelEntries) == SourcesParser::digest(installedEntries);
+}
+
+QVector<PlannedChange> ChangePlan::compute(const QString& sldDir, const QVariantMap& changes)
+{
+    QVector<PlannedChange> plan;
+    plan.reserve(changes.count());
+    for(QVariantMap::const_iterator it = changes.constBegin(); it != changes.constEnd(); ++it) {
+        PlannedChange change;
+        change.channelPath = it.key();
+        change.targetPath = QString("%1/%2").arg(sldDir).arg(it.key().split("/").last());
+        const bool installed = QFileInfo(change.targetPath).isFile();
+        switch(it.value().toInt()) {
+        case Qt::Unchecked:
+            // Only ever take out what the channel put there, never somebody else's file of the same name
+            change.disabling = true;
+            if(!installed) {
+                change.operation = PlannedChange::Unchanged;
+            }
+            else {
+                change.operation = sameSources(change.channelPath, change.targetPath) ? PlannedChange::Remove : PlannedChange::Blocked;
+            }
+            break;
+        case Qt::Checked:
+            if(!installed) {
+                change.operation = PlannedChange::Install;
+            }
+            else {
+                change.operation = sameSources(change.channelPath, change.targetPath) ? PlannedChange::Unchanged : PlannedChange::Blocked;
+            }
+            break;
+        case HelperAction::ReplaceInstalled:
+            // If whatever was in the way has since gone, this is a plain install
+            if(!installed) {
+                change.operation = PlannedChange::Install;
+            }
+            else {
+                change.operation = sameSources(change.channelPath, change.targetPath) ? PlannedChange::Unchanged : PlannedChange::Replace;
+            }
+            break;
+        default:
+            // The helper refuses anything else, and there's no point in getting that far
+            change.operation = PlannedChange::Blocked;
+            break;
+        }
+        plan << change;
+    }
+    return plan;
+}
+
+QVariantMap ChangePlan::helperChanges(const QVector<PlannedChange>& plan)
+{
+    QVariantMap changes;
+    for(const PlannedChange& change : plan) {
+        switch(change.operation) {
+        case PlannedChange::Install:
+            changes[change.channelPath] = int(Qt::Checked);
+            break;
+        case PlannedChange::Replace:
+            changes[change.channelPath] = HelperAction::ReplaceInstalled;
+            break;
+        case PlannedChange::Remove:
+            changes[change.channelPath] = int(Qt::Unchecked);
+            break;
+        case PlannedChange::Unchanged:
+        case PlannedChange::Blocked:
+        default:
+            break;
+        }
+    }
+    return changes;
+}
+
+QString ChangePlan::operationName(PlannedChange::Operation operation)
+{
+    switch(operation) {
+    case PlannedChange::Install:
+        return QLatin1String("install");
+    case PlannedChange::Replace:
+        return QLatin1String("replace");
+    case PlannedChange::Remove:
+        return QLatin1String("remove");
+    case PlannedChange::Blocked:
+        return QLatin1String("blocked");
+    case PlannedChange::Unchanged:
+    default:
+        break;
+    }
+    return QLatin1String("unchanged");
+}
+
+QString ChangePlan::describe(const PlannedChange& change)
+{
+    switch(change.operation) {
+    case PlannedChange::Install:
+        return i18nc("A planned change, with the channel's file and where it is going to be copied to", "Add %1 as %2", change.channelPath, change.targetPath);
+    case PlannedChange::Replace:
+        return i18nc("A planned change, with the installed file and the channel's file which is going to take its place", "Replace %1 with %2", change.targetPath, change.channelPath);
+    case PlannedChange::Remove:
+        return i18nc("A planned change, with the installed file which is going to be removed", "Remove %1", change.targetPath);
+    case PlannedChange::Blocked:
+        if(change.disabling) {
+            return i18nc("A planned change which cannot be made, with the channel's file and the installed file which does not match it", "Cannot remove %2, as it has different contents from %1, and was not installed from it", change.channelPath, change.targetPath);
+        }
+        return i18nc("A planned change which cannot be made, with the channel's file and the installed file which is in the way", "Cannot add %1, as %2 already exists with different contents", change.channelPath, change.targetPath);
+    case PlannedChange::Unchanged:
+    default:
+        break;
+    }
+    return i18nc("A planned change which turned out to not be needed, with the installed file", "Leave %1 as it is", change.targetPath);
+}
@@ -0,0 +1,118 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHANGEPLAN_H
+#define CHANGEPLAN_H
+
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+
+/**
+ * A single file operation which applying a set of changes comes down to
+ */
+struct PlannedChange
+{
+    enum Operation {
+        /**
+         * Copy the channel's file into sources.list.d
+         */
+        Install,
+        /**
+         * Swap the file by the same name in sources.list.d for the channel's own
+         */
+        Replace,
+        /**
+         * Take the file out of sources.list.d
+         */
+        Remove,
+        /**
+         * sources.list.d already is the way it was asked to be, so there is nothing to do
+         */
+        Unchanged,
+        /**
+         * The channel cannot be enabled, as sources.list.d has a file by the same name which
+         * says something else. For the same reason, it cannot be disabled either, as that
+         * file is not the channel's to remove.
+         */
+        Blocked
+    };
+    Operation operation = Unchanged;
+    /**
+     * Whether the channel was asked to be disabled, rather than enabled
+     */
+    bool disabling = false;
+    /**
+     * The channel the change was asked for, as passed in the changes
+     */
+    QString channelPath;
+    /**
+     * The file in sources.list.d which the change is about
+     */
+    QString targetPath;
+};
+
+/**
+ * Working out what applying a set of changes would actually do, before doing any of it. This
+ * looks at sources.list.d as it is right now, rather than at what the last scan found, so that
+ * asking for something which is already the case (because another tool got there first, or the
+ * scan is out of date) turns into nothing at all, and the helper does not need to be bothered.
+ */
+class ChangePlan
+{
+public:
+    /**
+     * Work out the file operations for a set of changes
+     *
+     * @param sldDir The location of apt's sources.list.d
+     * @param changes The channel paths to change, with the wanted Qt::CheckState (or
+     *                HelperAction::ReplaceInstalled) as value, as passed to the helper
+     */
+    static QVector<PlannedChange> compute(const QString& sldDir, const QVariantMap& changes);
+
+    /**
+     * Whether a file in sources.list.d is the one a channel would have put there: byte for byte
+     * the same, or failing that, the same sources written differently. This is what decides
+     * whether disabling the channel may remove the file.
+     *
+     * @param channelPath The channel's file
+     * @param installedPath The file in sources.list.d by the same name
+     */
+    static bool sameSources(const QString& channelPath, const QString& installedPath);
+
+    /**
+     * The changes to pass on to the helper to carry out a plan, leaving out everything which
+     * is unchanged or blocked. When this is empty, there is nothing to do.
+     */
+    static QVariantMap helperChanges(const QVector<PlannedChange>& plan);
+
+    /**
+     * A short, machine readable name for an operation ("install", "replace", "remove",
+     * "unchanged" or "blocked")
+     */
+    static QString operationName(PlannedChange::Operation operation);
+
+    /**
+     * A human readable description of a single planned change
+     */
+    static QString describe(const PlannedChange& change);
+};
+
+#endif//CHANGEPLAN_H
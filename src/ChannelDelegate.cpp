@@ -0,0 +1,107 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChannelDelegate.h"
+
+#include "ChannelModel.h"
+
+#include <KLocalizedString>
+
+#include <QApplication>
+#include <QColor>
+#include <QFontMetrics>
+#include <QPainter>
+
+static QFont headingFont(const QFont& font)
+{
+    QFont heading(font);
+    heading.setBold(true);
+    return heading;
+}
+
+ChannelDelegate::ChannelDelegate(QObject* parent)
+    : QStyledItemDelegate(parent)
+{
+}
+
+ChannelDelegate::~ChannelDelegate()
+{
+}
+
+void ChannelDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    QStyleOptionViewItem opt(option);
+    initStyleOption(&opt, index);
+    const QWidget* widget = opt.widget;
+    QStyle* style = widget ? widget->style() : QApplication::style();
+
+    // The first line of the display text is the title, along with the probe state. We do the rest ourselves.
+    const QString heading = opt.text.section(QLatin1Char('\n'), 0, 0);
+    const bool conflict = index.data(ChannelModel::ConflictRole).toBool();
+    QString details;
+    if(conflict) {
+        details = i18nc("Second line of a channel in conflict with an installed file, with that file's name", "Differs from the installed %1", index.data(ChannelModel::FileNameRole).toString());
+    }
+    else {
+        details = index.data(ChannelModel::DescriptionRole).toString();
+    }
+    const QRect textRect = style->subElementRect(QStyle::SE_ItemViewItemText, &opt, widget);
+
+    // Let the style draw the background, selection and check box, just without any text
+    opt.text.clear();
+    style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, widget);
+
+    painter->save();
+    const QPalette::ColorGroup group = (opt.state & QStyle::State_Enabled) ? QPalette::Normal : QPalette::Disabled;
+    const bool selected = opt.state & QStyle::State_Selected;
+    const QColor textColor = opt.palette.color(group, selected ? QPalette::HighlightedText : QPalette::Text);
+    const QFont heading = headingFont(opt.font);
+    const QFontMetrics headingMetrics(heading);
+    const QFontMetrics detailsMetrics(opt.font);
+    const int height = details.isEmpty() ? headingMetrics.height() : headingMetrics.height() + detailsMetrics.height();
+    int top = textRect.top() + (textRect.height() - height) / 2;
+
+    painter->setFont(heading);
+    painter->setPen(textColor);
+    painter->drawText(QRect(textRect.left(), top, textRect.width(), headingMetrics.height()), Qt::AlignLeft | Qt::AlignVCenter, headingMetrics.elidedText(heading, Qt::ElideRight, textRect.width()));
+    top += headingMetrics.height();
+
+    if(!details.isEmpty()) {
+        painter->setFont(opt.font);
+        painter->setPen(conflict && !selected ? QColor(Qt::darkRed) : textColor);
+        painter->drawText(QRect(textRect.left(), top, textRect.width(), detailsMetrics.height()), Qt::AlignLeft | Qt::AlignVCenter, detailsMetrics.elidedText(details, Qt::ElideRight, textRect.width()));
+    }
+    painter->restore();
+}
+
+QSize ChannelDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    // Always room for two lines, whatever the row holds, so every row is the same height. This
+    // deliberately does not look at the text, as that would mean measuring every single row, and
+    // the text is elided to whatever width the view gives us anyway.
+    Q_UNUSED(index);
+    const QWidget* widget = option.widget;
+    QStyle* style = widget ? widget->style() : QApplication::style();
+    const int margin = style->pixelMetric(QStyle::PM_FocusFrameVMargin, &option, widget) + 1;
+    const QFontMetrics headingMetrics(headingFont(option.font));
+    const int height = headingMetrics.height() + QFontMetrics(option.font).height() + 2 * margin;
+    const int indicator = style->pixelMetric(QStyle::PM_IndicatorHeight, &option, widget);
+    return QSize(headingMetrics.averageCharWidth() * 30, qMax(height, indicator + 2 * margin));
+}
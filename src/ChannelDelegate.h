@@ -0,0 +1,44 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHANNELDELEGATE_H
+#define CHANNELDELEGATE_H
+
+#include <QStyledItemDelegate>
+
+/**
+ * Paints a channel as a single row of fixed height: the check box, the title (along with
+ * whatever is known about reaching its repositories) and, below that, either its description
+ * or what it is in conflict with. As every row is the same height, the view can be told so
+ * (see QListView::setUniformItemSizes), and it then only ever has to look at the rows which
+ * are actually on screen, however many channels there are.
+ */
+class ChannelDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+public:
+    explicit ChannelDelegate(QObject* parent = 0);
+    virtual ~ChannelDelegate();
+
+    virtual void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const;
+    virtual QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const;
+};
+
+#endif//CHANNELDELEGATE_H
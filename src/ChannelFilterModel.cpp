@@ -0,0 +1,111 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChannelFilterModel.h"
+
+#include "ChannelModel.h"
+
+class ChannelFilterModel::Private {
+public:
+    Private()
+        : filter(ChannelFilterModel::AllChannels)
+    {}
+    QString searchText;
+    ChannelFilterModel::Filter filter;
+};
+
+ChannelFilterModel::ChannelFilterModel(QObject* parent)
+    : QSortFilterProxyModel(parent)
+    , d(new Private)
+{
+    // Rows change state (and conflicts come and go) on every rescan, and they
+    // need to come and go from the filtered list along with that
+    setDynamicSortFilter(true);
+}
+
+ChannelFilterModel::~ChannelFilterModel()
+{
+    delete d;
+}
+
+void ChannelFilterModel::setSearchText(const QString& text)
+{
+    const QString trimmed = text.trimmed();
+    if(d->searchText == trimmed) {
+        return;
+    }
+    d->searchText = trimmed;
+    invalidateFilter();
+}
+
+QString ChannelFilterModel::searchText() const
+{
+    return d->searchText;
+}
+
+void ChannelFilterModel::setFilter(Filter filter)
+{
+    if(d->filter == filter) {
+        return;
+    }
+    d->filter = filter;
+    invalidateFilter();
+}
+
+ChannelFilterModel::Filter ChannelFilterModel::filter() const
+{
+    return d->filter;
+}
+
+bool ChannelFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const
+{
+    const QModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
+    switch(d->filter) {
+    case EnabledChannels:
+        if(index.data(ChannelModel::CurrentStateRole).toInt() != Qt::Checked) {
+            return false;
+        }
+        break;
+    case ConflictingChannels:
+        if(!index.data(ChannelModel::ConflictRole).toBool()) {
+            return false;
+        }
+        break;
+    case DistributionChannels:
+        if(index.data(ChannelModel::GeneralUseRole).toBool()) {
+            return false;
+        }
+        break;
+    case GeneralUseChannels:
+        if(!index.data(ChannelModel::GeneralUseRole).toBool()) {
+            return false;
+        }
+        break;
+    case AllChannels:
+    default:
+        break;
+    }
+    if(d->searchText.isEmpty()) {
+        return true;
+    }
+    return index.data(ChannelModel::TitleRole).toString().contains(d->searchText, Qt::CaseInsensitive)
+        || index.data(ChannelModel::FileNameRole).toString().contains(d->searchText, Qt::CaseInsensitive)
+        || index.data(ChannelModel::DescriptionRole).toString().contains(d->searchText, Qt::CaseInsensitive);
+}
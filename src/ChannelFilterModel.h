@@ -0,0 +1,68 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHANNELFILTERMODEL_H
+#define CHANNELFILTERMODEL_H
+
+#include <QSortFilterProxyModel>
+
+/**
+ * Narrows the list of channels down to those matching a search, and/or of a particular kind
+ */
+class ChannelFilterModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+public:
+    /**
+     * Which channels to show, whatever the search
+     */
+    enum Filter {
+        AllChannels,
+        /**
+         * Channels which are currently enabled on disk (not the ones the user has just checked)
+         */
+        EnabledChannels,
+        ConflictingChannels,
+        /**
+         * Channels specific to this distribution (or one it is based on), so anything not general-use
+         */
+        DistributionChannels,
+        GeneralUseChannels
+    };
+
+    explicit ChannelFilterModel(QObject* parent = 0);
+    virtual ~ChannelFilterModel();
+
+    /**
+     * Only show channels whose title, file name or description contains this text (ignoring case)
+     */
+    void setSearchText(const QString& text);
+    QString searchText() const;
+
+    void setFilter(Filter filter);
+    Filter filter() const;
+protected:
+    virtual bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const;
+private:
+    class Private;
+    Private* d;
+};
+
+#endif//CHANNELFILTERMODEL_H
@@ -0,0 +1,178 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChannelManifest.h"
+
+#include "FileHash.h"
+#include "Logging.h"
+#include "SourcesParser.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+// Bump this if the format ever changes in a way older versions would misread
+static const int manifestVersion = 1;
+
+QString ChannelManifest::fileName()
+{
+    return QLatin1String("index.json");
+}
+
+static QJsonObject readManifest(const QString& directory)
+{
+    QFile file(QString("%1/%2").arg(directory).arg(ChannelManifest::fileName()));
+    if(!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if(error.error != QJsonParseError::NoError || !document.isObject()) {
+        qCWarning(KCMREPOTOGGLE_MODULE) << "The channel manifest" << file.fileName() << "could not be read, ignoring it:" << error.errorString();
+        return QJsonObject();
+    }
+    const QJsonObject root = document.object();
+    if(root.value(QLatin1String("version")).toInt() != manifestVersion) {
+        qCWarning(KCMREPOTOGGLE_MODULE) << "The channel manifest" << file.fileName() << "is of an unknown version, ignoring it";
+        return QJsonObject();
+    }
+    return root;
+}
+
+QString ChannelManifest::signatureFileName()
+{
+    return fileName() + QLatin1String(".sig");
+}
+
+QHash<QString, ManifestEntry> ChannelManifest::load(const QString& directory)
+{
+    QHash<QString, ManifestEntry> entries;
+    const QJsonObject root = readManifest(directory);
+    const QJsonArray channels = root.value(QLatin1String("channels")).toArray();
+    entries.reserve(channels.count());
+    for(const QJsonValue& value : channels) {
+        const QJsonObject channel = value.toObject();
+        ManifestEntry entry;
+        entry.file = channel.value(QLatin1String("file")).toString();
+        // Anything pointing outside the directory is not something we would ever look at anyway
+        if(entry.file.isEmpty() || entry.file.contains(QLatin1Char('/')) || entry.file == fileName() || entry.file == signatureFileName()) {
+            continue;
+        }
+        entry.title = channel.value(QLatin1String("title")).toString();
+        entry.description = channel.value(QLatin1String("description")).toString();
+        entry.sha256 = QByteArray::fromHex(channel.value(QLatin1String("sha256")).toString().toLatin1());
+        entry.signingKey = channel.value(QLatin1String("signingKey")).toString();
+        entries.insert(entry.file, entry);
+    }
+    return entries;
+}
+
+QHash<QString, QByteArray> ChannelManifest::loadKeyrings(const QString& directory)
+{
+    QHash<QString, QByteArray> keyrings;
+    const QJsonArray listed = readManifest(directory).value(QLatin1String("keyrings")).toArray();
+    for(const QJsonValue& value : listed) {
+        const QJsonObject keyring = value.toObject();
+        const QString file = keyring.value(QLatin1String("file")).toString();
+        const QByteArray sha256 = QByteArray::fromHex(keyring.value(QLatin1String("sha256")).toString().toLatin1());
+        if(file.isEmpty() || file.contains(QLatin1Char('/')) || sha256.isEmpty()) {
+            continue;
+        }
+        keyrings.insert(file, sha256);
+    }
+    return keyrings;
+}
+
+ManifestEntry ChannelManifest::describe(const QString& path)
+{
+    ManifestEntry entry;
+    entry.file = path.split("/").last();
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        return entry;
+    }
+    const QByteArray contents = file.readAll();
+    entry.sha256 = QCryptographicHash::hash(contents, QCryptographicHash::Sha256);
+
+    // The same rules the scanner uses: a comment on the first line is the title, and one on
+    // the second line is the description
+    const QList<QByteArray> lines = contents.split('\n');
+    if(lines.count() > 0 && lines.at(0).startsWith('#')) {
+        entry.title = QString::fromUtf8(lines.at(0).mid(1)).trimmed();
+    }
+    if(lines.count() > 1 && lines.at(1).startsWith('#')) {
+        entry.description = QString::fromUtf8(lines.at(1).mid(1)).trimmed();
+    }
+
+    QStringList keys;
+    for(const SourceEntry& source : SourcesParser::parse(contents, SourcesParser::formatFor(path))) {
+        const QString key = source.options.value(QLatin1String("signed-by"));
+        if(!keys.contains(key)) {
+            keys << key;
+        }
+    }
+    if(keys.count() == 1) {
+        entry.signingKey = keys.first();
+    }
+    return entry;
+}
+
+QByteArray ChannelManifest::generate(const QString& directory)
+{
+    QJsonArray channels;
+    const QDir dir(directory);
+    for(const QString& name : dir.entryList(QDir::Files, QDir::Name)) {
+        if(name == fileName() || name == signatureFileName()) {
+            continue;
+        }
+        const ManifestEntry entry = describe(dir.filePath(name));
+        QJsonObject channel;
+        channel[QLatin1String("file")] = entry.file;
+        channel[QLatin1String("title")] = entry.title;
+        channel[QLatin1String("description")] = entry.description;
+        channel[QLatin1String("sha256")] = QString::fromLatin1(entry.sha256.toHex());
+        if(!entry.signingKey.isEmpty()) {
+            channel[QLatin1String("signingKey")] = entry.signingKey;
+        }
+        channels << channel;
+    }
+    QJsonArray keyrings;
+    const QDir keyringDir(dir.filePath(QLatin1String("keyrings")));
+    for(const QString& name : keyringDir.entryList(QDir::Files, QDir::Name)) {
+        const QByteArray sha256 = FileHash::sha256(keyringDir.filePath(name));
+        if(sha256.isEmpty()) {
+            continue;
+        }
+        QJsonObject keyring;
+        keyring[QLatin1String("file")] = name;
+        keyring[QLatin1String("sha256")] = QString::fromLatin1(sha256.toHex());
+        keyrings << keyring;
+    }
+    QJsonObject root;
+    root[QLatin1String("version")] = manifestVersion;
+    root[QLatin1String("channels")] = channels;
+    if(!keyrings.isEmpty()) {
+        root[QLatin1String("keyrings")] = keyrings;
+    }
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
@@ -0,0 +1,116 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHANNELMANIFEST_H
+#define CHANNELMANIFEST_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+/**
+ * What a channel directory's manifest says about one of the channel files in it
+ */
+struct ManifestEntry
+{
+    /**
+     * The name of the channel file, which is also the name it gets in sources.list.d
+     */
+    QString file;
+    QString title;
+    QString description;
+    /**
+     * SHA-256 of the channel file's contents
+     */
+    QByteArray sha256;
+    /**
+     * The keyring the channel's sources are signed with (their signed-by option), if they
+     * all agree on one
+     */
+    QString signingKey;
+};
+
+/**
+ * An optional index of all the channels in a directory, so that the list of channels can be
+ * shown after reading just the one file, rather than opening every single channel file. It is
+ * meant to be generated when the channels are packaged, using "repotoggle manifest <dir>".
+ *
+ * The manifest is a JSON file, along the lines of
+ * {
+ *     "version": 1,
+ *     "channels": [
+ *         { "file": "example.list", "title": "Example", "description": "An example channel",
+ *           "sha256": "...", "signingKey": "/etc/apt/keyrings/example.gpg" }
+ *     ],
+ *     "keyrings": [
+ *         { "file": "example.gpg", "sha256": "..." }
+ *     ]
+ * }
+ *
+ * Channel files which are not listed in the manifest are still read as normal, and entries in
+ * the manifest for files which do not exist are ignored. The keyrings are those shipped in the
+ * keyrings directory inside the channel directory (see ChannelVerifier), which the manifest
+ * vouches for just like it does for the channels.
+ */
+class ChannelManifest
+{
+public:
+    /**
+     * The name of the manifest file inside a channel directory
+     */
+    static QString fileName();
+
+    /**
+     * The name of the manifest's detached signature inside a channel directory, if it is signed
+     */
+    static QString signatureFileName();
+
+    /**
+     * Read the manifest in a channel directory. If there is none, or it cannot be read, this
+     * is empty.
+     *
+     * @param directory The channel directory
+     * @return The entries, by the name of the channel file they describe
+     */
+    static QHash<QString, ManifestEntry> load(const QString& directory);
+
+    /**
+     * Read the keyrings listed in the manifest in a channel directory
+     *
+     * @param directory The channel directory
+     * @return The SHA-256 of each keyring, by its file name inside the keyrings directory
+     */
+    static QHash<QString, QByteArray> loadKeyrings(const QString& directory);
+
+    /**
+     * Describe a single channel file the way its manifest entry would
+     */
+    static ManifestEntry describe(const QString& path);
+
+    /**
+     * Build the manifest for all the channel files in a directory, and the keyrings shipped with them
+     *
+     * @param directory The channel directory
+     * @return The contents of the manifest file
+     */
+    static QByteArray generate(const QString& directory);
+};
+
+#endif//CHANNELMANIFEST_H
@@ -0,0 +1,362 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChannelModel.h"
+
+#include <KLocalizedString>
+
+#include <QSet>
+
+class ChannelModel::Private {
+public:
+    Private()
+        : dirtyCount(0)
+    {}
+    struct Entry {
+        Channel channel;
+        Qt::CheckState pending;
+        ProbeState probeState = NotProbed;
+        int latency = -1;
+        bool isDirty() const { return pending != channel.state; }
+    };
+    // Kept as one contiguous vector, with a path lookup on the side, so finding
+    // a channel again when a new scan comes in does not mean walking the list
+    QVector<Entry> entries;
+    QHash<QString, int> rows;
+    // The number of entries whose pending state differs from the on-disk state,
+    // kept up to date as we go so we never have to count
+    int dirtyCount;
+
+    bool isValid(const QModelIndex& index) const
+    {
+        return index.isValid() && !index.parent().isValid() && index.row() >= 0 && index.row() < entries.count();
+    }
+
+    void rebuildRows()
+    {
+        rows.clear();
+        rows.reserve(entries.count());
+        for(int i = 0; i < entries.count(); ++i) {
+            rows.insert(entries.at(i).channel.path, i);
+        }
+    }
+};
+
+ChannelModel::ChannelModel(QObject* parent)
+    : QAbstractListModel(parent)
+    , d(new Private)
+{
+}
+
+ChannelModel::~ChannelModel()
+{
+    delete d;
+}
+
+QHash<int, QByteArray> ChannelModel::roleNames() const
+{
+    QHash<int, QByteArray> roles = QAbstractListModel::roleNames();
+    roles[PathRole] = "path";
+    roles[FileNameRole] = "fileName";
+    roles[TitleRole] = "title";
+    roles[DescriptionRole] = "description";
+    roles[CurrentStateRole] = "currentState";
+    roles[ConflictRole] = "conflict";
+    roles[PendingStateRole] = "pendingState";
+    roles[ProbeStateRole] = "probeState";
+    roles[LatencyRole] = "latency";
+    roles[GeneralUseRole] = "generalUse";
+    return roles;
+}
+
+int ChannelModel::rowCount(const QModelIndex& parent) const
+{
+    if(parent.isValid()) {
+        return 0;
+    }
+    return d->entries.count();
+}
+
+QVariant ChannelModel::data(const QModelIndex& index, int role) const
+{
+    if(!d->isValid(index)) {
+        return QVariant();
+    }
+    const Private::Entry& entry = d->entries.at(index.row());
+    switch(role) {
+    case Qt::DisplayRole:
+    {
+        QString text = entry.channel.title;
+        switch(entry.probeState) {
+        case Probing:
+            text = i18nc("A channel's title, while checking whether its repositories can be reached", "%1 (checking...)", text);
+            break;
+        case Reachable:
+            if(entry.latency >= 0) {
+                text = i18nc("A channel's title, with how long its slowest repository took to answer", "%1 (reachable, %2 ms)", text, entry.latency);
+            }
+            break;
+        case Unreachable:
+            text = i18nc("A channel's title, when at least one of its repositories could not be reached", "%1 (unreachable)", text);
+            break;
+        case NotProbed:
+        default:
+            break;
+        }
+        if(!entry.channel.description.isEmpty()) {
+            text += QLatin1Char('\n') + entry.channel.description;
+        }
+        // Conflicts are shown by the delegate, and explained in the tool tip
+        return text;
+    }
+    case Qt::ToolTipRole:
+        if(entry.channel.conflict) {
+            QString tip = i18nc("Checkbox tool tip which shows when the contents differ between the channel's .lists file and the .lists file with the same name in apt's soources.lists.d", "This entry cannot be enabled, as a channel with this filename already exists, but the contents differ.");
+            tip += QLatin1Char(' ') + i18nc("Part of the tool tip for a channel in conflict, with the path of the installed file", "Double click it, or use Show Differences, to see how it differs from %1, and to replace that file with the channel's own.", entry.channel.installedPath);
+            if(!entry.channel.channelOnlyEntries.isEmpty()) {
+                tip += QLatin1String("\n\n") + i18nc("Part of the tool tip for a channel in conflict, followed by the sources (one per line) which are in the channel, but not in the installed file", "Only in this channel:\n%1", entry.channel.channelOnlyEntries.join(QLatin1Char('\n')));
+            }
+            if(!entry.channel.installedOnlyEntries.isEmpty()) {
+                tip += QLatin1String("\n\n") + i18nc("Part of the tool tip for a channel in conflict, with the path of the installed file, followed by the sources (one per line) which are in the installed file, but not in the channel", "Only in %1:\n%2", entry.channel.installedPath, entry.channel.installedOnlyEntries.join(QLatin1Char('\n')));
+            }
+            return tip;
+        }
+        return entry.channel.description;
+    case Qt::CheckStateRole:
+    case PendingStateRole:
+        return entry.pending;
+    case PathRole:
+        return entry.channel.path;
+    case FileNameRole:
+        return entry.channel.fileName;
+    case TitleRole:
+        return entry.channel.title;
+    case DescriptionRole:
+        return entry.channel.description;
+    case CurrentStateRole:
+        return entry.channel.state;
+    case ConflictRole:
+        return entry.channel.conflict;
+    case ProbeStateRole:
+        return entry.probeState;
+    case LatencyRole:
+        return entry.latency;
+    case GeneralUseRole:
+        // That is, not specific to any one distribution
+        return entry.channel.path.section(QLatin1Char('/'), -2, -2) == QLatin1String("general-use");
+    default:
+        break;
+    }
+    return QVariant();
+}
+
+bool ChannelModel::setData(const QModelIndex& index, const QVariant& value, int role)
+{
+    if(!d->isValid(index) || (role != Qt::CheckStateRole && role != PendingStateRole)) {
+        return false;
+    }
+    Private::Entry& entry = d->entries[index.row()];
+    Qt::CheckState pending = static_cast<Qt::CheckState>(value.toInt());
+    // Channels in conflict with something already installed cannot be touched, and
+    // there is no middle state for a channel to be in.
+    if(entry.channel.conflict || pending == Qt::PartiallyChecked) {
+        return false;
+    }
+    if(entry.pending == pending) {
+        return true;
+    }
+    const bool wasDirty = d->dirtyCount > 0;
+    d->dirtyCount += entry.isDirty() ? -1 : 0;
+    entry.pending = pending;
+    d->dirtyCount += entry.isDirty() ? 1 : 0;
+    Q_EMIT dataChanged(index, index, QVector<int>() << Qt::CheckStateRole << PendingStateRole);
+    if(wasDirty != (d->dirtyCount > 0)) {
+        Q_EMIT dirtyChanged(d->dirtyCount > 0);
+    }
+    return true;
+}
+
+Qt::ItemFlags ChannelModel::flags(const QModelIndex& index) const
+{
+    if(!d->isValid(index)) {
+        return Qt::NoItemFlags;
+    }
+    // Channels in conflict can still be selected, so the user can go and look at why, they
+    // just cannot be checked
+    if(d->entries.at(index.row()).channel.conflict) {
+        return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemNeverHasChildren;
+    }
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsUserCheckable | Qt::ItemNeverHasChildren;
+}
+
+void ChannelModel::setChannels(const QVector<Channel>& channels)
+{
+    const bool wasDirty = d->dirtyCount > 0;
+
+    QSet<QString> incoming;
+    incoming.reserve(channels.count());
+    for(const Channel& channel : channels) {
+        incoming.insert(channel.path);
+    }
+
+    // Get rid of anything which has gone away, in contiguous runs, from the end, so
+    // the rows we have not yet looked at stay where they are
+    int row = d->entries.count() - 1;
+    while(row >= 0) {
+        if(incoming.contains(d->entries.at(row).channel.path)) {
+            --row;
+            continue;
+        }
+        int first = row;
+        while(first > 0 && !incoming.contains(d->entries.at(first - 1).channel.path)) {
+            --first;
+        }
+        beginRemoveRows(QModelIndex(), first, row);
+        for(int i = first; i <= row; ++i) {
+            if(d->entries.at(i).isDirty()) {
+                --d->dirtyCount;
+            }
+        }
+        d->entries.remove(first, row - first + 1);
+        endRemoveRows();
+        row = first - 1;
+    }
+    d->rebuildRows();
+
+    QVector<Channel> added;
+    for(const Channel& channel : channels) {
+        QHash<QString, int>::const_iterator existing = d->rows.constFind(channel.path);
+        if(existing == d->rows.constEnd()) {
+            added << channel;
+            continue;
+        }
+        Private::Entry& entry = d->entries[existing.value()];
+        if(entry.channel == channel) {
+            continue;
+        }
+        if(entry.isDirty()) {
+            --d->dirtyCount;
+        }
+        entry.channel = channel;
+        // If what is installed now conflicts with the channel, whatever the user wanted is
+        // no longer possible, so drop that
+        if(channel.conflict) {
+            entry.pending = channel.state;
+        }
+        if(entry.isDirty()) {
+            ++d->dirtyCount;
+        }
+        QModelIndex idx = index(existing.value());
+        Q_EMIT dataChanged(idx, idx);
+    }
+
+    if(!added.isEmpty()) {
+        const int first = d->entries.count();
+        beginInsertRows(QModelIndex(), first, first + added.count() - 1);
+        for(const Channel& channel : added) {
+            Private::Entry entry;
+            entry.channel = channel;
+            entry.pending = channel.state;
+            d->rows.insert(channel.path, d->entries.count());
+            d->entries << entry;
+        }
+        endInsertRows();
+    }
+
+    if(wasDirty != (d->dirtyCount > 0)) {
+        Q_EMIT dirtyChanged(d->dirtyCount > 0);
+    }
+}
+
+bool ChannelModel::isDirty() const
+{
+    return d->dirtyCount > 0;
+}
+
+QVariantMap ChannelModel::changes() const
+{
+    QVariantMap changes;
+    if(d->dirtyCount == 0) {
+        return changes;
+    }
+    for(const Private::Entry& entry : d->entries) {
+        if(entry.isDirty()) {
+            changes[entry.channel.path] = int(entry.pending);
+        }
+    }
+    return changes;
+}
+
+void ChannelModel::setProbeState(const QString& path, ProbeState state, int latency)
+{
+    QHash<QString, int>::const_iterator row = d->rows.constFind(path);
+    if(row == d->rows.constEnd()) {
+        return;
+    }
+    Private::Entry& entry = d->entries[row.value()];
+    if(entry.probeState == state && entry.latency == latency) {
+        return;
+    }
+    entry.probeState = state;
+    entry.latency = latency;
+    QModelIndex idx = index(row.value());
+    Q_EMIT dataChanged(idx, idx, QVector<int>() << Qt::DisplayRole << ProbeStateRole << LatencyRole);
+}
+
+void ChannelModel::resetPendingStates()
+{
+    if(d->dirtyCount == 0) {
+        return;
+    }
+    for(int i = 0; i < d->entries.count(); ++i) {
+        Private::Entry& entry = d->entries[i];
+        if(entry.isDirty()) {
+            entry.pending = entry.channel.state;
+            QModelIndex idx = index(i);
+            Q_EMIT dataChanged(idx, idx, QVector<int>() << Qt::CheckStateRole << PendingStateRole);
+        }
+    }
+    d->dirtyCount = 0;
+    Q_EMIT dirtyChanged(false);
+}
+
+void ChannelModel::setPendingStates(const QVariantMap& changes)
+{
+    const bool wasDirty = d->dirtyCount > 0;
+    for(int i = 0; i < d->entries.count(); ++i) {
+        Private::Entry& entry = d->entries[i];
+        Qt::CheckState pending = entry.channel.state;
+        QVariantMap::const_iterator change = changes.constFind(entry.channel.path);
+        if(change != changes.constEnd() && !entry.channel.conflict && change.value().toInt() != Qt::PartiallyChecked) {
+            pending = static_cast<Qt::CheckState>(change.value().toInt());
+        }
+        if(entry.pending == pending) {
+            continue;
+        }
+        d->dirtyCount += entry.isDirty() ? -1 : 0;
+        entry.pending = pending;
+        d->dirtyCount += entry.isDirty() ? 1 : 0;
+        QModelIndex idx = index(i);
+        Q_EMIT dataChanged(idx, idx, QVector<int>() << Qt::CheckStateRole << PendingStateRole);
+    }
+    if(wasDirty != (d->dirtyCount > 0)) {
+        Q_EMIT dirtyChanged(d->dirtyCount > 0);
+    }
+}
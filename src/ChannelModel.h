@@ -0,0 +1,124 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHANNELMODEL_H
+#define CHANNELMODEL_H
+
+#include "ChannelScanner.h"
+
+#include <QAbstractListModel>
+#include <QHash>
+
+/**
+ * The list of known software channels, along with both their on-disk state, and the
+ * state the user would like them to be in once changes are applied.
+ */
+class ChannelModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum Roles {
+        PathRole = Qt::UserRole + 1,
+        FileNameRole,
+        TitleRole,
+        DescriptionRole,
+        CurrentStateRole,
+        ConflictRole,
+        PendingStateRole,
+        ProbeStateRole,
+        LatencyRole,
+        GeneralUseRole
+    };
+
+    /**
+     * What is known about whether a channel's repositories can be reached
+     */
+    enum ProbeState {
+        NotProbed,
+        Probing,
+        Reachable,
+        Unreachable
+    };
+
+    explicit ChannelModel(QObject* parent = 0);
+    virtual ~ChannelModel();
+
+    virtual QHash<int, QByteArray> roleNames() const;
+    virtual int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    virtual bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole);
+    virtual Qt::ItemFlags flags(const QModelIndex& index) const;
+
+    /**
+     * Replace the known channels with the ones passed here. Rows are matched up by the
+     * channel's path, so channels which are unchanged cause no notifications at all,
+     * changed ones only cause dataChanged, and only new or vanished channels cause
+     * rows to be inserted or removed. Pending changes are kept for channels which
+     * have not since reached the state the user asked for.
+     *
+     * @param channels The channels as most recently scanned
+     */
+    void setChannels(const QVector<Channel>& channels);
+
+    /**
+     * Whether there are any channels whose pending state differs from their state on disk
+     */
+    bool isDirty() const;
+
+    /**
+     * All pending changes, in the form expected by the helper (the channel's path
+     * as key, and the wanted Qt::CheckState as value)
+     */
+    QVariantMap changes() const;
+
+    /**
+     * Throw away all pending changes
+     */
+    void resetPendingStates();
+
+    /**
+     * Throw away all pending changes, and replace them with these, in one go
+     *
+     * @param changes The channel paths to change, with the wanted Qt::CheckState as value (in the
+     *                form returned by changes()). Channels in conflict, and unknown ones, are skipped.
+     */
+    void setPendingStates(const QVariantMap& changes);
+
+    /**
+     * Set what is known about whether a channel's repositories can be reached
+     *
+     * @param path The channel's path
+     * @param state The new state
+     * @param latency How long the slowest of the repositories took to answer, in milliseconds,
+     *                or -1 if that is not known
+     */
+    void setProbeState(const QString& path, ProbeState state, int latency = -1);
+
+    /**
+     * Emitted whenever the model goes from having no pending changes to having some,
+     * or the other way around.
+     */
+    Q_SIGNAL void dirtyChanged(bool dirty);
+private:
+    class Private;
+    Private* d;
+};
+
+#endif//CHANNELMODEL_H
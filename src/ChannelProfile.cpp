@@ -0,0 +1,189 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChannelProfile.h"
+
+#include "Logging.h"
+
+#include <KLocalizedString>
+
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+// Bump this if the format ever changes in a way older versions would misread
+static const int profileVersion = 1;
+
+QStringList ChannelProfiles::directories()
+{
+    QStringList directories;
+    for(const QString& path : QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation)) {
+        directories << QString("%1/release-channels/profiles").arg(path);
+    }
+    return directories;
+}
+
+static bool readProfile(const QString& path, ChannelProfile& profile)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if(error.error != QJsonParseError::NoError || !document.isObject()) {
+        qCWarning(KCMREPOTOGGLE_MODULE) << "The channel profile" << path << "could not be read, ignoring it:" << error.errorString();
+        return false;
+    }
+    const QJsonObject root = document.object();
+    if(root.value(QLatin1String("version")).toInt() != profileVersion) {
+        qCWarning(KCMREPOTOGGLE_MODULE) << "The channel profile" << path << "is of an unknown version, ignoring it";
+        return false;
+    }
+    profile.path = path;
+    profile.title = root.value(QLatin1String("title")).toString();
+    profile.description = root.value(QLatin1String("description")).toString();
+    for(const QJsonValue& value : root.value(QLatin1String("channels")).toArray()) {
+        const QString channel = value.toString();
+        // Only ever the names of files in sources.list.d, never paths
+        if(!channel.isEmpty() && !channel.contains(QLatin1Char('/')) && !profile.channels.contains(channel)) {
+            profile.channels << channel;
+        }
+    }
+    return true;
+}
+
+QVector<ChannelProfile> ChannelProfiles::load()
+{
+    QVector<ChannelProfile> profiles;
+    QSet<QString> seen;
+    for(const QString& directory : directories()) {
+        const QDir dir(directory);
+        for(const QString& entry : dir.entryList(QStringList() << QLatin1String("*.json"), QDir::Files, QDir::Name)) {
+            ChannelProfile profile;
+            profile.name = entry.left(entry.length() - 5);
+            if(seen.contains(profile.name) || !readProfile(dir.filePath(entry), profile)) {
+                continue;
+            }
+            if(profile.title.isEmpty()) {
+                profile.title = profile.name;
+            }
+            seen << profile.name;
+            profiles << profile;
+        }
+    }
+    std::sort(profiles.begin(), profiles.end(), [](const ChannelProfile& first, const ChannelProfile& second){
+        return first.title.localeAwareCompare(second.title) < 0;
+    });
+    return profiles;
+}
+
+const ChannelProfile* ChannelProfiles::find(const QVector<ChannelProfile>& profiles, const QString& name)
+{
+    for(const ChannelProfile& profile : profiles) {
+        if(profile.name == name) {
+            return &profile;
+        }
+    }
+    for(const ChannelProfile& profile : profiles) {
+        if(profile.title == name) {
+            return &profile;
+        }
+    }
+    return 0;
+}
+
+ChannelProfile ChannelProfiles::fromChannels(const QString& name, const QString& title, const QVector<Channel>& channels)
+{
+    ChannelProfile profile;
+    profile.name = name;
+    profile.title = title.isEmpty() ? name : title;
+    for(const Channel& channel : channels) {
+        if(channel.state == Qt::Checked) {
+            profile.channels << channel.fileName;
+        }
+    }
+    return profile;
+}
+
+bool ChannelProfiles::save(const ChannelProfile& profile, QString* error)
+{
+    if(profile.name.isEmpty() || profile.name.contains(QLatin1Char('/')) || profile.name.startsWith(QLatin1Char('.'))) {
+        *error = i18nc("Error when saving a channel profile with a name which cannot be used as a file name", "%1 cannot be used as the name of a profile", profile.name);
+        return false;
+    }
+    const QString directory = QString("%1/release-channels/profiles").arg(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation));
+    if(!QDir().mkpath(directory)) {
+        *error = i18nc("Error when the directory for saving channel profiles in could not be created", "Could not create %1", directory);
+        return false;
+    }
+
+    QJsonObject root;
+    root[QLatin1String("version")] = profileVersion;
+    root[QLatin1String("title")] = profile.title;
+    if(!profile.description.isEmpty()) {
+        root[QLatin1String("description")] = profile.description;
+    }
+    root[QLatin1String("channels")] = QJsonArray::fromStringList(profile.channels);
+
+    QSaveFile file(QString("%1/%2.json").arg(directory).arg(profile.name));
+    if(!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(root).toJson()) < 0 || !file.commit()) {
+        *error = i18nc("Error when a channel profile could not be written, followed by the reason", "Could not write %1: %2", file.fileName(), file.errorString());
+        return false;
+    }
+    return true;
+}
+
+QVariantMap ChannelProfiles::changes(const ChannelProfile& profile, const QVector<Channel>& channels, QStringList* missing)
+{
+    QVariantMap changes;
+    QSet<QString> found;
+    for(const Channel& channel : channels) {
+        const bool wanted = profile.channels.contains(channel.fileName);
+        if(wanted) {
+            found << channel.fileName;
+        }
+        if(channel.conflict) {
+            continue;
+        }
+        if(wanted && channel.state != Qt::Checked) {
+            changes[channel.path] = int(Qt::Checked);
+        }
+        else if(!wanted && channel.state == Qt::Checked) {
+            changes[channel.path] = int(Qt::Unchecked);
+        }
+    }
+    if(missing) {
+        missing->clear();
+        for(const QString& name : profile.channels) {
+            if(!found.contains(name)) {
+                *missing << name;
+            }
+        }
+    }
+    return changes;
+}
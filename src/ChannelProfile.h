@@ -0,0 +1,119 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHANNELPROFILE_H
+#define CHANNELPROFILE_H
+
+#include "ChannelScanner.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+#include <QVector>
+
+/**
+ * A named set of channels, such as "stable", "beta" or "dev"
+ */
+struct ChannelProfile
+{
+    /**
+     * The name of the profile's file, without the .json, which is also what it is asked for by
+     */
+    QString name;
+    QString title;
+    QString description;
+    /**
+     * The file names of the channels which should be enabled. Every other channel is disabled.
+     */
+    QStringList channels;
+    /**
+     * The full path of the file the profile was read from
+     */
+    QString path;
+};
+
+/**
+ * Profiles are JSON files in release-channels/profiles, in the generic data locations
+ * (alongside release-channels/channels), along the lines of
+ * {
+ *     "version": 1,
+ *     "title": "Beta",
+ *     "description": "The next release, before it is released",
+ *     "channels": [ "example.list", "example-beta.list" ]
+ * }
+ *
+ * Switching to a profile is worked out as the difference between its channels and what is
+ * enabled right now, so it all goes to the helper as one set of changes, with one
+ * authentication and at most one refresh.
+ */
+class ChannelProfiles
+{
+public:
+    /**
+     * The directories profiles are looked for in, most important first. Profiles saved by
+     * the user go in the first one.
+     */
+    static QStringList directories();
+
+    /**
+     * All the profiles there are, by title. When more than one directory has a profile by the
+     * same name, the one in the directory listed first in directories() wins.
+     */
+    static QVector<ChannelProfile> load();
+
+    /**
+     * Find a profile by its name or title
+     *
+     * @param profiles The profiles to look through, as returned by load()
+     * @param name The name or title to look for
+     * @return The profile, or 0 if there is none by that name
+     */
+    static const ChannelProfile* find(const QVector<ChannelProfile>& profiles, const QString& name);
+
+    /**
+     * A profile with the channels which are enabled right now
+     *
+     * @param name The name to give the profile
+     * @param title The title to give the profile
+     * @param channels The channels as most recently scanned
+     */
+    static ChannelProfile fromChannels(const QString& name, const QString& title, const QVector<Channel>& channels);
+
+    /**
+     * Write a profile into the user's own profile directory, replacing any by the same name there
+     *
+     * @param profile The profile to save. Its path is not used.
+     * @param error Set to why saving failed, if it did
+     * @return Whether the profile was saved
+     */
+    static bool save(const ChannelProfile& profile, QString* error);
+
+    /**
+     * The changes needed to go from the channels as they are to the ones in a profile, in the
+     * form expected by the helper. Channels in conflict are left alone.
+     *
+     * @param profile The profile to switch to
+     * @param channels The channels as most recently scanned
+     * @param missing If given, set to the channels in the profile which do not exist
+     */
+    static QVariantMap changes(const ChannelProfile& profile, const QVector<Channel>& channels, QStringList* missing = 0);
+};
+
+#endif//CHANNELPROFILE_H
@@ -0,0 +1,315 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChannelScanner.h"
+
+#include "ChannelManifest.h"
+#include "FileHash.h"
+#include "OSRelease.h"
+#include "ScanCache.h"
+#include "SourcesParser.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <sys/stat.h>
+
+QStringList ChannelScanner::channelDirectories()
+{
+    const OSRelease os = OSRelease::current();
+    // From the most specific to the least, so that a distribution can override a channel
+    // it inherits from the one it is based on, simply by shipping a file with the same name
+    QStringList levels;
+    if(!os.versionId.isEmpty()) {
+        levels << QString("%1/%2").arg(os.id).arg(os.versionId);
+    }
+    levels << os.id;
+    for(const QString& like : os.idLike) {
+        if(!levels.contains(like)) {
+            levels << like;
+        }
+    }
+    levels << QLatin1String("general-use");
+
+    // Not QStandardPaths, as that would give the helper root's data locations, and the module the
+    // user's, and so channels the helper would refuse to install. Only the system-wide ones count.
+    QStringList paths;
+    paths << QLatin1String(KCMREPOTOGGLE_DATA_INSTALL_DIR) << QLatin1String("/usr/local/share") << QLatin1String("/usr/share");
+    paths.removeDuplicates();
+
+    QStringList directories;
+    for(const QString& level : levels) {
+        for(const QString& path : paths) {
+            const QString directory = QString("%1/release-channels/channels/%2").arg(path).arg(level);
+            if(!directories.contains(directory)) {
+                directories << directory;
+            }
+        }
+    }
+    return directories;
+}
+
+static bool statFile(const QString& path, ScannedFile& scanned)
+{
+    struct stat info;
+    if(::stat(QFile::encodeName(path).constData(), &info) != 0) {
+        return false;
+    }
+    scanned.modified = qint64(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    scanned.size = info.st_size;
+    scanned.inode = info.st_ino;
+    return true;
+}
+
+static bool isUnchanged(const ScannedDirectory& previous, const QString& name, const ScannedFile& scanned)
+{
+    ScannedDirectory::const_iterator known = previous.constFind(name);
+    return known != previous.constEnd() && known.value().modified == scanned.modified && known.value().size == scanned.size && known.value().inode == scanned.inode;
+}
+
+ScannedDirectory ChannelScanner::scanDirectory(const QString& path, const ScannedDirectory& previous, bool channelFiles)
+{
+    ScannedDirectory result;
+    QDir directory(path);
+    if(!directory.exists()) {
+        return result;
+    }
+
+    // The manifest is kept alongside the channel files in the scan, so we can tell when it changes.
+    // If it did, everything it describes needs looking at again, even the files which did not change.
+    const QString manifestName = ChannelManifest::fileName();
+    bool manifestChanged = false;
+    bool manifestLoaded = false;
+    QHash<QString, ManifestEntry> manifest;
+    if(channelFiles) {
+        ScannedFile scanned;
+        if(statFile(QString("%1/%2").arg(path).arg(manifestName), scanned)) {
+            manifestChanged = !isUnchanged(previous, manifestName, scanned);
+            result.insert(manifestName, scanned);
+        }
+        else {
+            manifestChanged = previous.contains(manifestName);
+            manifestLoaded = true;
+        }
+    }
+
+    // The manifest's signature is not a channel either, and only the helper ever looks at it
+    for(const QString& name : directory.entryList(QDir::Files)) {
+        if(channelFiles && (name == manifestName || name == ChannelManifest::signatureFileName())) {
+            continue;
+        }
+        const QString filePath = QString("%1/%2").arg(path).arg(name);
+        ScannedFile scanned;
+        if(!statFile(filePath, scanned)) {
+            continue;
+        }
+
+        // Nothing changed since last we looked, so there's no need to read it again
+        if(!manifestChanged && isUnchanged(previous, name, scanned)) {
+            result.insert(name, previous.value(name));
+            continue;
+        }
+
+        if(channelFiles && !manifestLoaded) {
+            // Only read the manifest if there's actually something to look up in it
+            manifest = ChannelManifest::load(path);
+            manifestLoaded = true;
+        }
+        QHash<QString, ManifestEntry>::const_iterator entry = manifest.constFind(name);
+        if(entry != manifest.constEnd()) {
+            scanned.title = entry.value().title;
+            scanned.description = entry.value().description;
+            scanned.signingKey = entry.value().signingKey;
+            // The manifest's hash is deliberately not used here: whether a channel is enabled is
+            // decided by comparing what is actually in the files, not what they are meant to contain
+        }
+        else if(channelFiles) {
+            QFile file(filePath);
+            if(file.open(QIODevice::ReadOnly)) {
+                QString first = QString::fromUtf8(file.readLine());
+                // Is the first line a comment? Use that as the title
+                if(first.startsWith("#")) {
+                    scanned.title = first.mid(1).trimmed();
+                }
+                // How about the second line? That'll be our description
+                QString second = QString::fromUtf8(file.readLine());
+                if(second.startsWith("#")) {
+                    scanned.description = second.mid(1).trimmed();
+                }
+                file.close();
+            }
+        }
+        result.insert(name, scanned);
+    }
+    return result;
+}
+
+ChannelScanState ChannelScanner::scan(const QString& sldDir)
+{
+    return scan(sldDir, channelDirectories(), true);
+}
+
+ChannelScanState ChannelScanner::scan(const QString& sldDir, const QStringList& channelDirs, bool persistent)
+{
+    ChannelScanState state;
+    state.sldDir = sldDir;
+    while(state.sldDir.endsWith("/")) {
+        state.sldDir = state.sldDir.left(state.sldDir.length() - 1);
+    }
+    state.channelDirs = channelDirs;
+    state.persistent = persistent;
+    if(persistent) {
+        const QHash<QString, ScannedDirectory> cached = ScanCache::load();
+        state.installed = cached.value(state.sldDir);
+        for(const QString& channelsPath : state.channelDirs) {
+            state.channelFiles[channelsPath] = cached.value(channelsPath);
+        }
+    }
+    return rescan(state, QStringList() << state.sldDir << state.channelDirs);
+}
+
+ChannelScanState ChannelScanner::rescan(ChannelScanState state, const QStringList& changedDirectories)
+{
+    for(const QString& path : changedDirectories) {
+        if(path == state.sldDir) {
+            state.installed = scanDirectory(path, state.installed, false);
+        }
+        else if(state.channelDirs.contains(path)) {
+            state.channelFiles[path] = scanDirectory(path, state.channelFiles.value(path), true);
+        }
+    }
+
+    // Work out which file each channel name comes from once, here, so nothing else needs to go
+    // looking through the directories in order again. This is one pass over what the scan
+    // already found, however many directories there are.
+    state.resolved.clear();
+    for(const QString& channelsPath : state.channelDirs) {
+        const ScannedDirectory& files = state.channelFiles[channelsPath];
+        for(ScannedDirectory::const_iterator it = files.constBegin(); it != files.constEnd(); ++it) {
+            if(it.key() != ChannelManifest::fileName() && !state.resolved.contains(it.key())) {
+                state.resolved.insert(it.key(), channelsPath);
+            }
+        }
+    }
+
+    // The only files whose contents we care about are the ones where a channel and an installed
+    // file share a name. If they're the same size, they may well be byte for byte the same, which
+    // is cheap to check. If not, they may still describe the same sources, just written differently.
+    state.conflicts.clear();
+    for(QHash<QString, QString>::const_iterator it = state.resolved.constBegin(); it != state.resolved.constEnd(); ++it) {
+        ScannedDirectory::iterator installed = state.installed.find(it.key());
+        if(installed == state.installed.end()) {
+            continue;
+        }
+        const QString channelPath = QString("%1/%2").arg(it.value()).arg(it.key());
+        const QString installedPath = QString("%1/%2").arg(state.sldDir).arg(installed.key());
+        ScannedFile& channel = state.channelFiles[it.value()][it.key()];
+        if(installed.value().size == channel.size) {
+            if(channel.hash.isEmpty()) {
+                channel.hash = FileHash::sha256(channelPath);
+            }
+            if(installed.value().hash.isEmpty()) {
+                installed.value().hash = FileHash::sha256(installedPath);
+            }
+            if(!channel.hash.isEmpty() && channel.hash == installed.value().hash) {
+                continue;
+            }
+        }
+
+        QVector<SourceEntry> channelEntries;
+        QVector<SourceEntry> installedEntries;
+        if(channel.sourcesHash.isEmpty()) {
+            channelEntries = SourcesParser::parseFile(channelPath);
+            channel.sourcesHash = SourcesParser::digest(channelEntries);
+        }
+        if(installed.value().sourcesHash.isEmpty()) {
+            installedEntries = SourcesParser::parseFile(installedPath);
+            installed.value().sourcesHash = SourcesParser::digest(installedEntries);
+        }
+        // Two files without any sources in them say nothing, rather than the same thing
+        static const QByteArray noSources = SourcesParser::digest(QVector<SourceEntry>());
+        if(channel.sourcesHash == installed.value().sourcesHash && channel.sourcesHash != noSources) {
+            continue;
+        }
+
+        // An actual conflict, so work out which of the sources are the problem. This only ever
+        // happens for the (hopefully very few) conflicting files, so they are simply read again
+        // here if their digest came from the cache.
+        if(channelEntries.isEmpty()) {
+            channelEntries = SourcesParser::parseFile(channelPath);
+        }
+        if(installedEntries.isEmpty()) {
+            installedEntries = SourcesParser::parseFile(installedPath);
+        }
+        QPair<QStringList, QStringList>& conflict = state.conflicts[it.key()];
+        for(const SourceEntry& entry : channelEntries) {
+            if(!installedEntries.contains(entry)) {
+                conflict.first << entry.toString();
+            }
+        }
+        for(const SourceEntry& entry : installedEntries) {
+            if(!channelEntries.contains(entry)) {
+                conflict.second << entry.toString();
+            }
+        }
+    }
+
+    if(state.persistent) {
+        ScanCache::save(state);
+    }
+    return state;
+}
+
+QVector<Channel> ChannelScanner::channels(const ChannelScanState& state)
+{
+    QVector<Channel> result;
+    for(const QString& channelsPath : state.channelDirs) {
+        const ScannedDirectory files = state.channelFiles.value(channelsPath);
+        for(ScannedDirectory::const_iterator it = files.constBegin(); it != files.constEnd(); ++it) {
+            // Overridden by a file of the same name somewhere more specific
+            if(state.resolved.value(it.key()) != channelsPath) {
+                continue;
+            }
+            Channel channel;
+            channel.path = QString("%1/%2").arg(channelsPath).arg(it.key());
+            channel.fileName = it.key();
+            channel.title = it.value().title.isEmpty() ? it.key() : it.value().title;
+            channel.description = it.value().description;
+            channel.signingKey = it.value().signingKey;
+            // if file exists in /etc/apt/sources.lists.d/...
+            ScannedDirectory::const_iterator installed = state.installed.constFind(it.key());
+            if(installed != state.installed.constEnd()) {
+                channel.installedPath = QString("%1/%2").arg(state.sldDir).arg(it.key());
+                // and is identical to our file, or says the same thing, it is enabled...
+                if(!state.conflicts.contains(it.key())) {
+                    channel.state = Qt::Checked;
+                }
+                // and is different from our file, it is in conflict with something else
+                else {
+                    channel.conflict = true;
+                    channel.channelOnlyEntries = state.conflicts.value(it.key()).first;
+                    channel.installedOnlyEntries = state.conflicts.value(it.key()).second;
+                }
+            }
+            result << channel;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,230 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHANNELSCANNER_H
+#define CHANNELSCANNER_H
+
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * A single software channel as found on disk, and how it relates to what
+ * is currently installed in apt's sources.list.d
+ */
+struct Channel
+{
+    /**
+     * The full path of the channel's lists file
+     */
+    QString path;
+    /**
+     * The name the file has (and will have) inside sources.list.d
+     */
+    QString fileName;
+    /**
+     * The first comment line of the file, or the file name if there is none
+     */
+    QString title;
+    /**
+     * The second comment line of the file, if there is one
+     */
+    QString description;
+    /**
+     * Whether the channel is currently enabled (Qt::Checked) or not (Qt::Unchecked)
+     */
+    Qt::CheckState state = Qt::Unchecked;
+    /**
+     * Set when sources.list.d contains a file with the same name, but different contents
+     */
+    bool conflict = false;
+    /**
+     * The full path of the file with the same name in sources.list.d, if there is one
+     */
+    QString installedPath;
+    /**
+     * The keyring the channel's sources are signed with, if its directory's manifest says
+     */
+    QString signingKey;
+    /**
+     * When in conflict, the sources (in one-line style) which the channel has and the installed
+     * file does not, and the other way around
+     */
+    QStringList channelOnlyEntries;
+    QStringList installedOnlyEntries;
+
+    bool operator==(const Channel& other) const
+    {
+        return path == other.path
+            && fileName == other.fileName
+            && title == other.title
+            && description == other.description
+            && state == other.state
+            && conflict == other.conflict
+            && installedPath == other.installedPath
+            && signingKey == other.signingKey
+            && channelOnlyEntries == other.channelOnlyEntries
+            && installedOnlyEntries == other.installedOnlyEntries;
+    }
+    bool operator!=(const Channel& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+/**
+ * What we know about a single file in one of the directories we look at. The modification
+ * time, size and inode are used to tell whether the file needs looking at again on a later
+ * scan, and the contents are only ever hashed when we actually need to compare them.
+ */
+struct ScannedFile
+{
+    /**
+     * Modification time, in nanoseconds since the epoch
+     */
+    qint64 modified = 0;
+    qint64 size = -1;
+    quint64 inode = 0;
+    /**
+     * SHA-256 of the file's contents, empty until something needed it
+     */
+    QByteArray hash;
+    /**
+     * SourcesParser::digest() of the sources in the file, empty until something needed it
+     */
+    QByteArray sourcesHash;
+    /**
+     * The first and second comment lines, only filled out for channel files (and taken from
+     * the directory's manifest instead, when it has an entry for the file)
+     */
+    QString title;
+    QString description;
+    /**
+     * The keyring the file's sources are signed with, as given by the directory's manifest
+     */
+    QString signingKey;
+};
+typedef QMap<QString, ScannedFile> ScannedDirectory;
+
+/**
+ * Everything a scan found on disk. This is handed back and forth between the GUI thread and
+ * the worker doing the scanning, so that a rescan only needs to read the files which changed.
+ */
+struct ChannelScanState
+{
+    QString sldDir;
+    QStringList channelDirs;
+    /**
+     * The contents of sources.list.d, by file name
+     */
+    ScannedDirectory installed;
+    /**
+     * The contents of each channel directory, by directory path and then file name
+     */
+    QHash<QString, ScannedDirectory> channelFiles;
+    /**
+     * Which of the channel directories each channel file name is taken from. When more than
+     * one directory has a file by the same name, the one listed first in channelDirs wins.
+     */
+    QHash<QString, QString> resolved;
+    /**
+     * For each channel file name whose installed file means something else, the sources only
+     * the channel has, and those only the installed file has
+     */
+    QHash<QString, QPair<QStringList, QStringList> > conflicts;
+    /**
+     * Whether what was found is kept in (and was started out from) the persistent cache.
+     * Scans of directories other than the usual ones should not end up in there.
+     */
+    bool persistent = true;
+};
+
+/**
+ * Discovery of software channels and their state. All of this touches the disk only,
+ * and none of it touches any widgets, so it is safe to run away from the GUI thread.
+ */
+class ChannelScanner
+{
+public:
+    /**
+     * The directories (in the system-wide data locations: the one we are installed into, then
+     * /usr/local/share and /usr/share) which channels are looked for in, in order of precedence:
+     * first those for this exact release of the distribution (that is, <id>/<versionId>), then
+     * those for the distribution (<id>), then those for each of the distributions it is based on
+     * (ID_LIKE, in the order given there), and finally general-use. At the same level, earlier
+     * data locations come first. The module and the helper always agree on these, whoever runs
+     * them, as the helper only installs channels from these directories.
+     */
+    static QStringList channelDirectories();
+
+    /**
+     * Look at the files in a directory, reusing what is already known about any file whose
+     * modification time, size and inode are unchanged since the previous scan. Channel files
+     * which are new or changed are described using the directory's manifest if it has one
+     * (see ChannelManifest), and otherwise have their first two lines read. Nothing else is read.
+     *
+     * @param path The directory to scan
+     * @param previous What was found in the directory last time it was scanned
+     * @param channelFiles Whether to also pick out titles and descriptions from the files
+     */
+    static ScannedDirectory scanDirectory(const QString& path, const ScannedDirectory& previous, bool channelFiles);
+
+    /**
+     * Scan all channel directories and sources.list.d, starting out from what the
+     * persistent cache knows, so only files which changed since last time are read
+     *
+     * @param sldDir The location of apt's sources.list.d
+     */
+    static ChannelScanState scan(const QString& sldDir);
+
+    /**
+     * Scan the given channel directories and sources.list.d, rather than the usual ones. This is
+     * mostly useful for looking at a tree which is not the live system, such as a chroot, or a
+     * large generated one when measuring how long all this takes.
+     *
+     * @param sldDir The sources.list.d to compare the channels against
+     * @param channelDirs The directories to look for channels in
+     * @param persistent Whether to start out from, and update, the persistent cache
+     */
+    static ChannelScanState scan(const QString& sldDir, const QStringList& channelDirs, bool persistent);
+
+    /**
+     * Scan only the directories listed in changedDirectories again, and keep everything else as is.
+     * Afterwards, the channel file names are resolved to the directory they are taken from, and
+     * resolved channel files and the files in sources.list.d with the same name are compared: by
+     * their contents if they are the same size, and otherwise by what their sources mean, so that
+     * reformatting a file does not turn it into a conflict. Finally, the persistent cache is updated.
+     *
+     * @param state The result of an earlier scan
+     * @param changedDirectories The sources.list.d and/or channel directories which need looking at
+     */
+    static ChannelScanState rescan(ChannelScanState state, const QStringList& changedDirectories);
+
+    /**
+     * Work out the list of channels, and their states, from what a scan found. This does not
+     * touch the disk at all.
+     */
+    static QVector<Channel> channels(const ChannelScanState& state);
+};
+
+#endif//CHANNELSCANNER_H
@@ -0,0 +1,160 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChannelVerifier.h"
+
+#include "ChannelManifest.h"
+#include "FileHash.h"
+#include "Logging.h"
+
+#include <KLocalizedString>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QProcess>
+
+QString ChannelVerifier::keyringDirectory()
+{
+    return QLatin1String("/etc/apt/keyrings");
+}
+
+QStringList ChannelVerifier::trustedKeyrings()
+{
+    // The keys apt trusts for everything, and gpgv only understands the binary ones
+    QStringList keyrings;
+    const QDir trusted(QLatin1String("/etc/apt/trusted.gpg.d"));
+    for(const QString& keyring : trusted.entryList(QStringList() << QLatin1String("*.gpg"), QDir::Files)) {
+        keyrings << trusted.filePath(keyring);
+    }
+    if(QFileInfo(QLatin1String("/etc/apt/trusted.gpg")).isFile()) {
+        keyrings << QLatin1String("/etc/apt/trusted.gpg");
+    }
+    return keyrings;
+}
+
+bool ChannelVerifier::verifySignature(const QStringList& keyrings, const QString& signature, const QString& signedFile, QString* output)
+{
+    if(keyrings.isEmpty()) {
+        *output = QLatin1String("no keyrings to check the signature with");
+        return false;
+    }
+    QStringList arguments;
+    for(const QString& keyring : keyrings) {
+        arguments << QLatin1String("--keyring") << keyring;
+    }
+    arguments << signature;
+    if(!signedFile.isEmpty()) {
+        arguments << signedFile;
+    }
+
+    QProcess gpgv;
+    gpgv.setProcessChannelMode(QProcess::MergedChannels);
+    gpgv.start(QLatin1String("gpgv"), arguments);
+    const bool finished = gpgv.waitForFinished(30000);
+    *output = QString::fromLocal8Bit(gpgv.readAll()).trimmed();
+    return finished && gpgv.exitStatus() == QProcess::NormalExit && gpgv.exitCode() == 0;
+}
+
+bool ChannelVerifier::verifyManifest(const QString& directory, bool* signedManifest)
+{
+    const QString manifest = QString("%1/%2").arg(directory).arg(ChannelManifest::fileName());
+    const QString signature = QString("%1/%2").arg(directory).arg(ChannelManifest::signatureFileName());
+    *signedManifest = false;
+    if(!QFileInfo(signature).isFile()) {
+        return true;
+    }
+    QString output;
+    if(!verifySignature(trustedKeyrings(), signature, manifest, &output)) {
+        qCWarning(KCMREPOTOGGLE_HELPER) << "The signature of" << manifest << "could not be verified:" << output;
+        return false;
+    }
+    *signedManifest = true;
+    return true;
+}
+
+bool ChannelVerifier::verify(const QString& path, const QStringList& channelDirs, VerifiedChannel* result, QString* error)
+{
+    // Resolve links first, so whatever we check is the file which actually gets copied
+    const QFileInfo info(path);
+    const QString canonical = info.canonicalFilePath();
+    if(canonical.isEmpty() || !QFileInfo(canonical).isFile()) {
+        *error = i18nc("Error string used when the file of a software channel to enable does not exist", "%1 does not exist", path);
+        return false;
+    }
+    const QString directory = QFileInfo(canonical).absolutePath();
+    const QString fileName = QFileInfo(canonical).fileName();
+    bool known = false;
+    for(const QString& channelDir : channelDirs) {
+        const QString canonicalDir = QFileInfo(channelDir).canonicalFilePath();
+        if(!canonicalDir.isEmpty() && canonicalDir == directory) {
+            known = true;
+            break;
+        }
+    }
+    // The manifest and its signature live alongside the channels, but are not ones
+    if(!known || fileName == ChannelManifest::fileName() || fileName == ChannelManifest::signatureFileName()) {
+        *error = i18nc("Error string used when asked to enable a file which is not in any of the directories software channels are found in", "%1 is not a software channel, as it is not in any of the channel directories", path);
+        return false;
+    }
+
+    bool signedManifest = false;
+    if(!verifyManifest(directory, &signedManifest)) {
+        *error = i18nc("Error string used when the signature of the manifest of a directory of software channels is not good", "The signature of the manifest in %1 could not be verified", directory);
+        return false;
+    }
+    const QHash<QString, ManifestEntry> manifest = ChannelManifest::load(directory);
+    const ManifestEntry entry = manifest.value(fileName);
+    if(signedManifest && entry.sha256.isEmpty()) {
+        *error = i18nc("Error string used when a software channel is not listed in the signed manifest of its directory", "%1 is not listed in the signed manifest of its directory", path);
+        return false;
+    }
+    if(!entry.sha256.isEmpty()) {
+        if(FileHash::sha256(canonical) != entry.sha256) {
+            *error = i18nc("Error string used when the contents of a software channel do not match what the manifest of its directory says", "The contents of %1 do not match the manifest of its directory", path);
+            return false;
+        }
+    }
+
+    result->path = canonical;
+    result->keyring.clear();
+    result->keyringTarget.clear();
+    const QString signingKey = entry.signingKey.isEmpty() ? ChannelManifest::describe(canonical).signingKey : entry.signingKey;
+    if(signingKey.startsWith(keyringDirectory() + QLatin1Char('/')) && !signingKey.mid(keyringDirectory().length() + 1).contains(QLatin1Char('/'))) {
+        const QString keyring = QString("%1/keyrings/%2").arg(directory).arg(QFileInfo(signingKey).fileName());
+        if(QFileInfo(keyring).isFile()) {
+            // The keyring decides what a whole repository may sign, so it needs vouching for at
+            // least as much as the channel file does
+            const QByteArray expected = ChannelManifest::loadKeyrings(directory).value(QFileInfo(keyring).fileName());
+            if(expected.isEmpty() && signedManifest) {
+                *error = i18nc("Error string used when the keyring shipped with a software channel is not listed in the signed manifest of its directory", "The keyring %1 is not listed in the signed manifest of its directory", keyring);
+                return false;
+            }
+            if(!expected.isEmpty()) {
+                if(FileHash::sha256(keyring) != expected) {
+                    *error = i18nc("Error string used when the contents of the keyring shipped with a software channel do not match what the manifest of its directory says", "The contents of the keyring %1 do not match the manifest of its directory", keyring);
+                    return false;
+                }
+            }
+            result->keyring = keyring;
+            result->keyringTarget = signingKey;
+        }
+    }
+    return true;
+}
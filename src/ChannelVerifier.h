@@ -0,0 +1,111 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHANNELVERIFIER_H
+#define CHANNELVERIFIER_H
+
+#include <QString>
+#include <QStringList>
+
+/**
+ * What the helper needs to know to install a channel, once it has been checked
+ */
+struct VerifiedChannel
+{
+    /**
+     * The channel file, with all symbolic links resolved, which is what should actually be copied
+     */
+    QString path;
+    /**
+     * The keyring shipped alongside the channel, which its sources are signed with, or empty if
+     * the channel does not come with one
+     */
+    QString keyring;
+    /**
+     * Where the keyring needs to go for the sources to find it (that is, their signed-by option)
+     */
+    QString keyringTarget;
+};
+
+/**
+ * Checking that a file the helper is asked to install really is a channel, before it goes
+ * anywhere near sources.list.d. A channel file must:
+ *
+ * - live directly inside one of the channel directories (see ChannelScanner::channelDirectories())
+ * - match the SHA-256 in its directory's manifest, if the manifest lists it
+ * - be listed in the manifest at all, if the manifest is signed
+ *
+ * A manifest is signed by a detached signature next to it (ChannelManifest::signatureFileName()), made with one of the
+ * keys apt already trusts (the keyrings in /etc/apt/trusted.gpg.d), and checked using gpgv. This
+ * way, a distribution can sign its channel directories using its archive key, and the manifest
+ * vouches for every file in them.
+ *
+ * Channels whose sources are signed by a keyring in /etc/apt/keyrings can ship that keyring in a
+ * keyrings directory inside their channel directory (so, <dir>/keyrings/example.gpg for sources
+ * with signed-by=/etc/apt/keyrings/example.gpg), and it is installed along with the channel. The
+ * same rules apply to the keyring as to the channel file: it must match the SHA-256 the manifest
+ * lists for it, and be listed at all if the manifest is signed.
+ */
+class ChannelVerifier
+{
+public:
+    /**
+     * The directory keyrings shipped with channels are installed into
+     */
+    static QString keyringDirectory();
+
+    /**
+     * Check a channel file before installing it
+     *
+     * @param path The channel file, as passed to the helper
+     * @param channelDirs The directories channel files may come from
+     * @param result Filled out with what is needed to install the channel
+     * @param error Set to why the file cannot be installed, if it cannot
+     * @return Whether the file may be installed
+     */
+    static bool verify(const QString& path, const QStringList& channelDirs, VerifiedChannel* result, QString* error);
+
+    /**
+     * The keyrings apt trusts for every source which does not name its own (with signed-by)
+     */
+    static QStringList trustedKeyrings();
+
+    /**
+     * Check a signature using gpgv
+     *
+     * @param keyrings The keyrings holding the keys the signature may be made with
+     * @param signature The detached signature, or the clear signed file
+     * @param signedFile The file a detached signature is for, or empty for a clear signed file
+     * @param output Set to what gpgv had to say
+     * @return Whether the signature is good
+     */
+    static bool verifySignature(const QStringList& keyrings, const QString& signature, const QString& signedFile, QString* output);
+
+    /**
+     * Check the detached signature of a channel directory's manifest, if it has one
+     *
+     * @param directory The channel directory
+     * @param signedManifest Set to whether the manifest is signed (and the signature good)
+     * @return False if there is a signature, and it is not a good one
+     */
+    static bool verifyManifest(const QString& directory, bool* signedManifest);
+};
+
+#endif//CHANNELVERIFIER_H
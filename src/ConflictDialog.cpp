@@ -0,0 +1,112 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ConflictDialog.h"
+
+#include <KLocalizedString>
+
+#include <QAbstractListModel>
+#include <QColor>
+#include <QDialogButtonBox>
+#include <QFontDatabase>
+#include <QLabel>
+#include <QListView>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+// The lines of the diff, for showing in a list view. A view only ever asks for the lines it is
+// actually showing, so this stays quick however long the files are, which a text edit would not.
+class DiffModel : public QAbstractListModel
+{
+public:
+    DiffModel(const QVector<DiffLine>& lines, QObject* parent)
+        : QAbstractListModel(parent)
+        , lines(lines)
+    {}
+
+    virtual int rowCount(const QModelIndex& parent = QModelIndex()) const
+    {
+        return parent.isValid() ? 0 : lines.count();
+    }
+
+    virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const
+    {
+        if(!index.isValid() || index.row() >= lines.count()) {
+            return QVariant();
+        }
+        const DiffLine& line = lines.at(index.row());
+        switch(role) {
+        case Qt::DisplayRole:
+            switch(line.kind) {
+            case DiffLine::Added:
+                return QString("+ %1").arg(line.text);
+            case DiffLine::Removed:
+                return QString("- %1").arg(line.text);
+            case DiffLine::Unchanged:
+            default:
+                return QString("  %1").arg(line.text);
+            }
+        case Qt::ForegroundRole:
+            switch(line.kind) {
+            case DiffLine::Added:
+                return QColor(Qt::darkGreen);
+            case DiffLine::Removed:
+                return QColor(Qt::darkRed);
+            case DiffLine::Unchanged:
+            default:
+                break;
+            }
+            break;
+        default:
+            break;
+        }
+        return QVariant();
+    }
+
+    QVector<DiffLine> lines;
+};
+
+ConflictDialog::ConflictDialog(const QString& channelPath, const QString& installedPath, const QVector<DiffLine>& lines, QWidget* parent)
+    : QDialog(parent)
+{
+    setWindowTitle(i18nc("Title of the dialog showing the differences between a channel and the file with the same name in sources.list.d", "Software Channel Conflict"));
+    QVBoxLayout* layout = new QVBoxLayout(this);
+
+    QLabel* label = new QLabel(this);
+    label->setWordWrap(true);
+    label->setText(i18nc("Explanation above the differences between a channel and the file with the same name in sources.list.d, with the installed file and the channel's file", "These are the differences between the installed file %1 and the software channel %2. Lines starting with - are only in the installed file, and lines starting with + only in the channel.", installedPath, channelPath));
+    layout->addWidget(label);
+
+    QListView* view = new QListView(this);
+    view->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    view->setUniformItemSizes(true);
+    view->setSelectionMode(QAbstractItemView::NoSelection);
+    view->setModel(new DiffModel(lines, view));
+    layout->addWidget(view);
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    QPushButton* replaceButton = buttons->addButton(i18nc("Button in the dialog showing a conflict, which replaces the installed file with the channel's file", "Replace Installed File"), QDialogButtonBox::ActionRole);
+    replaceButton->setToolTip(i18nc("Tool tip for the button in the dialog showing a conflict", "Replace %1 with the software channel's file, which enables the channel", installedPath));
+    connect(replaceButton, &QPushButton::clicked, this, [this](){ done(ReplaceResult); });
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    layout->addWidget(buttons);
+
+    resize(800, 600);
+}
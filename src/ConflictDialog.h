@@ -0,0 +1,52 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONFLICTDIALOG_H
+#define CONFLICTDIALOG_H
+
+#include "LineDiff.h"
+
+#include <QDialog>
+
+/**
+ * Shows how a channel's file differs from the file by the same name which is already in
+ * sources.list.d, and lets the user replace the installed file with the channel's.
+ */
+class ConflictDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    enum Result {
+        /**
+         * Returned by exec() when the user asked for the installed file to be replaced
+         */
+        ReplaceResult = QDialog::Accepted + 1
+    };
+
+    /**
+     * @param channelPath The channel's file
+     * @param installedPath The file by the same name in sources.list.d
+     * @param lines The differences, going from the installed file to the channel's
+     * @param parent The widget to show the dialog on top of
+     */
+    ConflictDialog(const QString& channelPath, const QString& installedPath, const QVector<DiffLine>& lines, QWidget* parent = 0);
+};
+
+#endif//CONFLICTDIALOG_H
@@ -0,0 +1,68 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HelperAction.h"
+
+QString HelperAction::actionName()
+{
+    return QLatin1String("org.kde.kcontrol.kcmrepotoggle.save");
+}
+
+QString HelperAction::helperId()
+{
+    return QLatin1String("org.kde.kcontrol.kcmrepotoggle");
+}
+
+void HelperAction::prepare(KAuth::Action& action, const QVariantMap& changes, bool refreshCache, bool fullRefresh, bool validate)
+{
+    QVariantMap helperargs = changes;
+    helperargs["/refreshCache"] = refreshCache ? Qt::Checked : Qt::Unchecked;
+    if(fullRefresh) {
+        helperargs["/fullRefresh"] = Qt::Checked;
+    }
+    if(validate) {
+        helperargs["/validate"] = Qt::Checked;
+    }
+    action.setHelperId(helperId());
+    action.setArguments(helperargs);
+    // Without a refresh, this is a handful of file operations. With one, it can take a good long
+    // while on a slow connection, but can also be cancelled, so this is just the last resort.
+    if(refreshCache) {
+        action.setTimeout(1000 * 60 * 20);
+    }
+    else {
+        action.setTimeout(1000 * 60 * 2);
+    }
+}
+
+void HelperAction::setProfile(KAuth::Action& action, const QString& profile)
+{
+    QVariantMap helperargs = action.arguments();
+    helperargs["/profile"] = profile;
+    action.setArguments(helperargs);
+}
+
+void HelperAction::prepareRevert(KAuth::Action& action, const QString& snapshot, bool refreshCache)
+{
+    QVariantMap helperargs;
+    helperargs["/revert"] = snapshot;
+    helperargs["/reuseLists"] = Qt::Checked;
+    prepare(action, helperargs, refreshCache);
+}
@@ -0,0 +1,85 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HELPERACTION_H
+#define HELPERACTION_H
+
+#include <KAuth/KAuthAction>
+
+#include <QVariantMap>
+
+/**
+ * Setting up calls to the privileged helper, shared between the module and the
+ * command line tool so that both talk to it in exactly the same way.
+ */
+class HelperAction
+{
+public:
+    /**
+     * Passed as the value for a channel instead of a Qt::CheckState, to have the helper replace
+     * the file with the same name in sources.list.d with the channel's own
+     */
+    static const int ReplaceInstalled = 3;
+
+    /**
+     * The name of the action the helper implements
+     */
+    static QString actionName();
+    /**
+     * The id of the helper itself
+     */
+    static QString helperId();
+
+    /**
+     * Fill out an action with the arguments for applying a set of changes
+     *
+     * @param action The action to fill out. This is usually either the module's authAction(), or
+     *               a new action created using actionName().
+     * @param changes The channel paths to change, with the wanted Qt::CheckState (or ReplaceInstalled) as value
+     * @param refreshCache Whether to refresh the indexes of the changed channels afterwards
+     * @param fullRefresh Whether to refresh the indexes of all sources, rather than just the changed ones
+     * @param validate Whether to check the repositories of the channels to enable (see ReleaseValidator) before
+     *                 changing anything. This needs the network, and can take a while, so is only done when asked.
+     */
+    static void prepare(KAuth::Action& action, const QVariantMap& changes, bool refreshCache, bool fullRefresh = false, bool validate = false);
+
+    /**
+     * Mark the changes in an action filled out by prepare() as switching to a channel profile (see
+     * ChannelProfiles), so the helper can log them, and note it with the snapshot it takes, as one
+     * operation, rather than as a number of unrelated channels
+     *
+     * @param action The action to mark
+     * @param profile The name of the profile
+     */
+    static void setProfile(KAuth::Action& action, const QString& profile);
+
+    /**
+     * Fill out an action with the arguments for putting sources.list.d back the way it was when
+     * a snapshot was taken (see SourcesSnapshot). Package lists kept with the snapshot are put
+     * back as well, so usually nothing needs downloading again.
+     *
+     * @param action The action to fill out
+     * @param snapshot The id of the snapshot to go back to, or an empty string for the newest one
+     * @param refreshCache Whether to refresh the indexes of the channels which come back afterwards
+     */
+    static void prepareRevert(KAuth::Action& action, const QString& snapshot, bool refreshCache);
+};
+
+#endif//HELPERACTION_H
@@ -0,0 +1,232 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LineDiff.h"
+
+#include <QFile>
+#include <QHash>
+
+// The state of one comparison, kept together so the recursion only needs to pass ranges
+struct DiffContext
+{
+    // Each line as a number, with equal lines getting the same number
+    QVector<int> a;
+    QVector<int> b;
+    // Whether each line of a is removed, and each line of b added
+    QVector<bool> removed;
+    QVector<bool> added;
+    // The furthest reaching paths going forwards and backwards, by diagonal
+    QVector<int> forward;
+    QVector<int> backward;
+};
+
+// How many changes to look for in one go before giving up on finding the shortest path. This is what
+// keeps two very large and very different files from taking quadratic time to compare.
+static const int costLimit = 1024;
+
+// Find a point on an optimal path from (aBegin, bBegin) to (aEnd, bEnd), which splits the problem
+// in two halves of about the same number of changes (the "middle snake" from Myers' paper).
+// Both ranges are known to be non-empty here, and to start and end with a differing line.
+static void middleSnake(DiffContext& context, int aBegin, int aEnd, int bBegin, int bEnd, int& aMiddle, int& bMiddle)
+{
+    const int* a = context.a.constData() + aBegin;
+    const int* b = context.b.constData() + bBegin;
+    const int n = aEnd - aBegin;
+    const int m = bEnd - bBegin;
+    const int delta = n - m;
+    const bool odd = delta & 1;
+    const int maxD = (n + m + 1) / 2;
+    // Diagonals run from -(maxD + 1) to maxD + 1
+    const int offset = maxD + 1;
+    int* forward = context.forward.data() + offset;
+    int* backward = context.backward.data() + offset;
+    forward[1] = 0;
+    backward[1] = 0;
+
+    for(int d = 0; d <= maxD; ++d) {
+        if(d > costLimit) {
+            // Finding the very shortest list of changes is taking too long, so settle for splitting
+            // at whichever point got furthest so far. The result is still correct, just possibly not
+            // as short as it could have been.
+            int best = -1;
+            aMiddle = aBegin + n / 2;
+            bMiddle = bBegin + m / 2;
+            for(int k = -(d - 1); k <= d - 1; k += 2) {
+                const int x = qMin(forward[k], n);
+                const int y = x - k;
+                if(y >= 0 && y <= m && x + y > best && x + y < n + m) {
+                    best = x + y;
+                    aMiddle = aBegin + x;
+                    bMiddle = bBegin + y;
+                }
+            }
+            for(int c = -(d - 1); c <= d - 1; c += 2) {
+                const int x = qMin(backward[c], n);
+                const int y = x - c;
+                if(y >= 0 && y <= m && x + y > best && x + y < n + m) {
+                    best = x + y;
+                    aMiddle = aBegin + n - x;
+                    bMiddle = bBegin + m - y;
+                }
+            }
+            return;
+        }
+        // Forward, where diagonal k is x - y
+        for(int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && forward[k - 1] < forward[k + 1])) ? forward[k + 1] : forward[k - 1] + 1;
+            int y = x - k;
+            while(x < n && y < m && a[x] == b[y]) {
+                ++x;
+                ++y;
+            }
+            forward[k] = x;
+            // The backward diagonal matching this one, which has taken d - 1 steps so far
+            const int c = delta - k;
+            if(odd && c >= -(d - 1) && c <= d - 1 && forward[k] + backward[c] >= n) {
+                aMiddle = aBegin + x;
+                bMiddle = bBegin + y;
+                return;
+            }
+        }
+        // Backward, going from the end, where diagonal c is the same as k, counted from the end
+        for(int c = -d; c <= d; c += 2) {
+            int x = (c == -d || (c != d && backward[c - 1] < backward[c + 1])) ? backward[c + 1] : backward[c - 1] + 1;
+            int y = x - c;
+            while(x < n && y < m && a[n - x - 1] == b[m - y - 1]) {
+                ++x;
+                ++y;
+            }
+            backward[c] = x;
+            const int k = delta - c;
+            if(!odd && k >= -d && k <= d && forward[k] + backward[c] >= n) {
+                aMiddle = aBegin + n - x;
+                bMiddle = bBegin + m - y;
+                return;
+            }
+        }
+    }
+    // There is always a path, so this is never reached, but split somewhere sensible regardless
+    aMiddle = aBegin + n / 2;
+    bMiddle = bBegin + m / 2;
+}
+
+static void compare(DiffContext& context, int aBegin, int aEnd, int bBegin, int bEnd)
+{
+    // Whatever the two ranges start and end with in common needs no further thought
+    while(aBegin < aEnd && bBegin < bEnd && context.a.at(aBegin) == context.b.at(bBegin)) {
+        ++aBegin;
+        ++bBegin;
+    }
+    while(aEnd > aBegin && bEnd > bBegin && context.a.at(aEnd - 1) == context.b.at(bEnd - 1)) {
+        --aEnd;
+        --bEnd;
+    }
+
+    if(aBegin == aEnd) {
+        for(int i = bBegin; i < bEnd; ++i) {
+            context.added[i] = true;
+        }
+    }
+    else if(bBegin == bEnd) {
+        for(int i = aBegin; i < aEnd; ++i) {
+            context.removed[i] = true;
+        }
+    }
+    else {
+        int aMiddle = 0;
+        int bMiddle = 0;
+        middleSnake(context, aBegin, aEnd, bBegin, bEnd, aMiddle, bMiddle);
+        compare(context, aBegin, aMiddle, bBegin, bMiddle);
+        compare(context, aMiddle, aEnd, bMiddle, bEnd);
+    }
+}
+
+static int lineNumber(QHash<QString, int>& numbers, const QString& line)
+{
+    QHash<QString, int>::const_iterator known = numbers.constFind(line);
+    if(known == numbers.constEnd()) {
+        known = numbers.insert(line, numbers.count());
+    }
+    return known.value();
+}
+
+QVector<DiffLine> LineDiff::diff(const QStringList& from, const QStringList& to)
+{
+    DiffContext context;
+    QHash<QString, int> numbers;
+    numbers.reserve(from.count() + to.count());
+    context.a.reserve(from.count());
+    for(const QString& line : from) {
+        context.a << lineNumber(numbers, line);
+    }
+    context.b.reserve(to.count());
+    for(const QString& line : to) {
+        context.b << lineNumber(numbers, line);
+    }
+    context.removed.fill(false, from.count());
+    context.added.fill(false, to.count());
+    const int size = (from.count() + to.count() + 1) / 2 * 2 + 4;
+    context.forward.resize(size);
+    context.backward.resize(size);
+
+    compare(context, 0, from.count(), 0, to.count());
+
+    QVector<DiffLine> lines;
+    lines.reserve(qMax(from.count(), to.count()));
+    int i = 0;
+    int j = 0;
+    while(i < from.count() || j < to.count()) {
+        DiffLine line;
+        if(i < from.count() && context.removed.at(i)) {
+            line.kind = DiffLine::Removed;
+            line.text = from.at(i++);
+        }
+        else if(j < to.count() && context.added.at(j)) {
+            line.kind = DiffLine::Added;
+            line.text = to.at(j++);
+        }
+        else {
+            line.kind = DiffLine::Unchanged;
+            line.text = from.at(i++);
+            ++j;
+        }
+        lines << line;
+    }
+    return lines;
+}
+
+static QStringList readLines(const QString& path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        return QStringList();
+    }
+    QStringList lines = QString::fromUtf8(file.readAll()).split(QLatin1Char('\n'));
+    // A final newline does not start another line
+    if(!lines.isEmpty() && lines.last().isEmpty()) {
+        lines.removeLast();
+    }
+    return lines;
+}
+
+QVector<DiffLine> LineDiff::diffFiles(const QString& from, const QString& to)
+{
+    return diff(readLines(from), readLines(to));
+}
@@ -0,0 +1,73 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LINEDIFF_H
+#define LINEDIFF_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * One line of the difference between two texts
+ */
+struct DiffLine
+{
+    enum Kind {
+        Unchanged,
+        /**
+         * Only in the second text
+         */
+        Added,
+        /**
+         * Only in the first text
+         */
+        Removed
+    };
+    Kind kind;
+    QString text;
+};
+
+/**
+ * Line by line comparison of two texts, using Myers' algorithm in its linear space form, so
+ * memory use only grows with the length of the texts, not with how different they are.
+ * Lines are compared by number rather than by content once they have been read, and any
+ * shared beginning and end is skipped straight away, so the usual case of two files which
+ * differ in a handful of places costs little more than reading them. For texts which are very
+ * different, the search for the shortest list of changes is cut short, so the time taken stays
+ * close to linear, at the cost of the result perhaps being a little longer than needed.
+ */
+class LineDiff
+{
+public:
+    /**
+     * The shortest list of changes turning one list of lines into the other, with the lines
+     * they have in common in between
+     */
+    static QVector<DiffLine> diff(const QStringList& from, const QStringList& to);
+
+    /**
+     * The differences between the contents of two files. A file which cannot be read is
+     * treated as being empty.
+     */
+    static QVector<DiffLine> diffFiles(const QString& from, const QString& to);
+};
+
+#endif//LINEDIFF_H
@@ -0,0 +1,27 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Logging.h"
+
+// Only warnings are shown by default. Use QT_LOGGING_RULES="org.kde.kcmrepotoggle.*.debug=true"
+// to see everything, including how long each step took.
+Q_LOGGING_CATEGORY(KCMREPOTOGGLE_MODULE, "org.kde.kcmrepotoggle.module", QtWarningMsg)
+Q_LOGGING_CATEGORY(KCMREPOTOGGLE_HELPER, "org.kde.kcmrepotoggle.helper", QtWarningMsg)
+Q_LOGGING_CATEGORY(KCMREPOTOGGLE_OSRELEASE, "org.kde.kcmrepotoggle.osrelease", QtWarningMsg)
@@ -0,0 +1,245 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MirrorProbe.h"
+
+#include "Logging.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSet>
+#include <QTimer>
+
+class MirrorProbe::Private {
+public:
+    Private(MirrorProbe* qq)
+        : q(qq)
+        , network(new QNetworkAccessManager(qq))
+        , maximumConcurrent(4)
+        , timeout(5000)
+        , running(0)
+    {
+        const QByteArray base = qgetenv("KCMREPOTOGGLE_PROBE_BASE");
+        if(!base.isEmpty()) {
+            urlBase = QUrl(QString::fromUtf8(base));
+        }
+    }
+    MirrorProbe* q;
+    QNetworkAccessManager* network;
+    QUrl urlBase;
+    int maximumConcurrent;
+    int timeout;
+
+    // One repository, and everybody waiting to hear about it
+    struct Target {
+        QUrl inRelease;
+        QUrl release;
+        QStringList ids;
+        bool done = false;
+        bool reachable = false;
+        int latency = -1;
+    };
+    QHash<QString, Target> targets;
+    QStringList queue;
+    int running;
+    QSet<QNetworkReply*> replies;
+
+    // What we know so far about each channel
+    struct Channel {
+        int pending = 0;
+        bool reachable = true;
+        int latency = -1;
+    };
+    QHash<QString, Channel> channels;
+
+    QUrl rebased(QUrl url) const
+    {
+        if(urlBase.isValid() && !urlBase.isEmpty()) {
+            QString path = urlBase.path();
+            if(path.endsWith(QLatin1Char('/'))) {
+                path.chop(1);
+            }
+            url.setPath(path + url.path());
+            url.setScheme(urlBase.scheme());
+            url.setHost(urlBase.host());
+            url.setPort(urlBase.port());
+        }
+        return url;
+    }
+
+    void startNext();
+    void request(const QString& key, const QUrl& url, bool fallback);
+    void targetDone(const QString& key, bool reachable, int latency);
+};
+
+void MirrorProbe::Private::startNext()
+{
+    while(running < maximumConcurrent && !queue.isEmpty()) {
+        const QString key = queue.takeFirst();
+        ++running;
+        request(key, targets.value(key).inRelease, true);
+    }
+    if(running == 0 && queue.isEmpty()) {
+        Q_EMIT q->finished();
+    }
+}
+
+void MirrorProbe::Private::request(const QString& key, const QUrl& url, bool fallback)
+{
+    QNetworkRequest networkRequest(rebased(url));
+    networkRequest.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    QNetworkReply* reply = network->head(networkRequest);
+    replies << reply;
+    QElapsedTimer timer;
+    timer.start();
+    QTimer::singleShot(timeout, reply, [reply](){ reply->abort(); });
+    q->connect(reply, &QNetworkReply::finished, q, [this, reply, key, fallback, timer](){
+        reply->deleteLater();
+        if(!replies.remove(reply)) {
+            // Cancelled, so nobody wants to know any more
+            return;
+        }
+        const int latency = int(timer.elapsed());
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        // Any answer at all from the server means it's there, but only one which says the file
+        // exists means the repository is. Older repositories may not have an InRelease file yet.
+        if(status == 404 && fallback) {
+            request(key, targets.value(key).release, false);
+            return;
+        }
+        const bool reachable = reply->error() == QNetworkReply::NoError && status >= 200 && status < 400;
+        if(!reachable) {
+            qCDebug(KCMREPOTOGGLE_MODULE) << "Could not reach" << reply->url() << reply->errorString();
+        }
+        --running;
+        targetDone(key, reachable, latency);
+        startNext();
+    });
+}
+
+void MirrorProbe::Private::targetDone(const QString& key, bool reachable, int latency)
+{
+    Target& target = targets[key];
+    target.done = true;
+    target.reachable = reachable;
+    target.latency = latency;
+    for(const QString& id : target.ids) {
+        QHash<QString, Channel>::iterator channel = channels.find(id);
+        if(channel == channels.end()) {
+            continue;
+        }
+        channel.value().reachable = channel.value().reachable && reachable;
+        channel.value().latency = qMax(channel.value().latency, latency);
+        if(--channel.value().pending == 0) {
+            const Channel result = channel.value();
+            channels.erase(channel);
+            Q_EMIT q->probed(id, result.reachable, result.latency);
+        }
+    }
+    target.ids.clear();
+}
+
+MirrorProbe::MirrorProbe(QObject* parent)
+    : QObject(parent)
+    , d(new Private(this))
+{
+}
+
+MirrorProbe::~MirrorProbe()
+{
+    cancel();
+    delete d;
+}
+
+void MirrorProbe::setMaximumConcurrent(int maximum)
+{
+    d->maximumConcurrent = qMax(1, maximum);
+}
+
+void MirrorProbe::setTimeout(int timeout)
+{
+    d->timeout = timeout;
+}
+
+void MirrorProbe::setUrlBase(const QUrl& base)
+{
+    d->urlBase = base;
+}
+
+void MirrorProbe::probe(const QString& id, const QVector<SourceEntry>& entries)
+{
+    QSet<QString> keys;
+    for(const SourceEntry& entry : entries) {
+        // The same file serves deb and deb-src alike
+        QUrl uri(entry.uri);
+        if(uri.scheme() != QLatin1String("http") && uri.scheme() != QLatin1String("https")) {
+            continue;
+        }
+        const QString directory = entry.suite.endsWith(QLatin1Char('/')) ? entry.uri + entry.suite : QString("%1dists/%2/").arg(entry.uri).arg(entry.suite);
+        keys << directory;
+    }
+
+    Private::Channel channel;
+    for(const QString& key : keys) {
+        QHash<QString, Private::Target>::iterator target = d->targets.find(key);
+        if(target != d->targets.end() && target.value().done) {
+            // Somebody else already asked, so there's no need to go and ask again
+            channel.reachable = channel.reachable && target.value().reachable;
+            channel.latency = qMax(channel.latency, target.value().latency);
+            continue;
+        }
+        if(target == d->targets.end()) {
+            target = d->targets.insert(key, Private::Target());
+            target.value().inRelease = QUrl(key + QLatin1String("InRelease"));
+            target.value().release = QUrl(key + QLatin1String("Release"));
+            d->queue << key;
+        }
+        target.value().ids << id;
+        ++channel.pending;
+    }
+
+    if(channel.pending == 0) {
+        Q_EMIT probed(id, channel.reachable, channel.latency);
+        return;
+    }
+    d->channels.insert(id, channel);
+    d->startNext();
+}
+
+void MirrorProbe::cancel()
+{
+    d->targets.clear();
+    d->channels.clear();
+    d->queue.clear();
+    d->running = 0;
+    const QSet<QNetworkReply*> replies = d->replies;
+    d->replies.clear();
+    for(QNetworkReply* reply : replies) {
+        reply->abort();
+    }
+}
+
+bool MirrorProbe::isRunning() const
+{
+    return d->running > 0 || !d->queue.isEmpty();
+}
@@ -0,0 +1,103 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MIRRORPROBE_H
+#define MIRRORPROBE_H
+
+#include "SourcesParser.h"
+
+#include <QObject>
+#include <QUrl>
+#include <QVector>
+
+/**
+ * Checks whether the repositories a channel points at can be reached, and how quickly they
+ * answer, without downloading anything. For each repository, this asks for the headers of its
+ * InRelease file (or its Release file, if there is no InRelease), a handful at a time, and all
+ * of it asynchronously.
+ *
+ * Channels sharing a repository only cause it to be asked once. Sources which are not on http or
+ * https (such as cdrom: or file:) are not probed, and do not count against a channel.
+ */
+class MirrorProbe : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MirrorProbe(QObject* parent = 0);
+    virtual ~MirrorProbe();
+
+    /**
+     * How many requests may be running at the same time. The default is 4.
+     */
+    void setMaximumConcurrent(int maximum);
+
+    /**
+     * How long to wait for a repository to answer, in milliseconds, before considering it
+     * unreachable. The default is 5 seconds.
+     */
+    void setTimeout(int timeout);
+
+    /**
+     * Send all requests to this scheme, host and port instead of the ones in the sources, with
+     * the path of each source appended to the path given here. This is useful for testing against
+     * a local server. It can also be set using the KCMREPOTOGGLE_PROBE_BASE environment variable.
+     */
+    void setUrlBase(const QUrl& base);
+
+    /**
+     * Probe the repositories of a channel. The result is reported through probed() once
+     * all of them have answered (or failed to). Nothing is read from disk here, so the
+     * sources need to have been read already, preferably away from the GUI thread.
+     *
+     * @param id What to report the result as (usually the channel's path)
+     * @param entries The sources in the channel's file
+     */
+    void probe(const QString& id, const QVector<SourceEntry>& entries);
+
+    /**
+     * Stop all running and queued requests, without reporting anything for them
+     */
+    void cancel();
+
+    /**
+     * Whether there is anything still waiting to be answered
+     */
+    bool isRunning() const;
+
+    /**
+     * Emitted when all the repositories of a channel have been probed
+     *
+     * @param id The id the channel was passed to probe() with
+     * @param reachable Whether every one of the channel's repositories answered
+     * @param latency How long the slowest of them took to answer, in milliseconds, or -1 if
+     *                there was nothing to probe
+     */
+    Q_SIGNAL void probed(const QString& id, bool reachable, int latency);
+
+    /**
+     * Emitted when the last queued request has been answered
+     */
+    Q_SIGNAL void finished();
+private:
+    class Private;
+    Private* d;
+};
+
+#endif//MIRRORPROBE_H
@@ -23,42 +23,138 @@
 
 #include "ui_Module.h"
 #include "Version.h"
-#include "OSRelease.h"
-
-#include <QApt/Backend>
-#include <QApt/Config>
+#include "AptConfig.h"
+#include "ChannelModel.h"
+#include "ConflictDialog.h"
+#include "HelperAction.h"
+#include "ChangePlan.h"
+#include "ChannelDelegate.h"
+#include "ChannelFilterModel.h"
+#include "ChannelProfile.h"
+#include "LineDiff.h"
+#include "Logging.h"
+#include "MirrorProbe.h"
+#include "SourcesSnapshot.h"
+#include "Tracing.h"
 
 #include <KAboutData>
+#include <KFormat>
 #include <KMessageBox>
+#include <KStandardGuiItem>
+#include <KAuth/KAuthActionReply>
 #include <KAuth/KAuthExecuteJob>
 
-#include <QDebug>
-#include <QCheckBox>
-#include <QDir>
-#include <QFile>
-#include <QStandardPaths>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QInputDialog>
+#include <QLocale>
+#include <QPointer>
+#include <QTimer>
 #include <QVariantMap>
-#include <QPushButton>
-#include <QProgressBar>
+#include <QtConcurrentRun>
+#include <QFutureWatcher>
 
 class Module::Private {
 public:
     Private(Module* qq)
         : q(qq)
-        , backend(new QApt::Backend)
-        , progress(0)
+        , model(new ChannelModel(qq))
+        , filterModel(new ChannelFilterModel(qq))
+        , probe(new MirrorProbe(qq))
+        , saving(false)
+        , fullScanRequested(false)
+        , fsWatcher(new QFileSystemWatcher(qq))
+        , rescanTimer(new QTimer(qq))
     {
-        backend->init();
+        filterModel->setSourceModel(model);
+        startupStart = Tracing::now();
+        startupTimer.start();
+        q->connect(&scanWatcher, &QFutureWatcherBase::finished, q, [this](){ scanCompleted(); });
+        q->connect(&diffWatcher, &QFutureWatcherBase::finished, q, [this](){ differencesReady(); });
+        q->connect(probe, &MirrorProbe::probed, q, [this](const QString& path, bool reachable, int latency){
+            model->setProbeState(path, reachable ? ChannelModel::Reachable : ChannelModel::Unreachable, latency);
+        });
+        q->connect(probe, &MirrorProbe::finished, q, [this](){ q->ui->probeButton->setEnabled(true); });
+        q->connect(&probeWatcher, &QFutureWatcherBase::finished, q, [this](){
+            // The channel files have been read, so now the actual probing can start
+            const QHash<QString, QVector<SourceEntry> > entries = probeWatcher.result();
+            for(QHash<QString, QVector<SourceEntry> >::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+                probe->probe(it.key(), it.value());
+            }
+            if(!probe->isRunning()) {
+                q->ui->probeButton->setEnabled(true);
+            }
+        });
+        q->connect(model, &ChannelModel::dirtyChanged, q, [this](bool dirty){ q->changed(dirty); });
+        // Things like package installs tend to drop several files in quick succession, so
+        // wait for things to settle a little before going to look at them
+        rescanTimer->setSingleShot(true);
+        rescanTimer->setInterval(250);
+        q->connect(rescanTimer, &QTimer::timeout, q, [this](){ rescanChanged(); });
+        q->connect(fsWatcher, &QFileSystemWatcher::directoryChanged, q, [this](const QString& path){ directoryChanged(path); });
     }
     Module* q;
-    QApt::Backend *backend;
+    ChannelModel* model;
+    ChannelFilterModel* filterModel;
+    MirrorProbe* probe;
+    void probeMirrors();
+    QFutureWatcher<QHash<QString, QVector<SourceEntry> > > probeWatcher;
+
+    QVector<ChannelProfile> profiles;
+    // The profile last switched to, and the changes that came down to, so it can be passed on to
+    // the helper if that is still all there is to apply
+    QString selectedProfile;
+    QVariantMap selectedProfileChanges;
+    void loadProfiles(const QString& selected = QString());
+    void selectProfile(int index);
+    void saveProfile();
+
     void populateSources();
-    void checkCheckStates();
+    void scanCompleted();
+    void directoryChanged(const QString& path);
+    void rescanChanged();
+    void updateWatchedDirectories();
+    void showProgress(const QString& message, bool cancellable);
+    void hideProgress();
+
+    void updateDiffButton();
+    void showDifferences(const QModelIndex& index);
+    void differencesReady();
+    QFutureWatcher<QVector<DiffLine> > diffWatcher;
+    QString diffChannelPath;
+    QString diffInstalledPath;
+
+    void applyChanges(const QVariantMap& changes, bool confirm);
+    void updateRevertButton();
+    void revert();
+    void runHelper(KAuth::Action action);
 
     void saveCompleted(KJob* job);
-    void saveJobStatusChanged(KAuth::ExecuteJob* saveJob, KAuth::Action::AuthStatus status);
+    void saveJobStatusChanged(KAuth::Action::AuthStatus status);
     void saveJobNewData(const QVariantMap& data);
-    QProgressBar* progress;
+    bool saving;
+    QPointer<KAuth::ExecuteJob> saveJob;
+    // The accumulated progress reported by the helper, and one line for each repository it told us about
+    QVariantMap progressRecord;
+    QHash<QString, QString> repositoryProgress;
+    QStringList repositoryOrder;
+    // From starting the helper until it is done, and whether it's been authorised yet
+    qint64 applyStart = 0;
+    QElapsedTimer applyTimer;
+    bool authRecorded = false;
+
+    QFutureWatcher<ChannelScanState> scanWatcher;
+    ChannelScanState scanState;
+    bool fullScanRequested;
+
+    QFileSystemWatcher* fsWatcher;
+    QTimer* rescanTimer;
+    QStringList pendingDirectories;
+
+    // From construction until the channels are first shown
+    qint64 startupStart;
+    QElapsedTimer startupTimer;
 };
 
 Module::Module(QWidget *parent, const QVariantList &args)
@@ -85,6 +181,33 @@ Module::Module(QWidget *parent, const QVariantList &args)
     ui->setupUi(this);
     setNeedsAuthorization(true);
 
+    // The list only ever creates anything for the rows on screen, so this stays quick however many channels there are
+    ui->channelList->setItemDelegate(new ChannelDelegate(ui->channelList));
+    ui->channelList->setModel(d->filterModel);
+    ui->filterCombo->addItem(i18nc("Entry in the drop down which picks which kind of channels to show", "All channels"), ChannelFilterModel::AllChannels);
+    ui->filterCombo->addItem(i18nc("Entry in the drop down which picks which kind of channels to show", "Enabled"), ChannelFilterModel::EnabledChannels);
+    ui->filterCombo->addItem(i18nc("Entry in the drop down which picks which kind of channels to show", "Conflicting"), ChannelFilterModel::ConflictingChannels);
+    ui->filterCombo->addItem(i18nc("Entry in the drop down which picks which kind of channels to show", "For this distribution"), ChannelFilterModel::DistributionChannels);
+    ui->filterCombo->addItem(i18nc("Entry in the drop down which picks which kind of channels to show", "General use"), ChannelFilterModel::GeneralUseChannels);
+    connect(ui->filterCombo, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, [this](){
+        d->filterModel->setFilter(static_cast<ChannelFilterModel::Filter>(ui->filterCombo->currentData().toInt()));
+    });
+    connect(ui->searchEdit, &QLineEdit::textChanged, d->filterModel, &ChannelFilterModel::setSearchText);
+    connect(ui->profileCombo, static_cast<void(QComboBox::*)(int)>(&QComboBox::activated), this, [this](int index){ d->selectProfile(index); });
+    connect(ui->saveProfileButton, &QPushButton::clicked, this, [this](){ d->saveProfile(); });
+    connect(ui->revertButton, &QPushButton::clicked, this, [this](){ d->revert(); });
+    connect(ui->channelList->selectionModel(), &QItemSelectionModel::currentChanged, this, [this](){ d->updateDiffButton(); });
+    connect(ui->probeButton, &QPushButton::clicked, this, [this](){ d->probeMirrors(); });
+    connect(ui->diffButton, &QPushButton::clicked, this, [this](){ d->showDifferences(ui->channelList->currentIndex()); });
+    // Double clicking a channel which cannot be checked is a pretty good hint the user would like to know why
+    connect(ui->channelList, &QAbstractItemView::activated, this, [this](const QModelIndex& index){
+        if(index.data(ChannelModel::ConflictRole).toBool()) {
+            d->showDifferences(index);
+        }
+    });
+    ui->cancelButton->setIcon(QIcon::fromTheme("dialog-cancel"));
+    ui->progressWidget->hide();
+
     // We have no help so remove the button from the buttons.
     // We also have no defaults, so get rid of that as well.
     setButtons(buttons() ^ KCModule::Help ^ KCModule::Default);
@@ -92,231 +215,568 @@ Module::Module(QWidget *parent, const QVariantList &args)
 
 Module::~Module()
 {
+    // Don't leave the helper holding on to apt's lock for nobody's benefit
+    if(d->saveJob) {
+        d->saveJob->kill(KJob::Quietly);
+    }
     delete d;
     delete ui;
 }
 
-void Module::Private::populateSources()
+void Module::Private::showProgress(const QString& message, bool cancellable)
+{
+    progressRecord.clear();
+    repositoryProgress.clear();
+    repositoryOrder.clear();
+    q->ui->progressDetails->clear();
+    q->ui->progressDetails->hide();
+    q->ui->progressLabel->setText(message);
+    q->ui->progressBar->setMaximum(0);
+    q->ui->cancelButton->setVisible(cancellable);
+    q->ui->cancelButton->setEnabled(cancellable);
+    q->ui->progressWidget->show();
+}
+
+void Module::Private::hideProgress()
+{
+    q->ui->progressWidget->hide();
+    q->ui->cancelButton->disconnect();
+}
+
+void Module::Private::probeMirrors()
 {
-    // If the first item is a layout, it means we've got a progress bar thing, so get rid of that first
-    if(q->ui->verticalLayout->itemAt(0)->layout() != 0) {
-        QLayout* grid = q->ui->verticalLayout->itemAt(0)->layout();
-        while(grid->count() > 0) {
-            QLayoutItem* item = grid->takeAt(0);
-            delete item->widget();
-            delete item;
+    // Start over, as whatever we found out last time may well have changed since
+    probe->cancel();
+    q->ui->probeButton->setEnabled(false);
+    QStringList paths;
+    for(int row = 0; row < model->rowCount(); ++row) {
+        const QString path = model->index(row).data(ChannelModel::PathRole).toString();
+        model->setProbeState(path, ChannelModel::Probing);
+        paths << path;
+    }
+    // Reading all the channel files is just as much disk access as scanning them, so it
+    // happens away from the GUI thread as well
+    probeWatcher.setFuture(QtConcurrent::run([paths](){
+        QHash<QString, QVector<SourceEntry> > entries;
+        for(const QString& path : paths) {
+            entries.insert(path, SourcesParser::parseFile(path));
+        }
+        return entries;
+    }));
+}
+
+void Module::Private::loadProfiles(const QString& selected)
+{
+    QComboBox* combo = q->ui->profileCombo;
+    profiles = ChannelProfiles::load();
+    combo->clear();
+    combo->addItem(i18nc("The first entry in the drop down of channel profiles, when none has been picked", "Choose a profile..."));
+    for(const ChannelProfile& profile : profiles) {
+        combo->addItem(profile.title, profile.name);
+        combo->setItemData(combo->count() - 1, profile.description, Qt::ToolTipRole);
+        if(profile.name == selected) {
+            combo->setCurrentIndex(combo->count() - 1);
         }
     }
-    // clear existing checkboxes, if there are any...
-    while(q->ui->verticalLayout->count() > 0) {
-        QLayoutItem* item = q->ui->verticalLayout->takeAt(0);
-        delete item->widget();
-        delete item;
-    }
-
-    QMap<QString, QString> sldEntries;
-    QString sldDir(backend->config()->findDirectory("Dir::Etc::sourceparts", QLatin1String("/etc/apt/sources.list.d/")));
-    while(sldDir.endsWith("/")) {
-        sldDir = sldDir.left(sldDir.length() - 1);
-    }
-    QDir sld(sldDir);
-    if(sld.exists()) {
-        for(auto const &entry : sld.entryList(QDir::Files)) {
-            QFile file(QString("%1/%2").arg(sldDir).arg(entry));
-            if(file.open(QIODevice::ReadOnly)) {
-                sldEntries[entry] = file.readAll();
-                file.close();
-            }
+    combo->setEnabled(!profiles.isEmpty());
+}
+
+void Module::Private::selectProfile(int index)
+{
+    const ChannelProfile* profile = ChannelProfiles::find(profiles, q->ui->profileCombo->itemData(index).toString());
+    if(!profile) {
+        return;
+    }
+    // This only sets up the changes, and they all go to the helper together once applied,
+    // so switching profiles means one authentication and one refresh, however much changes
+    QStringList missing;
+    model->setPendingStates(ChannelProfiles::changes(*profile, ChannelScanner::channels(scanState), &missing));
+    selectedProfile = profile->name;
+    selectedProfileChanges = model->changes();
+    if(!missing.isEmpty()) {
+        KMessageBox::informationList(q, i18nc("The text shown when a profile includes channels which do not exist, followed by those channels", "The profile %1 includes channels which are not available, and which have been left out:", profile->title), missing, i18nc("Title for the dialog shown when a profile includes channels which do not exist", "Missing Channels"));
+    }
+}
+
+void Module::Private::saveProfile()
+{
+    bool ok = false;
+    const QString title = QInputDialog::getText(q, i18nc("Title for the dialog asking for the name of a new channel profile", "Save as Profile"), i18nc("Label for the field holding the name of a new channel profile", "Name of the profile:"), QLineEdit::Normal, q->ui->profileCombo->currentIndex() > 0 ? q->ui->profileCombo->currentText() : QString(), &ok).trimmed();
+    if(!ok || title.isEmpty()) {
+        return;
+    }
+    // The channels as the user has them checked, rather than as they are on disk, so a
+    // profile can be put together without having to apply it first
+    QVector<Channel> channels = ChannelScanner::channels(scanState);
+    const QVariantMap changes = model->changes();
+    for(Channel& channel : channels) {
+        if(changes.contains(channel.path)) {
+            channel.state = static_cast<Qt::CheckState>(changes.value(channel.path).toInt());
         }
     }
+    QString name = title;
+    name.replace(QLatin1Char('/'), QLatin1Char('-'));
+    QString error;
+    if(!ChannelProfiles::save(ChannelProfiles::fromChannels(name, title, channels), &error)) {
+        KMessageBox::error(q, error, i18nc("Title for the error dialog when a channel profile could not be saved", "Error saving profile"));
+        return;
+    }
+    loadProfiles(name);
+}
+
+void Module::Private::updateDiffButton()
+{
+    const QModelIndex current = q->ui->channelList->currentIndex();
+    q->ui->diffButton->setEnabled(!saving && !diffWatcher.isRunning() && current.data(ChannelModel::ConflictRole).toBool());
+}
+
+void Module::Private::showDifferences(const QModelIndex& index)
+{
+    if(saving || diffWatcher.isRunning() || !index.data(ChannelModel::ConflictRole).toBool()) {
+        return;
+    }
+    // Nothing is compared until somebody actually wants to see it, and then on a worker, as
+    // generated sources files can be very long indeed
+    diffChannelPath = index.data(ChannelModel::PathRole).toString();
+    diffInstalledPath = scanState.sldDir + QLatin1Char('/') + index.data(ChannelModel::FileNameRole).toString();
+    q->ui->diffButton->setEnabled(false);
+    showProgress(i18nc("Label shown while comparing a conflicting software channel with the installed file", "Comparing %1 with %2...", diffChannelPath, diffInstalledPath), false);
+    const QString channelPath = diffChannelPath;
+    const QString installedPath = diffInstalledPath;
+    diffWatcher.setFuture(QtConcurrent::run([channelPath, installedPath](){
+        return LineDiff::diffFiles(installedPath, channelPath);
+    }));
+}
+
+void Module::Private::differencesReady()
+{
+    if(!saving) {
+        hideProgress();
+    }
+    updateDiffButton();
+    ConflictDialog dialog(diffChannelPath, diffInstalledPath, diffWatcher.result(), q);
+    if(dialog.exec() == ConflictDialog::ReplaceResult && !saving) {
+        QVariantMap changes;
+        changes[diffChannelPath] = HelperAction::ReplaceInstalled;
+        // The user just looked at what this does, so there's no need to ask them again
+        applyChanges(changes, false);
+    }
+}
+
+void Module::Private::populateSources()
+{
+    // Reading all the channels and lists files can take a good long while (lots of files, slow
+    // network mounted data dirs...), so do that on a worker thread, and tell the user we're busy
+    // in the meantime. If we're asked while a scan is already going, just do another one once
+    // the current one is done, as the result of that one is likely already out of date.
+    if(scanWatcher.isRunning()) {
+        fullScanRequested = true;
+        return;
+    }
+    fullScanRequested = false;
+    pendingDirectories.clear();
+
+    if(!saving) {
+        showProgress(i18nc("Label shown while looking for software channels on the system", "Looking for software channels..."), false);
+    }
+
+    // We only need to know where sources.list.d is, so there's no need for a full QApt::Backend
+    // (which would load the whole package cache). Even so, reading apt's configuration is
+    // still reading files, so do that on the worker as well.
+    scanWatcher.setFuture(QtConcurrent::run([](){
+        QString sldDir;
+        {
+            ScopedTimer timer(KCMREPOTOGGLE_MODULE(), QLatin1String("apt config"));
+            sldDir = AptConfig::sourcePartsDirectory();
+        }
+        ScopedTimer timer(KCMREPOTOGGLE_MODULE(), QLatin1String("scan"));
+        return ChannelScanner::scan(sldDir);
+    }));
+}
+
+void Module::Private::scanCompleted()
+{
+    scanState = scanWatcher.result();
+    if(fullScanRequested) {
+        populateSources();
+        return;
+    }
+    QVector<Channel> channels;
+    {
+        ScopedTimer timer(KCMREPOTOGGLE_MODULE(), QLatin1String("compare"));
+        channels = ChannelScanner::channels(scanState);
+    }
+    {
+        // Only the rows which actually changed since last time are touched by this
+        ScopedTimer timer(KCMREPOTOGGLE_MODULE(), QLatin1String("widget build"));
+        model->setChannels(channels);
+    }
+    updateWatchedDirectories();
+    updateDiffButton();
+    if(startupTimer.isValid()) {
+        Tracing::record(KCMREPOTOGGLE_MODULE(), QLatin1String("open"), startupStart, startupTimer.nsecsElapsed() / 1000);
+        startupTimer.invalidate();
+    }
+    if(!saving) {
+        hideProgress();
+    }
+    // Things may well have changed while we were busy scanning
+    if(!pendingDirectories.isEmpty()) {
+        rescanChanged();
+    }
+}
 
-    QString distro;
-
-    OSRelease os;
-    QStringList paths = QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation);
-    for(QString const& path : paths) {
-        // One hard-coded channel, and one for the distribution we're actually running on
-        QStringList channelTypes = QStringList() << QString("%1/release-channels/channels/general-use").arg(path) << QString("%1/release-channels/channels/%2").arg(path).arg(os.id);
-
-        for(QString const &channelsPath : channelTypes) {
-            QDir channels(channelsPath);
-            if(channels.exists()) {
-                for(QString const& channel : channels.entryList(QDir::Files)) {
-                    QCheckBox *checkbox = new QCheckBox(channel);
-                    q->ui->verticalLayout->addWidget(checkbox);
-                    QFile file(QString("%1/%2").arg(channelsPath).arg(channel));
-                    QString contents;
-                    if(file.open(QIODevice::ReadOnly)) {
-                        contents = file.readAll();
-                        file.close();
-                    }
-                    QStringList lines = contents.split("\n");
-                    // Is the first line a comment? Use that as the title
-                    if(lines[0].startsWith("#")) {
-                        checkbox->setText(lines[0].mid(1).trimmed());
-                    }
-                    // How about the second line? That'll be our description
-                    if(lines.length() > 1 && lines[1].startsWith("#")) {
-                        QLabel* descLabel = new QLabel(lines[1].mid(1).trimmed());
-                        descLabel->setWordWrap(true);
-                        q->ui->verticalLayout->addWidget(descLabel);
-                    }
-                    checkbox->setProperty("currentState", Qt::Unchecked);
-                    // if file exists in /etc/apt/sources.lists.d/...
-                    if(sldEntries.contains(channel)) {
-                        // and is identical to our file, check box...
-                        if(contents == sldEntries[channel]) {
-                            checkbox->setCheckState(Qt::Checked);
-                            checkbox->setProperty("currentState", Qt::Checked);
-                        }
-                        // and is different from our file, disable, describe error
-                        // nb: this also ensures we can handle two channels with the same .lists filename... just don't
-                        // enable the one that would otherwise replace what is already there. Needs saying in the UI somehow.
-                        else {
-                            checkbox->setEnabled(false);
-                            checkbox->setToolTip(i18nc("Checkbox tool tip which shows when the contents differ between the channel's .lists file and the .lists file with the same name in apt's soources.lists.d", "This entry cannot be enabled, as a channel with this filename already exists, but the contents differ."));
-                            QLabel *label = new QLabel(QString("The contents of the files %1 and %2/%3 differ - you will have to manually remove %2/%3 to be able to select this channel.").arg(file.fileName()).arg(sldDir).arg(channel)); // this is a placeholder, hence no i18n...
-                            label->setWordWrap(true);
-                            q->ui->verticalLayout->addWidget(label);
-                            // TODO Make it possible to see the difference between the two files, and manually delete the
-                            // other (if it's not represented by another channel...) - this will need thorough thought.
-                        }
-                    }
-                    checkbox->setProperty("channelFile", QString("%1/%2").arg(channelsPath).arg(channel));
-                    q->connect(checkbox, &QCheckBox::stateChanged, [this](){checkCheckStates();});
-                }
+void Module::Private::directoryChanged(const QString& path)
+{
+    QStringList affected;
+    if(path == scanState.sldDir || scanState.channelDirs.contains(path)) {
+        affected << path;
+    }
+    else {
+        // One of the parents of the channel directories, which means one of those may have
+        // just been created (or removed), so look at all of the ones living in there
+        for(const QString& channelsPath : scanState.channelDirs) {
+            if(channelsPath.startsWith(path + "/")) {
+                affected << channelsPath;
             }
         }
     }
-    q->ui->verticalLayout->addStretch();
-    QCheckBox* refreshCheck = new QCheckBox(i18nc("Title label for the checkbox which causes an apt cache refresh when applying the new settings", "Refresh cache when applying"));
-    refreshCheck->setToolTip(i18nc("Tooltip text for the checkbox which causes an apt cache refresh when applying the new settings", "Enabling this will cause the local cache of the software channels to be downloaded when applying new settings. This may cause a large amount of data to be downloaded (up to a couple of hundred MiB)."));
-    refreshCheck->setCheckState(Qt::Checked);
-    q->ui->verticalLayout->addWidget(refreshCheck);
+    for(const QString& directory : affected) {
+        if(!pendingDirectories.contains(directory)) {
+            pendingDirectories << directory;
+        }
+    }
+    if(!pendingDirectories.isEmpty()) {
+        rescanTimer->start();
+    }
 }
 
-// Let's make sure we don't let people apply/ok when there's nothing to save
-void Module::Private::checkCheckStates()
+void Module::Private::rescanChanged()
 {
-    bool changed = false;
-    for(int i = 0; i < q->ui->verticalLayout->count() - 1; ++i) {
-        QCheckBox* checkbox = qobject_cast<QCheckBox*>(q->ui->verticalLayout->itemAt(i)->widget());
-        if(checkbox && checkbox->checkState() != checkbox->property("currentState").value<Qt::CheckState>()) {
-            changed = true;
-            break;
+    // If we're busy, scanCompleted will come back here when done
+    if(scanWatcher.isRunning() || pendingDirectories.isEmpty()) {
+        return;
+    }
+    QStringList changed = pendingDirectories;
+    pendingDirectories.clear();
+    const ChannelScanState state = scanState;
+    scanWatcher.setFuture(QtConcurrent::run([state, changed](){
+        ScopedTimer timer(KCMREPOTOGGLE_MODULE(), QLatin1String("rescan"));
+        return ChannelScanner::rescan(state, changed);
+    }));
+}
+
+void Module::Private::updateWatchedDirectories()
+{
+    // Watch sources.list.d and every channel directory, along with the directory the
+    // channel directories live in, so we also notice if one of them turns up later.
+    // Removing and adding a directory also means the watcher forgets about it, so we
+    // check this again after every scan.
+    QStringList wanted;
+    wanted << scanState.sldDir;
+    for(const QString& channelsPath : scanState.channelDirs) {
+        wanted << channelsPath;
+        wanted << channelsPath.left(channelsPath.lastIndexOf("/"));
+    }
+    QStringList watched = fsWatcher->directories();
+    QStringList toWatch;
+    for(const QString& path : wanted) {
+        if(!watched.contains(path) && !toWatch.contains(path) && QFileInfo(path).isDir()) {
+            toWatch << path;
         }
     }
-    q->changed(changed);
+    if(!toWatch.isEmpty()) {
+        fsWatcher->addPaths(toWatch);
+    }
 }
 
 void Module::load()
 {
+    d->loadProfiles();
+    d->updateRevertButton();
+    d->model->resetPendingStates();
     d->populateSources();
 }
 
 void Module::save()
 {
-    QVariantMap helperargs;
-    for(int i = 0; i < ui->verticalLayout->count() - 1; ++i) {
-        // Because we will flush all of these later, disable them now and we won't have
-        // to do any further magic to make the progress bar enabled
-        QWidget* widget = ui->verticalLayout->itemAt(i)->widget();
-        if(widget) {
-            widget->setEnabled(false);
-            QCheckBox* checkbox = qobject_cast<QCheckBox*>(widget);
-            if(checkbox) {
-                if(checkbox->checkState() != checkbox->property("currentState").value<Qt::CheckState>()) {
-                    helperargs[checkbox->property("channelFile").value<QString>()] = checkbox->checkState();
-                }
-            }
+    QVariantMap helperargs = d->model->changes();
+    if(helperargs.isEmpty()) {
+        return;
+    }
+    d->applyChanges(helperargs, true);
+}
+
+void Module::Private::applyChanges(const QVariantMap& changes, bool confirm)
+{
+    // Look at what is actually on disk before bothering the helper (and the user, with
+    // authentication), as the scan may be out of date, and there may be nothing left to do
+    const QVector<PlannedChange> plan = ChangePlan::compute(scanState.sldDir, changes);
+    QStringList blocked;
+    QStringList planned;
+    for(const PlannedChange& change : plan) {
+        if(change.operation == PlannedChange::Blocked) {
+            blocked << ChangePlan::describe(change);
+        }
+        else if(change.operation != PlannedChange::Unchanged) {
+            planned << ChangePlan::describe(change);
         }
     }
+    if(!blocked.isEmpty()) {
+        KMessageBox::errorList(q, i18nc("The text shown when some of the changes to the software channels cannot be applied, followed by which ones", "Some of the changes cannot be applied, as sources.list.d has changed since the software channels were last looked at. Nothing has been changed."), blocked, i18nc("Title for the error dialog when saving changes to the software channels setup", "Error saving software channels"));
+        // The module considers itself saved once save() returns, which it is not
+        QTimer::singleShot(0, q, [this](){ q->changed(model->isDirty()); });
+        directoryChanged(scanState.sldDir);
+        return;
+    }
 
-    if(!helperargs.isEmpty()) {
-        QCheckBox* refreshCheck = qobject_cast<QCheckBox*>(ui->verticalLayout->itemAt(ui->verticalLayout->count() - 1)->widget());
-        refreshCheck->setEnabled(false);
-        helperargs["/refreshCache"] = refreshCheck->checkState();
-
-        KAuth::Action action = authAction();
-        action.setHelperId("org.kde.kcontrol.kcmrepotoggle");
-        action.setArguments(helperargs);
-        action.setTimeout(1000 * 60 * 20); // twenty minutes... TODO Add a way to cancel this action, because that's a long time...
-
-        KAuth::ExecuteJob* saveJob = action.execute();
-        if(refreshCheck->checkState() == Qt::Checked) {
-            QGridLayout* grid = new QGridLayout();
-            QLabel* pleaseWait = new QLabel(i18nc("Label above the progress bar when updating the sources after changing the settings", "Please wait while updating your package cache..."), this);
-            grid->addWidget(pleaseWait, 0, 0);
-            d->progress = new QProgressBar(this);
-            ui->verticalLayout->insertWidget(0, d->progress);
-            grid->addWidget(d->progress, 1, 0);
-            QPushButton* cancelRefresh = new QPushButton(this);
-            cancelRefresh->setIcon(QIcon::fromTheme("dialog-cancel"));
-            grid->addWidget(cancelRefresh, 0, 1, 2, 1);
-            ui->verticalLayout->insertLayout(0, grid);
-            connect(cancelRefresh, &QPushButton::clicked, saveJob, [saveJob](){
-                saveJob->kill(KJob::EmitResult);
-                // The above /should/ really do the trick... and because what's below doesn't work because HelperProxy is
-                // not exported, cancelling does not currently work. Fun-fun. Will need to fix that in KAuth itself.
-                // KAuth::HelperProxy::stopAction("org.kde.kcontrol.kcmrepotoggle", "org.kde.kcontrol.kcmrepotoggle.save");
-                // Thoughts on this: Really would be nice to have the normal job kill code work, because
-                // having this API different for no appreciable reason seems very strange to me. There is
-                // nothing inherent in KAuth that means this has to somehow be different normal KJob code.
-            });
+    const QVariantMap helperChanges = ChangePlan::helperChanges(plan);
+    if(helperChanges.isEmpty()) {
+        // Everything already is the way the user wants it, so all we need is to notice that
+        qCDebug(KCMREPOTOGGLE_MODULE) << "Nothing to apply, not starting the helper";
+        directoryChanged(scanState.sldDir);
+        return;
+    }
+
+    if(confirm) {
+        const int answer = KMessageBox::questionYesNoList(q, i18nc("The text shown before applying changes to the software channels, followed by the changes", "The following changes will be made to your software channels:"), planned, i18nc("Title for the dialog shown before applying changes to the software channels", "Apply Changes"), KStandardGuiItem::apply(), KStandardGuiItem::cancel(), QLatin1String("ConfirmChannelChanges"));
+        if(answer != KMessageBox::Yes) {
+            QTimer::singleShot(0, q, [this](){ q->changed(model->isDirty()); });
+            return;
         }
+    }
+    KAuth::Action action = q->authAction();
+    HelperAction::prepare(action, helperChanges, q->ui->refreshCheck->checkState() == Qt::Checked, false, q->ui->validateCheck->checkState() == Qt::Checked);
+    if(!selectedProfile.isEmpty() && changes == selectedProfileChanges) {
+        HelperAction::setProfile(action, selectedProfile);
+    }
+    runHelper(action);
+}
+
+void Module::Private::updateRevertButton()
+{
+    // The helper keeps these where anybody can read them, so we can tell whether there is
+    // anything to go back to without asking it
+    const QVector<SnapshotInfo> snapshots = SourcesSnapshot::list(SourcesSnapshot::storeDirectory());
+    q->ui->revertButton->setEnabled(!saving && !snapshots.isEmpty());
+    if(!snapshots.isEmpty()) {
+        q->ui->revertButton->setToolTip(i18nc("Tooltip for the button which puts the software channels back the way they were before the last change, with when that was", "Put the software channels back the way they were on %1", QLocale().toString(snapshots.first().created.toLocalTime(), QLocale::ShortFormat)));
+    }
+}
 
-        connect(saveJob, &KJob::result, this, [this](KJob* job){ d->saveCompleted(job); });
-        connect(saveJob, &KAuth::ExecuteJob::statusChanged, this, [saveJob, this](KAuth::Action::AuthStatus status){ d->saveJobStatusChanged(saveJob, status); });
-        connect(saveJob, &KAuth::ExecuteJob::newData, this, [this](QVariantMap data){ d->saveJobNewData(data); });
-        connect(saveJob, SIGNAL(percent(KJob*, unsigned long)), this, SLOT(percentChanged(KJob*, unsigned long)));
+void Module::Private::revert()
+{
+    const QVector<SnapshotInfo> snapshots = SourcesSnapshot::list(SourcesSnapshot::storeDirectory());
+    if(saving || snapshots.isEmpty()) {
+        return;
+    }
+    const SnapshotInfo& snapshot = snapshots.first();
+    QString text = i18nc("The text shown before putting the software channels back the way they were, with when that was, followed by the sources lists files there were then", "The software channels will be put back the way they were on %1, when these were the files in sources.list.d:", QLocale().toString(snapshot.created.toLocalTime(), QLocale::ShortFormat));
+    // Only what the helper added since goes away again, so say so for anything which does not
+    QStringList byHelper;
+    QStringList byOthers;
+    SourcesSnapshot::addedSince(SourcesSnapshot::storeDirectory(), snapshot.id, scanState.sldDir, &byHelper, &byOthers);
+    if(!byHelper.isEmpty()) {
+        text = i18nc("The text shown before reverting, followed by the names of the sources lists files which will be removed, and then the rest of the text", "These files, which were added by this tool since, will be removed: %1\n\n%2", byHelper.join(QLatin1String(", ")), text);
+    }
+    if(!byOthers.isEmpty()) {
+        text = i18nc("The text shown before reverting, followed by the names of the sources lists files which something else added since, and then the rest of the text", "These files, which were added by something else since, will be left alone: %1\n\n%2", byOthers.join(QLatin1String(", ")), text);
+    }
+    const int answer = KMessageBox::questionYesNoList(q, text, snapshot.sources, i18nc("Title for the dialog shown before putting the software channels back the way they were", "Revert Changes"), KGuiItem(i18nc("Button which puts the software channels back the way they were", "Revert"), QLatin1String("edit-undo")), KStandardGuiItem::cancel());
+    if(answer != KMessageBox::Yes) {
+        return;
+    }
+    // Any pending changes were made against what is about to go away
+    model->resetPendingStates();
+    KAuth::Action action = q->authAction();
+    HelperAction::prepareRevert(action, snapshot.id, q->ui->refreshCheck->checkState() == Qt::Checked);
+    runHelper(action);
+}
 
-        saveJob->start();
+void Module::Private::runHelper(KAuth::Action action)
+{
+    Ui::Module* ui = q->ui;
+    // Don't let people fiddle with things while we're applying the changes
+    saving = true;
+    ui->channelList->setEnabled(false);
+    ui->refreshCheck->setEnabled(false);
+    ui->validateCheck->setEnabled(false);
+    ui->diffButton->setEnabled(false);
+    ui->profileCombo->setEnabled(false);
+    ui->saveProfileButton->setEnabled(false);
+    ui->revertButton->setEnabled(false);
+
+    applyStart = Tracing::now();
+    applyTimer.start();
+    authRecorded = false;
+    KAuth::ExecuteJob* executeJob = action.execute();
+    saveJob = executeJob;
+    if(ui->refreshCheck->checkState() == Qt::Checked) {
+        showProgress(i18nc("Label above the progress bar when updating the sources after changing the settings", "Please wait while updating your package cache..."), true);
+    }
+    else {
+        showProgress(i18nc("Label above the progress bar while applying changes to the software channels", "Applying changes..."), true);
     }
+    q->connect(ui->cancelButton, &QPushButton::clicked, executeJob, [ui, executeJob](){
+        // Killing the job asks the helper to stop (through HelperSupport::isStopped() on its
+        // end), which then cancels whatever apt is doing and puts sources.list.d back the way
+        // it was before we started. The watcher will let us know once it has done so.
+        ui->cancelButton->setEnabled(false);
+        ui->progressLabel->setText(i18nc("Label above the progress bar after the user asked for applying the changes to be cancelled", "Cancelling..."));
+        executeJob->kill(KJob::EmitResult);
+    });
+
+    q->connect(executeJob, &KJob::result, q, [this](KJob* job){ saveCompleted(job); });
+    q->connect(executeJob, &KAuth::ExecuteJob::statusChanged, q, [this](KAuth::Action::AuthStatus status){ saveJobStatusChanged(status); });
+    q->connect(executeJob, &KAuth::ExecuteJob::newData, q, [this](QVariantMap data){ saveJobNewData(data); });
+    q->connect(executeJob, SIGNAL(percent(KJob*, unsigned long)), q, SLOT(percentChanged(KJob*, unsigned long)));
+
+    executeJob->start();
 }
 
 void Module::percentChanged(KJob* /*job*/, unsigned long percent)
 {
-    if(!d->progress) {
+    if(!d->saving) {
         return;
     }
     if(percent > 100) {
-        d->progress->setMaximum(0);
+        ui->progressBar->setMaximum(0);
     }
     else {
-        d->progress->setMaximum(100);
-        d->progress->setValue(percent);
+        ui->progressBar->setMaximum(100);
+        ui->progressBar->setValue(percent);
     }
 }
 
-void Module::Private::saveJobStatusChanged(KAuth::ExecuteJob* saveJob, KAuth::Action::AuthStatus status)
+void Module::Private::saveJobStatusChanged(KAuth::Action::AuthStatus status)
 {
+    // Errors are reported once the job is done, in saveCompleted(), which hears about all of them
     switch(status) {
+    case KAuth::Action::AuthorizedStatus:
+        // Which includes however long the user took to type in their password
+        if(!authRecorded) {
+            Tracing::record(KCMREPOTOGGLE_MODULE(), QLatin1String("helper auth"), applyStart, applyTimer.nsecsElapsed() / 1000);
+            authRecorded = true;
+        }
+        break;
     case KAuth::Action::DeniedStatus:
     case KAuth::Action::ErrorStatus:
     case KAuth::Action::InvalidStatus:
-        KMessageBox::error(q, i18nc("The text used to describe an error which occurred when attempting to save the software channels setup to the user", "An error occurred when attempting to save the changes. The reported error was: %1").arg(saveJob->errorText()), i18nc("Title for the error dialog when saving changes to the software channels setup", "Error saving software channels"));
-        break;
     case KAuth::Action::UserCancelledStatus:
     case KAuth::Action::AuthRequiredStatus:
-    case KAuth::Action::AuthorizedStatus:
     default:
         break;
     }
 }
 
-void Module::Private::saveCompleted(KJob* /*job*/)
+void Module::Private::saveCompleted(KJob* job)
 {
+    // The helper either applied everything, or put it all back the way it was, so all
+    // there is to do here is tell the user which of those it was
+    KAuth::ExecuteJob* executeJob = qobject_cast<KAuth::ExecuteJob*>(job);
+    saveJob.clear();
+    Tracing::record(KCMREPOTOGGLE_MODULE(), QLatin1String("apply"), applyStart, applyTimer.nsecsElapsed() / 1000);
+    if(executeJob) {
+        Tracing::addRecords(executeJob->data().value(QLatin1String("timings")).toList(), QLatin1String("kcmrepotoggleauthhelper"));
+    }
+    // Being cancelled is not an error, as far as the user is concerned, it's what they asked for,
+    // and neither is saying no to (or not being allowed past) the password prompt
+    const int error = executeJob ? executeJob->error() : 0;
+    const bool quiet = error == KJob::KilledJobError
+        || error == KAuth::ActionReply::UserCancelledError
+        || error == KAuth::ActionReply::AuthorizationDeniedError
+        || (executeJob && executeJob->data().value(QLatin1String("cancelled")).toBool());
+    if(error && !quiet) {
+        QStringList failed;
+        const QVariantMap results = executeJob->data().value(QLatin1String("results")).toMap();
+        for(QVariantMap::const_iterator it = results.constBegin(); it != results.constEnd(); ++it) {
+            if(it.value().toString() == QLatin1String("failed")) {
+                failed << it.key();
+            }
+        }
+        KMessageBox::errorList(q, i18nc("The text used to describe an error which occurred when attempting to save the software channels setup to the user", "An error occurred when attempting to save the changes. The reported error was: %1", executeJob->errorText()), failed, i18nc("Title for the error dialog when saving changes to the software channels setup", "Error saving software channels"));
+    }
+
     // If we are not OKing here, only applying, this potentially becomes terribly useful, as we
     // may have .lists files with the same name. So, clear things up, so we can get impossible
     // selections disabled
-    populateSources();
-    progress = 0;
+    saving = false;
+    hideProgress();
+    q->ui->channelList->setEnabled(true);
+    q->ui->refreshCheck->setEnabled(true);
+    q->ui->validateCheck->setEnabled(true);
+    q->ui->profileCombo->setEnabled(!profiles.isEmpty());
+    q->ui->saveProfileButton->setEnabled(true);
+    updateDiffButton();
+    updateRevertButton();
+    // The module considered itself saved as soon as save() returned, but if the helper failed or
+    // was cancelled, the pending changes are all still there, and should be possible to apply again
+    q->changed(model->isDirty());
+    // The watcher will tell us about this as well, but it can run out of watches, so make sure
+    // we at least look at sources.list.d again. Nothing else needs scanning after a save.
+    directoryChanged(scanState.sldDir);
 }
 
-void Module::Private::saveJobNewData(const QVariantMap& /*data*/)
+void Module::Private::saveJobNewData(const QVariantMap& data)
 {
-//     qDebug() << "New data" << data;
-    // This would be nice at a later point in time... for now, we're not using this.
+    // The helper only sends us what changed, so keep track of the rest ourselves
+    for(QVariantMap::const_iterator it = data.constBegin(); it != data.constEnd(); ++it) {
+        progressRecord[it.key()] = it.value();
+    }
+    KFormat format;
+
+    const QString phase = progressRecord.value(QLatin1String("phase")).toString();
+    QString message;
+    if(phase == QLatin1String("downloading")) {
+        message = i18nc("Label above the progress bar while downloading package lists after changing the settings", "Downloading package lists...");
+    }
+    else if(phase == QLatin1String("processing")) {
+        message = i18nc("Label above the progress bar while apt reads the package lists after changing the settings", "Processing package lists...");
+    }
+    else if(phase == QLatin1String("finished")) {
+        message = i18nc("Label above the progress bar once the package cache has been updated", "Finished updating your package cache");
+    }
+    else {
+        message = i18nc("Label above the progress bar when updating the sources after changing the settings", "Please wait while updating your package cache...");
+    }
+    const quint64 speed = progressRecord.value(QLatin1String("speed")).toULongLong();
+    if(speed > 0 && phase == QLatin1String("downloading")) {
+        message = i18nc("Progress label while downloading, with the overall download speed and the estimated time left", "%1 (%2/s, %3 remaining)", message, format.formatByteSize(speed), format.formatDuration(progressRecord.value(QLatin1String("eta")).toULongLong() * 1000));
+    }
+    q->ui->progressLabel->setText(message);
+
+    // One line for each repository we've heard about, most recent first, so it's easy to spot the one holding things up
+    if(data.contains(QLatin1String("uri"))) {
+        const QString uri = data.value(QLatin1String("uri")).toString();
+        const QString item = data.value(QLatin1String("item")).toString();
+        const QString status = data.value(QLatin1String("itemStatus")).toString();
+        QString line;
+        if(status == QLatin1String("done")) {
+            line = i18nc("Progress of a single repository when it has been downloaded, with the downloaded file and its size", "%1 %2: downloaded %3", uri, item, data.contains(QLatin1String("size")) ? data.value(QLatin1String("size")).toString() : format.formatByteSize(data.value(QLatin1String("total")).toULongLong()));
+        }
+        else if(status == QLatin1String("hit")) {
+            line = i18nc("Progress of a single repository when the file was already up to date", "%1 %2: up to date", uri, item);
+        }
+        else if(status == QLatin1String("error")) {
+            line = i18nc("Progress of a single repository when downloading failed", "%1 %2: failed", uri, item);
+        }
+        else if(status == QLatin1String("ignored")) {
+            line = i18nc("Progress of a single repository when the file was not available and not needed", "%1 %2: not available", uri, item);
+        }
+        else {
+            line = i18nc("Progress of a single repository while downloading, with the downloaded and total sizes", "%1 %2: %3 of %4", uri, item, format.formatByteSize(data.value(QLatin1String("bytes")).toULongLong()), format.formatByteSize(data.value(QLatin1String("total")).toULongLong()));
+        }
+        const QString key = uri + item;
+        repositoryOrder.removeAll(key);
+        repositoryOrder.prepend(key);
+        repositoryProgress[key] = line;
+    }
+    QStringList lines;
+    for(int i = 0; i < repositoryOrder.count() && i < 8; ++i) {
+        lines << repositoryProgress.value(repositoryOrder.at(i));
+    }
+    q->ui->progressDetails->setText(lines.join(QLatin1Char('\n')));
+    q->ui->progressDetails->setVisible(!lines.isEmpty());
 }
 
 void Module::defaults()
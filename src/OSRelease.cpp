@@ -20,116 +20,190 @@
 
 #include "OSRelease.h"
 
-#include <QDebug>
+#include "Logging.h"
+#include "Tracing.h"
+
 #include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <string.h>
+#include <sys/stat.h>
 
-#include <KLocalizedString>
-#include <KShell>
+// The places the specification says the file may be in, in order of preference
+static const char *const osReleasePaths[] = { "/etc/os-release", "/usr/lib/os-release" };
 
-static void setVar(QString *var, const QString &value) 
+static bool isBlank(char c)
 {
-    // Values may contain quotation marks, strip them as we have no use for them.
-    KShell::Errors error;
-    QStringList args = KShell::splitArgs(value, KShell::NoOptions, &error);
-    if (error != KShell::NoError) { // Failed to parse.
-        return;
-    }
-    *var = args.join(QChar(' '));
+    return c == ' ' || c == '\t' || c == '\r';
 }
 
-static void setVar(QStringList *var, const QString &value)
+// Unquotes and unescapes a value in a single pass. The value is everything after the first
+// '=' on the line, so a '=' inside it is just another character. Quoting follows the shell
+// rules the specification refers to: nothing is special inside single quotes, and only
+// $, ", `, \ and newlines may be escaped inside double quotes or outside quotes.
+static QString unquote(const char *begin, const char *end)
 {
-    // Instead of passing the verbatim value we manually strip any initial quotes
-    // and then run it through KShell. At this point KShell will actually split
-    // by spaces giving us the final QStringList.
-    // NOTE: Splitting like this does not actually allow escaped substrings to
-    //       be handled correctly, so "kitteh \"french fries\"" would result in
-    //       three list entries. I'd argue that if someone makes an id like that
-    //       they are at fault for the bogus parsing here though as id explicitly
-    //       is required to not contain spaces even if more advanced shell escaping
-    //       is also allowed...
-    QString value_ = value;
-    if (value_.at(0) == QChar('"') && value_.at(value_.size()-1) == QChar('"')) {
-        value_.remove(0, 1);
-        value_.remove(-1, 1);
+    // The common case of an unquoted value without escapes needs no copying at all
+    const char *c = begin;
+    while (c != end && *c != '"' && *c != '\'' && *c != '\\') {
+        ++c;
     }
-    KShell::Errors error;
-    QStringList args = KShell::splitArgs(value_, KShell::NoOptions, &error);
-    if (error != KShell::NoError) { // Failed to parse.
-        return;
+    if (c == end) {
+        return QString::fromUtf8(begin, int(end - begin));
     }
-    *var = args;
+
+    QByteArray value;
+    value.reserve(int(end - begin));
+    value.append(begin, int(c - begin));
+    char quote = 0;
+    for (; c != end; ++c) {
+        if (quote == '\'') {
+            if (*c == '\'') {
+                quote = 0;
+            } else {
+                value.append(*c);
+            }
+        } else if (*c == '\\' && c + 1 != end) {
+            const char next = *(c + 1);
+            if (next == '\n') {
+                // A line continuation, which leaves nothing behind
+                ++c;
+            } else if (quote == 0 || next == '$' || next == '"' || next == '`' || next == '\\') {
+                value.append(next);
+                ++c;
+            } else {
+                value.append(*c);
+            }
+        } else if (*c == '"' && (quote == 0 || quote == '"')) {
+            quote = quote ? 0 : '"';
+        } else if (*c == '\'' && quote == 0) {
+            quote = '\'';
+        } else {
+            value.append(*c);
+        }
+    }
+    return QString::fromUtf8(value);
 }
 
 OSRelease::OSRelease()
 {
-    // Set default values for non-optional fields.
-    name = QStringLiteral("Linux");
-    id = QStringLiteral("linux");
-    prettyName = QStringLiteral("Linux");
-
-    QString fileName;
-
-    if (QFile::exists(QStringLiteral("/etc/os-release"))) {
-        fileName = QStringLiteral("/etc/os-release");
-    } else if (QFile::exists(QStringLiteral("/usr/lib/os-release"))) {
-        fileName = QStringLiteral("/usr/lib/os-release");
-    } else {
-        return;
+    QByteArray contents;
+    for (const char *path : osReleasePaths) {
+        QFile file(QFile::decodeName(path));
+        if (file.open(QIODevice::ReadOnly)) {
+            contents = file.readAll();
+            break;
+        }
     }
+    parse(contents);
+}
 
+OSRelease::OSRelease(const QByteArray &contents)
+{
+    parse(contents);
+}
 
-    QFile file(fileName);
+void OSRelease::parse(const QByteArray &contents)
+{
+    // Set default values for non-optional fields.
     // NOTE: The os-release specification defines default values for specific
     //       fields which means that even if we can not read the os-release file
     //       we have sort of expected default values to use.
-    // TODO: it might still be handy to indicate to the outside whether
-    //       fallback values are being used or not.
-    file.open(QIODevice::ReadOnly | QIODevice::Text);
-    QString line;
-    QStringList comps;
-    while (!file.atEnd()) {
-        line = file.readLine();
-
-        if (line.startsWith(QChar('#'))) {
-            // Comment line
-            continue;
-        }
+    name = QStringLiteral("Linux");
+    id = QStringLiteral("linux");
+    prettyName = QStringLiteral("Linux");
 
-        comps = line.split(QChar('='));
+    const char *c = contents.constData();
+    const char *const end = c + contents.size();
+    while (c != end) {
+        // Find the end of the line, taking escaped newlines into account
+        const char *lineEnd = c;
+        while (lineEnd != end && *lineEnd != '\n') {
+            lineEnd += (*lineEnd == '\\' && lineEnd + 1 != end) ? 2 : 1;
+        }
+        const char *lineStart = c;
+        c = lineEnd == end ? end : lineEnd + 1;
 
-        if (comps.size() != 2) {
+        while (lineStart != lineEnd && isBlank(*lineStart)) {
+            ++lineStart;
+        }
+        while (lineEnd != lineStart && isBlank(*(lineEnd - 1))) {
+            --lineEnd;
+        }
+        if (lineStart == lineEnd || *lineStart == '#') {
+            // Empty or comment line
+            continue;
+        }
+        const char *equals = static_cast<const char *>(memchr(lineStart, '=', lineEnd - lineStart));
+        if (!equals || equals == lineStart) {
             // Invalid line.
             continue;
         }
 
-        QString key = comps.at(0);
-        QString value = comps.at(1).trimmed();
+        const QLatin1String key(lineStart, int(equals - lineStart));
+        const QString value = unquote(equals + 1, lineEnd);
         if (key == QLatin1String("NAME"))
-            setVar(&name, value);
+            name = value;
         else if (key == QLatin1String("VERSION"))
-            setVar(&version, value);
+            version = value;
         else if (key == QLatin1String("ID"))
-            setVar(&id, value);
+            id = value;
         else if (key == QLatin1String("ID_LIKE"))
-            setVar(&idLike, value);
+            idLike = value.split(QLatin1Char(' '), QString::SkipEmptyParts);
         else if (key == QLatin1String("VERSION_ID"))
-            setVar(&versionId, value);
+            versionId = value;
         else if (key == QLatin1String("PRETTY_NAME"))
-            setVar(&prettyName, value);
+            prettyName = value;
         else if (key == QLatin1String("ANSI_COLOR"))
-            setVar(&ansiColor, value);
+            ansiColor = value;
         else if (key == QLatin1String("CPE_NAME"))
-            setVar(&cpeName, value);
+            cpeName = value;
         else if (key == QLatin1String("HOME_URL"))
-            setVar(&homeUrl, value);
+            homeUrl = value;
         else if (key == QLatin1String("SUPPORT_URL"))
-            setVar(&supportUrl, value);
+            supportUrl = value;
         else if (key == QLatin1String("BUG_REPORT_URL"))
-            setVar(&bugReportUrl, value);
+            bugReportUrl = value;
         else if (key == QLatin1String("BUILD_ID"))
-            setVar(&buildId, value);
-        // os-release explicitly allows for vendor specific aditions. We have no
-        // interest in those right now.
+            buildId = value;
+        // os-release explicitly allows for vendor specific additions, so hang on to those
+        else
+            extra.insert(key, value);
+    }
+}
+
+OSRelease OSRelease::current()
+{
+    static QMutex mutex;
+    static bool valid = false;
+    static OSRelease cached{QByteArray()};
+    static struct stat cachedInfo;
+    static const char *cachedPath = 0;
+
+    // One stat is all it takes to know whether the file changed since we last read it
+    const char *path = 0;
+    struct stat info;
+    for (const char *candidate : osReleasePaths) {
+        if (::stat(candidate, &info) == 0) {
+            path = candidate;
+            break;
+        }
+    }
+
+    QMutexLocker locker(&mutex);
+    if (valid && path == cachedPath && (!path || (info.st_mtim.tv_sec == cachedInfo.st_mtim.tv_sec
+                                                  && info.st_mtim.tv_nsec == cachedInfo.st_mtim.tv_nsec
+                                                  && info.st_size == cachedInfo.st_size
+                                                  && info.st_ino == cachedInfo.st_ino))) {
+        return cached;
+    }
+    ScopedTimer timer(KCMREPOTOGGLE_OSRELEASE(), QStringLiteral("os-release"));
+    cached = OSRelease();
+    cachedPath = path;
+    if (path) {
+        cachedInfo = info;
     }
+    valid = true;
+    return cached;
 }
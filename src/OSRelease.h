@@ -21,14 +21,31 @@
 #ifndef OSRELEASE_H
 #define OSRELEASE_H
 
+#include <QByteArray>
+#include <QMap>
 #include <QString>
 #include <QStringList>
 
 class OSRelease
 {
 public:
+    /**
+     * Reads and parses the system's os-release file. Prefer current(), which only
+     * does this again when the file has actually changed.
+     */
     OSRelease();
 
+    /**
+     * Parses the given contents of an os-release file
+     */
+    explicit OSRelease(const QByteArray &contents);
+
+    /**
+     * The system's os-release, as of the last time the file changed. This is shared
+     * by the whole process, and safe to call from any thread.
+     */
+    static OSRelease current();
+
     QString name;
     QString version;
     QString id;
@@ -42,6 +59,14 @@ public:
     QString supportUrl;
     QString bugReportUrl;
     QString buildId;
+    /**
+     * Any keys not known above (such as VERSION_CODENAME, or vendor specific
+     * additions), with their unquoted values
+     */
+    QMap<QString, QString> extra;
+
+private:
+    void parse(const QByteArray &contents);
 };
 
 #endif // OSRELEASE_H
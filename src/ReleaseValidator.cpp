@@ -0,0 +1,422 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ReleaseValidator.h"
+
+#include "ChannelVerifier.h"
+#include "Logging.h"
+
+#include <KLocalizedString>
+
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QRegularExpression>
+#include <QSet>
+#include <QTemporaryDir>
+#include <QTimer>
+
+// Any more than this, and the repository is most likely sending us round in circles
+static const int maximumRedirects = 5;
+
+/**
+ * One repository (that is, one dists directory, or the top of a flat repository), what the
+ * sources using it ask for, and what was downloaded from it
+ */
+struct Repository
+{
+    QUrl url;
+    QVector<SourceEntry> entries;
+    /**
+     * The files downloaded so far, by name
+     */
+    QHash<QString, QByteArray> files;
+    /**
+     * The names of the files the repository says it does not have
+     */
+    QSet<QString> missing;
+    /**
+     * Why the repository could not be checked at all, if it could not
+     */
+    QString error;
+};
+
+/**
+ * Downloads the Release files of a number of repositories, all at the same time, following
+ * redirects by hand (as not all the versions of Qt we build against can do that for us)
+ */
+class ReleaseFetcher
+{
+public:
+    explicit ReleaseFetcher(QVector<Repository>& repositories)
+        : repositories(repositories)
+        , timedOut(false)
+        , stopped(false)
+    {}
+
+    void get(int index, const QString& name, const QUrl& url, int redirects = 0);
+    void run(int timeout, const std::function<bool()>& isStopped);
+private:
+    QVector<Repository>& repositories;
+    QNetworkAccessManager network;
+    QEventLoop loop;
+    QSet<QNetworkReply*> replies;
+    bool timedOut;
+    bool stopped;
+
+    void abortAll();
+};
+
+void ReleaseFetcher::get(int index, const QString& name, const QUrl& url, int redirects)
+{
+    QNetworkRequest request(url);
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    QNetworkReply* reply = network.get(request);
+    replies << reply;
+    QObject::connect(reply, &QNetworkReply::finished, &loop, [this, reply, index, name, url, redirects](){
+        reply->deleteLater();
+        replies.remove(reply);
+        Repository& repository = repositories[index];
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        const QUrl target = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+        if(reply->error() == QNetworkReply::NoError && status >= 300 && status < 400 && target.isValid()) {
+            if(redirects < maximumRedirects) {
+                get(index, name, url.resolved(target), redirects + 1);
+            }
+            else if(repository.error.isEmpty()) {
+                repository.error = i18nc("Error string used when a software repository redirected too many times", "Too many redirects when downloading %1", url.toDisplayString());
+            }
+        }
+        else if(reply->error() == QNetworkReply::ContentNotFoundError) {
+            repository.missing << name;
+            // Older repositories may not have an InRelease file yet, and only sign the Release file
+            if(name == QLatin1String("InRelease")) {
+                get(index, QLatin1String("Release"), url.resolved(QUrl(QLatin1String("Release"))));
+                get(index, QLatin1String("Release.gpg"), url.resolved(QUrl(QLatin1String("Release.gpg"))));
+            }
+        }
+        else if(reply->error() != QNetworkReply::NoError) {
+            if(repository.error.isEmpty()) {
+                if(stopped) {
+                    repository.error = i18nc("Error string used when checking a software repository was cancelled", "Checking %1 was cancelled", url.toDisplayString());
+                }
+                else if(timedOut) {
+                    repository.error = i18nc("Error string used when a software repository took too long to answer", "%1 did not answer in time", url.toDisplayString());
+                }
+                else {
+                    repository.error = i18nc("Error string used when a file could not be downloaded from a software repository", "Could not download %1: %2", url.toDisplayString(), reply->errorString());
+                }
+            }
+        }
+        else {
+            repository.files.insert(name, reply->readAll());
+        }
+        if(replies.isEmpty()) {
+            loop.quit();
+        }
+    });
+}
+
+void ReleaseFetcher::abortAll()
+{
+    // Aborting finishes the reply there and then, which takes it out of replies
+    const QSet<QNetworkReply*> running = replies;
+    for(QNetworkReply* reply : running) {
+        reply->abort();
+    }
+}
+
+void ReleaseFetcher::run(int timeout, const std::function<bool()>& isStopped)
+{
+    if(replies.isEmpty()) {
+        return;
+    }
+    QTimer::singleShot(timeout, &loop, [this](){
+        timedOut = true;
+        abortAll();
+    });
+    QTimer stopTimer;
+    if(isStopped) {
+        stopTimer.setInterval(100);
+        QObject::connect(&stopTimer, &QTimer::timeout, &loop, [this, &isStopped](){
+            if(!stopped && isStopped()) {
+                stopped = true;
+                abortAll();
+            }
+        });
+        stopTimer.start();
+    }
+    loop.exec();
+}
+
+static bool isFetchable(const QUrl& url)
+{
+    return url.scheme() == QLatin1String("http") || url.scheme() == QLatin1String("https") || url.scheme() == QLatin1String("file");
+}
+
+static QStringList splitField(const QString& value)
+{
+    return value.split(QRegularExpression(QLatin1String("\\s+")), QString::SkipEmptyParts);
+}
+
+static bool hasComponent(const QStringList& available, const QString& component)
+{
+    for(const QString& name : available) {
+        // Some archives list their components with a prefix (such as updates/main), and
+        // sources may ask for them either with or without it
+        if(name == component || name.endsWith(QLatin1Char('/') + component) || component.endsWith(QLatin1Char('/') + name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void checkArchitectures(const SourceEntry& entry, const QStringList& available, const QStringList& architectures, const QString& where, QStringList* problems)
+{
+    // Source packages do not care, and an archive which does not say can not be checked
+    if(entry.type != QLatin1String("deb") || available.isEmpty()) {
+        return;
+    }
+    const QString wanted = entry.options.value(QLatin1String("arch"));
+    if(!wanted.isEmpty()) {
+        for(const QString& architecture : wanted.split(QLatin1Char(','))) {
+            if(!available.contains(architecture)) {
+                *problems << i18nc("Error string used when a software repository does not have packages for an architecture its source asks for", "%1 does not have packages for %2", where, architecture);
+            }
+        }
+        return;
+    }
+    if(architectures.isEmpty() || available.contains(QLatin1String("all"))) {
+        return;
+    }
+    for(const QString& architecture : architectures) {
+        if(available.contains(architecture)) {
+            return;
+        }
+    }
+    *problems << i18nc("Error string used when a software repository does not have packages for any of the architectures the system uses", "%1 does not have packages for any of the architectures this system uses (%2)", where, architectures.join(QLatin1String(", ")));
+}
+
+/**
+ * Work out which keyrings a signature needs checking against, going by a source's signed-by.
+ * Returns false if the signature should not be checked, and sets problem if that is because
+ * something is wrong, rather than because gpgv is not able to.
+ */
+static bool signatureKeyrings(const QString& signedBy, const QHash<QString, QString>& keyringOverrides, QStringList* keyrings, QString* problem)
+{
+    if(signedBy.isEmpty()) {
+        *keyrings = ChannelVerifier::trustedKeyrings();
+        return true;
+    }
+    for(const QString& keyring : signedBy.split(QLatin1Char(','))) {
+        if(!keyring.startsWith(QLatin1Char('/')) || keyring.endsWith(QLatin1String(".asc"))) {
+            qCWarning(KCMREPOTOGGLE_HELPER) << "Not checking signatures made with" << keyring.left(64) << "as gpgv can only use binary keyring files";
+            return false;
+        }
+        const QString path = keyringOverrides.value(keyring, keyring);
+        if(!QFileInfo(path).isFile()) {
+            *problem = i18nc("Error string used when the keyring a software source is signed with does not exist", "The keyring %1 does not exist", keyring);
+            return false;
+        }
+        *keyrings << path;
+    }
+    return true;
+}
+
+static QString writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        return QString();
+    }
+    return path;
+}
+
+static void checkSignature(const Repository& repository, const QString& where, const QStringList& keyrings, const QString& prefix, QStringList* problems)
+{
+    QString signature;
+    QString signedFile;
+    if(repository.files.contains(QLatin1String("InRelease"))) {
+        signature = writeFile(prefix + QLatin1String("InRelease"), repository.files.value(QLatin1String("InRelease")));
+    }
+    else if(repository.files.contains(QLatin1String("Release.gpg"))) {
+        signature = writeFile(prefix + QLatin1String("Release.gpg"), repository.files.value(QLatin1String("Release.gpg")));
+        signedFile = writeFile(prefix + QLatin1String("Release"), repository.files.value(QLatin1String("Release")));
+        if(signedFile.isEmpty()) {
+            signature.clear();
+        }
+    }
+    else {
+        *problems << i18nc("Error string used when the Release file of a software repository is not signed", "The Release file at %1 is not signed", where);
+        return;
+    }
+    if(signature.isEmpty()) {
+        *problems << i18nc("Error string used when the downloaded Release file of a software repository could not be stored for checking", "Could not store the Release file of %1 to check its signature", where);
+        return;
+    }
+    QString output;
+    if(!ChannelVerifier::verifySignature(keyrings, signature, signedFile, &output)) {
+        qCDebug(KCMREPOTOGGLE_HELPER) << "gpgv said about" << where << output;
+        *problems << i18nc("Error string used when the Release file of a software repository is not signed by a trusted key", "The Release file at %1 is not signed by a trusted key", where);
+    }
+}
+
+QStringList ReleaseValidator::validate(const QVector<SourceEntry>& entries, const QStringList& architectures, const QHash<QString, QString>& keyringOverrides, const std::function<bool()>& isStopped, int timeout)
+{
+    QStringList problems;
+
+    // The same repository is usually used by both deb and deb-src, and often by more than one
+    // file, so each is only asked once
+    QVector<Repository> repositories;
+    QHash<QString, int> indexes;
+    for(const SourceEntry& entry : entries) {
+        if(!isFetchable(QUrl(entry.uri))) {
+            qCDebug(KCMREPOTOGGLE_HELPER) << "Not checking" << entry.toString() << "as it is not on http, https or file";
+            continue;
+        }
+        const QString directory = entry.suite.endsWith(QLatin1Char('/')) ? entry.uri + entry.suite : QString("%1dists/%2/").arg(entry.uri).arg(entry.suite);
+        QHash<QString, int>::const_iterator index = indexes.constFind(directory);
+        if(index == indexes.constEnd()) {
+            index = indexes.insert(directory, repositories.count());
+            Repository repository;
+            repository.url = QUrl(directory);
+            repositories << repository;
+        }
+        repositories[index.value()].entries << entry;
+    }
+    if(repositories.isEmpty()) {
+        return problems;
+    }
+
+    ReleaseFetcher fetcher(repositories);
+    for(int i = 0; i < repositories.count(); ++i) {
+        fetcher.get(i, QLatin1String("InRelease"), repositories.at(i).url.resolved(QUrl(QLatin1String("InRelease"))));
+    }
+    fetcher.run(timeout, isStopped);
+    if(isStopped && isStopped()) {
+        return problems << i18nc("Error string used when checking the software repositories was cancelled", "Checking the repositories was cancelled");
+    }
+
+    // gpgv only reads files, so whatever needs its signature checking goes in here first
+    QTemporaryDir temporary;
+    for(int i = 0; i < repositories.count(); ++i) {
+        const Repository& repository = repositories.at(i);
+        const QString where = repository.url.toDisplayString();
+        if(!repository.error.isEmpty()) {
+            problems << repository.error;
+            continue;
+        }
+        QByteArray release = repository.files.value(QLatin1String("InRelease"));
+        if(!repository.files.contains(QLatin1String("InRelease"))) {
+            if(!repository.files.contains(QLatin1String("Release"))) {
+                problems << i18nc("Error string used when a software repository has no Release file, which means the suite asked for does not exist", "There is no Release file at %1, so the suite does not exist there", where);
+                continue;
+            }
+            release = repository.files.value(QLatin1String("Release"));
+        }
+        const QHash<QString, QString> fields = parseRelease(release);
+        const QStringList components = splitField(fields.value(QLatin1String("Components")));
+        const QStringList available = splitField(fields.value(QLatin1String("Architectures")));
+
+        QSet<QString> checked;
+        for(const SourceEntry& entry : repository.entries) {
+            // Flat repositories have no components, and an archive which does not say can not be checked
+            if(!components.isEmpty()) {
+                for(const QString& component : entry.components) {
+                    if(!hasComponent(components, component)) {
+                        problems << i18nc("Error string used when a software repository does not have a component its source asks for", "%1 does not have the component %2", where, component);
+                    }
+                }
+            }
+            checkArchitectures(entry, available, architectures, where, &problems);
+
+            // Sources in the same repository usually share their signed-by, so each
+            // keyring is only checked once
+            if(entry.options.value(QLatin1String("trusted")) == QLatin1String("yes")) {
+                continue;
+            }
+            const QString signedBy = entry.options.value(QLatin1String("signed-by"));
+            if(checked.contains(signedBy)) {
+                continue;
+            }
+            checked << signedBy;
+            QStringList keyrings;
+            QString problem;
+            if(!signatureKeyrings(signedBy, keyringOverrides, &keyrings, &problem)) {
+                if(!problem.isEmpty()) {
+                    problems << problem;
+                }
+                continue;
+            }
+            checkSignature(repository, where, keyrings, QString("%1/%2-").arg(temporary.path()).arg(i), &problems);
+        }
+    }
+    return problems;
+}
+
+QHash<QString, QString> ReleaseValidator::parseRelease(const QByteArray& data)
+{
+    QHash<QString, QString> fields;
+    const QList<QByteArray> lines = data.split('\n');
+    int first = 0;
+    bool clearSigned = false;
+    if(!lines.isEmpty() && lines.first().trimmed() == "-----BEGIN PGP SIGNED MESSAGE-----") {
+        // The armor headers (such as Hash:) go on until the first empty line
+        clearSigned = true;
+        first = 1;
+        while(first < lines.count() && !lines.at(first).trimmed().isEmpty()) {
+            ++first;
+        }
+        ++first;
+    }
+    QString field;
+    for(int i = first; i < lines.count(); ++i) {
+        QByteArray line = lines.at(i);
+        if(line.endsWith('\r')) {
+            line.chop(1);
+        }
+        if(clearSigned) {
+            if(line.startsWith("-----BEGIN PGP SIGNATURE-----")) {
+                break;
+            }
+            // Dash escaping
+            if(line.startsWith("- ")) {
+                line = line.mid(2);
+            }
+        }
+        if(line.startsWith(' ') || line.startsWith('\t')) {
+            if(!field.isEmpty()) {
+                fields[field] += QLatin1Char('\n') + QString::fromUtf8(line.trimmed());
+            }
+            continue;
+        }
+        const int colon = line.indexOf(':');
+        if(colon <= 0) {
+            field.clear();
+            continue;
+        }
+        field = QString::fromUtf8(line.left(colon));
+        fields.insert(field, QString::fromUtf8(line.mid(colon + 1).trimmed()));
+    }
+    return fields;
+}
@@ -0,0 +1,79 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RELEASEVALIDATOR_H
+#define RELEASEVALIDATOR_H
+
+#include "SourcesParser.h"
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+
+/**
+ * Checking that the repositories a set of sources point at actually serve what the sources ask
+ * for, before the sources go anywhere near sources.list.d. For each repository, this downloads
+ * its InRelease file (or its Release and Release.gpg files, if there is no InRelease), all of
+ * them at the same time, and checks that:
+ *
+ * - the suite exists at all (that is, there is a Release file for it)
+ * - each of the components the sources ask for is listed in it
+ * - the architectures are listed in it: all of those given by an arch option, or, without one, at
+ *   least one of those apt is configured for
+ * - it is signed by a key in the keyring the sources name with signed-by, or, without that, by one
+ *   of the keys apt trusts for everything
+ *
+ * Sources marked trusted=yes are not checked for a signature. Neither are those whose signed-by
+ * names a key by fingerprint, or an armored (.asc) keyring, as gpgv cannot use those, which is
+ * only logged. Only http, https and file sources are checked, so this can be tried out against a
+ * repository on the local disk, or one served on the loopback interface.
+ */
+class ReleaseValidator
+{
+public:
+    /**
+     * Check the repositories of the given sources. This blocks until all of them have answered
+     * (or the timeout ran out, or it was told to stop), running an event loop while it waits.
+     *
+     * @param entries The sources to check
+     * @param architectures The architectures apt is configured for (see AptConfig::architectures())
+     * @param keyringOverrides Keyrings which are about to be installed, by the path they will be
+     *                         installed at, mapped to where they can be read from until then
+     * @param isStopped Asked every so often while waiting, and once it returns true, all downloads
+     *                  still running are abandoned (and reported as problems)
+     * @param timeout How long to wait for all the repositories together, in milliseconds
+     * @return Everything which is wrong, one problem per item, or an empty list if nothing is
+     */
+    static QStringList validate(const QVector<SourceEntry>& entries, const QStringList& architectures, const QHash<QString, QString>& keyringOverrides, const std::function<bool()>& isStopped = std::function<bool()>(), int timeout = 30000);
+
+    /**
+     * Read the fields of a Release or InRelease file. The signature around an InRelease
+     * file is stripped off (but not checked), and continuation lines are joined up.
+     *
+     * @param data The contents of the file
+     * @return The fields, by name, with their values trimmed
+     */
+    static QHash<QString, QString> parseRelease(const QByteArray& data);
+};
+
+#endif//RELEASEVALIDATOR_H
@@ -0,0 +1,89 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ScanCache.h"
+
+#include "Logging.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// Bump this whenever ScannedFile changes, so old caches get thrown away rather than misread
+static const quint32 cacheVersion = 3;
+
+static QDataStream& operator<<(QDataStream& stream, const ScannedFile& file)
+{
+    stream << file.modified << file.size << file.inode << file.hash << file.sourcesHash << file.title << file.description << file.signingKey;
+    return stream;
+}
+
+static QDataStream& operator>>(QDataStream& stream, ScannedFile& file)
+{
+    stream >> file.modified >> file.size >> file.inode >> file.hash >> file.sourcesHash >> file.title >> file.description >> file.signingKey;
+    return stream;
+}
+
+QString ScanCache::location()
+{
+    return QString("%1/kcmrepotoggle/scancache").arg(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation));
+}
+
+QHash<QString, ScannedDirectory> ScanCache::load()
+{
+    QHash<QString, ScannedDirectory> directories;
+    QFile file(location());
+    if(!file.open(QIODevice::ReadOnly)) {
+        return directories;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_4);
+    quint32 version = 0;
+    stream >> version;
+    if(version != cacheVersion) {
+        return directories;
+    }
+    stream >> directories;
+    if(stream.status() != QDataStream::Ok) {
+        qCWarning(KCMREPOTOGGLE_MODULE) << "The scan cache in" << file.fileName() << "could not be read, ignoring it";
+        directories.clear();
+    }
+    return directories;
+}
+
+void ScanCache::save(const ChannelScanState& state)
+{
+    QHash<QString, ScannedDirectory> directories = state.channelFiles;
+    directories[state.sldDir] = state.installed;
+
+    QDir().mkpath(location().left(location().lastIndexOf("/")));
+    // Another instance may be reading this while we write it, so only ever replace it whole
+    QSaveFile file(location());
+    if(!file.open(QIODevice::WriteOnly)) {
+        qCWarning(KCMREPOTOGGLE_MODULE) << "Could not write the scan cache to" << file.fileName();
+        return;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_4);
+    stream << cacheVersion << directories;
+    file.commit();
+}
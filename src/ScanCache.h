@@ -0,0 +1,51 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCANCACHE_H
+#define SCANCACHE_H
+
+#include "ChannelScanner.h"
+
+/**
+ * A persistent record of what the last scan found, kept in the user's cache location. This
+ * lets a newly opened module get away with nothing more than a stat() of each file for
+ * anything which has not changed since the module was last used.
+ */
+class ScanCache
+{
+public:
+    /**
+     * The file the cache is stored in
+     */
+    static QString location();
+
+    /**
+     * Everything known from the last time the cache was saved, by directory path. If there
+     * is no cache, or it was written by a version using a different format, this is empty.
+     */
+    static QHash<QString, ScannedDirectory> load();
+
+    /**
+     * Store everything from the scan state for next time
+     */
+    static void save(const ChannelScanState& state);
+};
+
+#endif//SCANCACHE_H
@@ -0,0 +1,325 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SourcesParser.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QHash>
+
+#include <apt-pkg/strutl.h>
+
+#include <string.h>
+
+// A part of the contents being parsed. Everything is picked apart using these, so nothing gets
+// copied (or converted) until we know it is something we want to keep.
+struct Span
+{
+    const char* begin;
+    const char* end;
+
+    bool isEmpty() const
+    {
+        return begin == end;
+    }
+    bool operator==(const char* other) const
+    {
+        return qstrlen(other) == uint(end - begin) && qstrncmp(begin, other, end - begin) == 0;
+    }
+    QString toString() const
+    {
+        return QString::fromUtf8(begin, int(end - begin));
+    }
+};
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static Span trimmed(Span span)
+{
+    while(!span.isEmpty() && isSpace(*span.begin)) {
+        ++span.begin;
+    }
+    while(!span.isEmpty() && isSpace(*(span.end - 1))) {
+        --span.end;
+    }
+    return span;
+}
+
+// The next line, without its newline, moving contents past it
+static Span nextLine(Span& contents)
+{
+    const char* newline = static_cast<const char*>(memchr(contents.begin, '\n', contents.end - contents.begin));
+    Span line = { contents.begin, newline ? newline : contents.end };
+    contents.begin = newline ? newline + 1 : contents.end;
+    return line;
+}
+
+// The next whitespace separated word, moving span past it
+static Span nextWord(Span& span)
+{
+    while(!span.isEmpty() && isSpace(*span.begin)) {
+        ++span.begin;
+    }
+    Span word = { span.begin, span.begin };
+    while(!span.isEmpty() && !isSpace(*span.begin)) {
+        ++span.begin;
+    }
+    word.end = span.begin;
+    return word;
+}
+
+static QStringList words(const QString& value)
+{
+    return value.simplified().split(QLatin1Char(' '), QString::SkipEmptyParts);
+}
+
+// The one-line name of an option, whichever way it was written
+static QString optionName(const QString& name)
+{
+    const QString lower = name.toLower();
+    if(lower == QLatin1String("architectures")) {
+        return QLatin1String("arch");
+    }
+    if(lower == QLatin1String("languages")) {
+        return QLatin1String("lang");
+    }
+    if(lower == QLatin1String("targets")) {
+        return QLatin1String("target");
+    }
+    return lower;
+}
+
+static QString optionValue(const QString& value)
+{
+    // An embedded keyring (for signed-by) is one value, and is left exactly as it is
+    if(value.contains(QLatin1Char('\n'))) {
+        return value;
+    }
+    // Otherwise this is a list, comma separated in one-line style, and space separated in deb822
+    QString spaced = value;
+    spaced.replace(QLatin1Char(','), QLatin1Char(' '));
+    QStringList values = words(spaced);
+    values.sort();
+    values.removeDuplicates();
+    return values.join(QLatin1Char(','));
+}
+
+static SourceEntry normalized(SourceEntry entry)
+{
+    while(entry.uri.endsWith(QLatin1Char('/'))) {
+        entry.uri.chop(1);
+    }
+    entry.uri += QLatin1Char('/');
+    entry.components.sort();
+    entry.components.removeDuplicates();
+    return entry;
+}
+
+QString SourceEntry::toString() const
+{
+    QString line = type;
+    if(!options.isEmpty()) {
+        QStringList optionList;
+        for(QMap<QString, QString>::const_iterator it = options.constBegin(); it != options.constEnd(); ++it) {
+            optionList << QString("%1=%2").arg(it.key()).arg(it.value());
+        }
+        line += QString(" [%1]").arg(optionList.join(QLatin1Char(' ')));
+    }
+    line += QString(" %1 %2").arg(uri).arg(suite);
+    if(!components.isEmpty()) {
+        line += QLatin1Char(' ') + components.join(QLatin1Char(' '));
+    }
+    return line;
+}
+
+SourcesParser::Format SourcesParser::formatFor(const QString& path)
+{
+    return path.endsWith(QLatin1String(".sources")) ? Deb822Format : ListFormat;
+}
+
+QVector<SourceEntry> SourcesParser::parse(const QByteArray& contents, Format format)
+{
+    if(format == Deb822Format) {
+        return parseDeb822(contents);
+    }
+    return parseList(contents);
+}
+
+QVector<SourceEntry> SourcesParser::parseList(const QByteArray& contents)
+{
+    QVector<SourceEntry> entries;
+    Span rest = { contents.constData(), contents.constData() + contents.size() };
+    while(!rest.isEmpty()) {
+        Span line = nextLine(rest);
+        const char* comment = static_cast<const char*>(memchr(line.begin, '#', line.end - line.begin));
+        if(comment) {
+            line.end = comment;
+        }
+
+        const Span type = nextWord(line);
+        if(!(type == "deb") && !(type == "deb-src")) {
+            continue;
+        }
+        SourceEntry entry;
+        entry.type = type.toString();
+        line = trimmed(line);
+        // Options come in square brackets, with (possibly) spaces inside them
+        if(!line.isEmpty() && *line.begin == '[') {
+            const char* close = static_cast<const char*>(memchr(line.begin, ']', line.end - line.begin));
+            if(!close) {
+                continue;
+            }
+            Span options = { line.begin + 1, close };
+            for(Span option = nextWord(options); !option.isEmpty(); option = nextWord(options)) {
+                const char* equals = static_cast<const char*>(memchr(option.begin, '=', option.end - option.begin));
+                if(equals && equals != option.begin) {
+                    entry.options[optionName(Span{option.begin, equals}.toString())] = optionValue(Span{equals + 1, option.end}.toString());
+                }
+            }
+            line.begin = close + 1;
+        }
+        const Span uri = nextWord(line);
+        const Span suite = nextWord(line);
+        if(suite.isEmpty()) {
+            continue;
+        }
+        entry.uri = uri.toString();
+        entry.suite = suite.toString();
+        for(Span component = nextWord(line); !component.isEmpty(); component = nextWord(line)) {
+            entry.components << component.toString();
+        }
+        entries << normalized(entry);
+    }
+    return entries;
+}
+
+static void addStanza(const QHash<QString, QString>& fields, QVector<SourceEntry>& entries)
+{
+    if(fields.isEmpty() || fields.value(QLatin1String("enabled")).trimmed().toLower() == QLatin1String("no")) {
+        return;
+    }
+    SourceEntry entry;
+    entry.components = words(fields.value(QLatin1String("components")));
+    for(QHash<QString, QString>::const_iterator it = fields.constBegin(); it != fields.constEnd(); ++it) {
+        if(it.key() == QLatin1String("types") || it.key() == QLatin1String("uris") || it.key() == QLatin1String("suites")
+            || it.key() == QLatin1String("components") || it.key() == QLatin1String("enabled")) {
+            continue;
+        }
+        entry.options[optionName(it.key())] = optionValue(it.value());
+    }
+    // A stanza describes every combination of its types, URIs and suites
+    const QStringList uris = words(fields.value(QLatin1String("uris")));
+    const QStringList suites = words(fields.value(QLatin1String("suites")));
+    for(const QString& type : words(fields.value(QLatin1String("types")))) {
+        if(type != QLatin1String("deb") && type != QLatin1String("deb-src")) {
+            continue;
+        }
+        entry.type = type;
+        for(const QString& uri : uris) {
+            entry.uri = uri;
+            for(const QString& suite : suites) {
+                entry.suite = suite;
+                entries << normalized(entry);
+            }
+        }
+    }
+}
+
+QVector<SourceEntry> SourcesParser::parseDeb822(const QByteArray& contents)
+{
+    QVector<SourceEntry> entries;
+    QHash<QString, QString> fields;
+    QString currentField;
+    Span rest = { contents.constData(), contents.constData() + contents.size() };
+    while(!rest.isEmpty()) {
+        const Span rawLine = nextLine(rest);
+        const Span line = trimmed(rawLine);
+        if(line.isEmpty()) {
+            // An empty line ends the stanza
+            addStanza(fields, entries);
+            fields.clear();
+            currentField.clear();
+            continue;
+        }
+        if(*line.begin == '#') {
+            continue;
+        }
+        if(isSpace(*rawLine.begin)) {
+            // A continuation of the previous field, where a lone . stands for an empty line
+            if(!currentField.isEmpty()) {
+                QString& value = fields[currentField];
+                value += QLatin1Char('\n');
+                if(!(line == ".")) {
+                    value += line.toString();
+                }
+            }
+            continue;
+        }
+        const char* colon = static_cast<const char*>(memchr(line.begin, ':', line.end - line.begin));
+        if(!colon) {
+            currentField.clear();
+            continue;
+        }
+        currentField = trimmed(Span{line.begin, colon}).toString().toLower();
+        fields[currentField] = trimmed(Span{colon + 1, line.end}).toString();
+    }
+    addStanza(fields, entries);
+    return entries;
+}
+
+QVector<SourceEntry> SourcesParser::parseFile(const QString& path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        return QVector<SourceEntry>();
+    }
+    return parse(file.readAll(), formatFor(path));
+}
+
+QByteArray SourcesParser::digest(const QVector<SourceEntry>& entries)
+{
+    QStringList lines;
+    lines.reserve(entries.count());
+    for(const SourceEntry& entry : entries) {
+        lines << entry.toString();
+    }
+    lines.sort();
+    lines.removeDuplicates();
+    return QCryptographicHash::hash(lines.join(QLatin1Char('\n')).toUtf8(), QCryptographicHash::Sha256);
+}
+
+QString SourcesParser::listsPrefix(const SourceEntry& entry)
+{
+    QString uri = entry.uri;
+    if(!uri.endsWith("/")) {
+        uri += "/";
+    }
+    // Flat repositories have their index right where the suite says, everything else has it in dists
+    if(entry.suite.endsWith("/")) {
+        uri += entry.suite;
+    }
+    else {
+        uri += QString("dists/%1/").arg(entry.suite);
+    }
+    return QString::fromStdString(URItoFileName(uri.toStdString()));
+}
@@ -0,0 +1,133 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SOURCESPARSER_H
+#define SOURCESPARSER_H
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * A single source, as described by one line of a one-line style .list file, or one combination
+ * of type, URI and suite of a stanza in a deb822 style .sources file. Entries come out of the
+ * parser normalised, so two entries which mean the same thing to apt compare equal, however
+ * they were written.
+ */
+struct SourceEntry
+{
+    /**
+     * deb or deb-src
+     */
+    QString type;
+    /**
+     * The URI, always ending in a slash
+     */
+    QString uri;
+    QString suite;
+    /**
+     * The components, sorted, without duplicates
+     */
+    QStringList components;
+    /**
+     * The options given in square brackets (or the equivalent deb822 fields), e.g. arch or
+     * signed-by. The keys are always the lower case one-line names, and lists of values are
+     * sorted and comma separated.
+     */
+    QMap<QString, QString> options;
+
+    /**
+     * The entry in one-line style
+     */
+    QString toString() const;
+
+    bool operator==(const SourceEntry& other) const
+    {
+        return type == other.type
+            && uri == other.uri
+            && suite == other.suite
+            && components == other.components
+            && options == other.options;
+    }
+    bool operator!=(const SourceEntry& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+/**
+ * Reading of apt sources files
+ */
+class SourcesParser
+{
+public:
+    enum Format {
+        /**
+         * The one-line style used in .list files
+         */
+        ListFormat,
+        /**
+         * The deb822 style used in .sources files
+         */
+        Deb822Format
+    };
+
+    /**
+     * The format apt would read the file at the given path as, going by its name
+     */
+    static Format formatFor(const QString& path);
+
+    /**
+     * Parse the contents of a sources file. Comments, empty lines and anything which is not
+     * understood are skipped, as are deb822 stanzas which are not enabled.
+     */
+    static QVector<SourceEntry> parse(const QByteArray& contents, Format format);
+
+    /**
+     * Parse the contents of a one-line style .list file
+     */
+    static QVector<SourceEntry> parseList(const QByteArray& contents);
+
+    /**
+     * Parse the contents of a deb822 style .sources file
+     */
+    static QVector<SourceEntry> parseDeb822(const QByteArray& contents);
+
+    /**
+     * Parse the file at the given path, in the format its name says it is in, or nothing if it
+     * could not be read
+     */
+    static QVector<SourceEntry> parseFile(const QString& path);
+
+    /**
+     * A hash of what the entries mean, which does not depend on the order they are in, or on how
+     * they were written. Two files with the same digest configure apt in exactly the same way.
+     */
+    static QByteArray digest(const QVector<SourceEntry>& entries);
+
+    /**
+     * The prefix which apt gives the names of all the files in its lists directory which
+     * belong to this entry
+     */
+    static QString listsPrefix(const SourceEntry& entry);
+};
+
+#endif//SOURCESPARSER_H
@@ -0,0 +1,387 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SourcesSnapshot.h"
+
+#include "FileHash.h"
+#include "Logging.h"
+
+#include <KLocalizedString>
+
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QSet>
+
+#include <stdio.h>
+
+// Bump this if the format ever changes in a way older versions would misread
+static const int snapshotVersion = 1;
+
+QString SourcesSnapshot::storeDirectory()
+{
+    return QLatin1String("/var/lib/kcmrepotoggle/snapshots");
+}
+
+int SourcesSnapshot::keepCount()
+{
+    return 10;
+}
+
+bool SourcesSnapshot::isValidId(const QString& id)
+{
+    static const QRegularExpression pattern(QLatin1String("^\\d{8}-\\d{6}-\\d{3}(-\\d+)?$"));
+    return pattern.match(id).hasMatch();
+}
+
+// Objects are named by the SHA-256 of their contents, and nothing else
+static bool isObjectName(const QString& hash)
+{
+    static const QRegularExpression pattern(QLatin1String("^[0-9a-f]{64}$"));
+    return pattern.match(hash).hasMatch();
+}
+
+static bool isFileName(const QString& name)
+{
+    return !name.isEmpty() && !name.contains(QLatin1Char('/')) && name != QLatin1String(".") && name != QLatin1String("..");
+}
+
+static QString objectPath(const QString& store, const QString& hash)
+{
+    return QString("%1/objects/%2").arg(store).arg(hash);
+}
+
+// Objects are named by the hex form of the hash
+static QString hashFile(const QString& path)
+{
+    return QString::fromLatin1(FileHash::sha256(path).toHex());
+}
+
+// The hashes of every file in the directory, by name
+static bool hashDirectoryContents(const QString& path, QJsonObject& files)
+{
+    const QDir dir(path);
+    for(const QString& name : dir.entryList(QDir::Files, QDir::Name)) {
+        const QString hash = hashFile(dir.filePath(name));
+        if(hash.isEmpty()) {
+            return false;
+        }
+        files[name] = hash;
+    }
+    return true;
+}
+
+// Put a copy of every file hashed by hashDirectoryContents() into the store
+static bool storeDirectoryContents(const QString& store, const QString& path, const QJsonObject& files)
+{
+    const QDir dir(path);
+    for(QJsonObject::const_iterator it = files.constBegin(); it != files.constEnd(); ++it) {
+        const QString name = it.key();
+        const QString hash = it.value().toString();
+        const QString object = objectPath(store, hash);
+        if(!QFile::exists(object)) {
+            // Copied under a temporary name first, and only moved into place if it is still what was
+            // hashed, so an object is always complete (and what its name says) if it exists
+            const QString partial = object + QLatin1String(".part");
+            QFile::remove(partial);
+            if(!QFile::copy(dir.filePath(name), partial) || hashFile(partial) != hash || ::rename(QFile::encodeName(partial).constData(), QFile::encodeName(object).constData()) != 0) {
+                QFile::remove(partial);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static QJsonObject readSnapshot(const QString& store, const QString& id)
+{
+    if(!SourcesSnapshot::isValidId(id)) {
+        return QJsonObject();
+    }
+    QFile file(QString("%1/%2.json").arg(store).arg(id));
+    if(!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    if(root.value(QLatin1String("version")).toInt() != snapshotVersion) {
+        qCWarning(KCMREPOTOGGLE_HELPER) << "The snapshot" << file.fileName() << "could not be read, or is of an unknown version, ignoring it";
+        return QJsonObject();
+    }
+    return root;
+}
+
+QVector<SnapshotInfo> SourcesSnapshot::list(const QString& store)
+{
+    QVector<SnapshotInfo> snapshots;
+    const QDir dir(store);
+    QStringList entries = dir.entryList(QStringList() << QLatin1String("*.json"), QDir::Files, QDir::Name | QDir::Reversed);
+    for(const QString& entry : entries) {
+        SnapshotInfo snapshot;
+        snapshot.id = entry.left(entry.length() - 5);
+        const QJsonObject root = readSnapshot(store, snapshot.id);
+        if(root.isEmpty()) {
+            continue;
+        }
+        snapshot.created = QDateTime::fromString(root.value(QLatin1String("created")).toString(), Qt::ISODate);
+        snapshot.sources = root.value(QLatin1String("sources")).toObject().keys();
+        snapshot.profile = root.value(QLatin1String("profile")).toString();
+        for(const QJsonValue& name : root.value(QLatin1String("installed")).toArray()) {
+            snapshot.installed << name.toString();
+        }
+        snapshot.hasLists = !QDir(listsDirectory(store, snapshot.id)).entryList(QDir::Files).isEmpty();
+        snapshots << snapshot;
+    }
+    return snapshots;
+}
+
+QString SourcesSnapshot::take(const QString& store, const QString& sldDir, const QString& keyringDir, QString* error, const QString& profile)
+{
+    if(!QDir().mkpath(QString("%1/objects").arg(store))) {
+        *error = i18nc("Error string used when the directory for snapshots of the software channels could not be created", "Failed to create %1", store);
+        return QString();
+    }
+    QJsonObject sources;
+    QJsonObject keyrings;
+    if(!hashDirectoryContents(sldDir, sources) || !hashDirectoryContents(keyringDir, keyrings)) {
+        *error = i18nc("Error string used when the files in sources.list.d could not be copied into a snapshot", "Failed to copy the files in %1 into a snapshot", sldDir);
+        return QString();
+    }
+    // Nothing changed since the newest snapshot (say, because the last change was undone by hand),
+    // and another one the same would only push an older, different one out of the store sooner
+    const QVector<SnapshotInfo> snapshots = list(store);
+    if(!snapshots.isEmpty()) {
+        const QJsonObject newest = readSnapshot(store, snapshots.first().id);
+        if(newest.value(QLatin1String("sources")).toObject() == sources && newest.value(QLatin1String("keyrings")).toObject() == keyrings) {
+            return snapshots.first().id;
+        }
+    }
+
+    const QDateTime created = QDateTime::currentDateTimeUtc();
+    // Named so they sort by when they were taken, and should two ever be taken in the same
+    // millisecond, the second one simply gets a number on the end
+    const QString base = created.toString(QLatin1String("yyyyMMdd-HHmmss-zzz"));
+    QString id = base;
+    for(int i = 1; QFile::exists(QString("%1/%2.json").arg(store).arg(id)); ++i) {
+        id = QString("%1-%2").arg(base).arg(i);
+    }
+
+    if(!storeDirectoryContents(store, sldDir, sources) || !storeDirectoryContents(store, keyringDir, keyrings)) {
+        *error = i18nc("Error string used when the files in sources.list.d could not be copied into a snapshot", "Failed to copy the files in %1 into a snapshot", sldDir);
+        return QString();
+    }
+    QJsonObject root;
+    root[QLatin1String("version")] = snapshotVersion;
+    root[QLatin1String("created")] = created.toString(Qt::ISODate);
+    root[QLatin1String("sourcesDir")] = sldDir;
+    root[QLatin1String("keyringDir")] = keyringDir;
+    root[QLatin1String("sources")] = sources;
+    root[QLatin1String("keyrings")] = keyrings;
+    if(!profile.isEmpty()) {
+        root[QLatin1String("profile")] = profile;
+    }
+    QSaveFile file(QString("%1/%2.json").arg(store).arg(id));
+    if(!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) < 0 || !file.commit()) {
+        *error = i18nc("Error when a snapshot could not be written, followed by the reason", "Could not write %1: %2", file.fileName(), file.errorString());
+        return QString();
+    }
+    return id;
+}
+
+bool SourcesSnapshot::recordInstalled(const QString& store, const QString& id, const QStringList& fileNames)
+{
+    QJsonObject root = readSnapshot(store, id);
+    if(root.isEmpty()) {
+        return false;
+    }
+    // The same snapshot is reused when nothing changed in between, so add to what is there already
+    QStringList installed;
+    for(const QJsonValue& name : root.value(QLatin1String("installed")).toArray()) {
+        installed << name.toString();
+    }
+    for(const QString& name : fileNames) {
+        if(!installed.contains(name)) {
+            installed << name;
+        }
+    }
+    root[QLatin1String("installed")] = QJsonArray::fromStringList(installed);
+    QSaveFile file(QString("%1/%2.json").arg(store).arg(id));
+    if(!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) < 0 || !file.commit()) {
+        qCWarning(KCMREPOTOGGLE_HELPER) << "Could not note the installed files in" << file.fileName() << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void SourcesSnapshot::addedSince(const QString& store, const QString& id, const QString& sldDir, QStringList* byHelper, QStringList* byOthers)
+{
+    byHelper->clear();
+    byOthers->clear();
+    // Anything the helper added after this snapshot, or after any newer one, is the helper's
+    QStringList sources;
+    QSet<QString> installed;
+    for(const SnapshotInfo& snapshot : list(store)) {
+        if(snapshot.id < id) {
+            break;
+        }
+        for(const QString& name : snapshot.installed) {
+            installed << name;
+        }
+        if(snapshot.id == id) {
+            sources = snapshot.sources;
+        }
+    }
+    for(const QString& name : QDir(sldDir).entryList(QDir::Files, QDir::Name)) {
+        if(sources.contains(name)) {
+            continue;
+        }
+        if(installed.contains(name)) {
+            byHelper->append(name);
+        }
+        else {
+            byOthers->append(name);
+        }
+    }
+}
+
+bool SourcesSnapshot::restore(const QString& store, const QString& id, const QString& sldPath, const QString& keyringPath, SourcesTransaction& sources, SourcesTransaction& keyrings, QStringList* removedFiles, QStringList* addedFiles, QString* error)
+{
+    // The id comes from whoever asked for the revert, so only ever take one we handed out ourselves
+    bool known = false;
+    if(isValidId(id)) {
+        for(const SnapshotInfo& snapshot : list(store)) {
+            if(snapshot.id == id) {
+                known = true;
+                break;
+            }
+        }
+    }
+    const QJsonObject root = known ? readSnapshot(store, id) : QJsonObject();
+    if(root.isEmpty()) {
+        *error = i18nc("Error string used when asked to revert to a snapshot which does not exist", "There is no snapshot called %1", id);
+        return false;
+    }
+    const QDir sldDir(sldPath);
+    const QDir keyringDir(keyringPath);
+    const QJsonObject wantedSources = root.value(QLatin1String("sources")).toObject();
+    const QJsonObject wantedKeyrings = root.value(QLatin1String("keyrings")).toObject();
+
+    // Make sure we have everything before deciding to do anything
+    for(const QJsonObject& files : {wantedSources, wantedKeyrings}) {
+        for(QJsonObject::const_iterator it = files.constBegin(); it != files.constEnd(); ++it) {
+            if(!isFileName(it.key()) || !isObjectName(it.value().toString()) || !QFile::exists(objectPath(store, it.value().toString()))) {
+                *error = i18nc("Error string used when a snapshot is missing some of the files it needs", "The snapshot %1 is incomplete, and cannot be restored", id);
+                return false;
+            }
+        }
+    }
+
+    QStringList byHelper;
+    QStringList byOthers;
+    addedSince(store, id, sldPath, &byHelper, &byOthers);
+    if(!byOthers.isEmpty()) {
+        qCWarning(KCMREPOTOGGLE_HELPER) << "Leaving alone files which were added since the snapshot" << id << "by something other than us:" << byOthers;
+    }
+    removedFiles->clear();
+    addedFiles->clear();
+    for(const QString& name : byHelper) {
+        removedFiles->append(name);
+        sources.remove(name, name);
+    }
+    for(QJsonObject::const_iterator it = wantedSources.constBegin(); it != wantedSources.constEnd(); ++it) {
+        const QString current = sldDir.filePath(it.key());
+        if(!QFile::exists(current)) {
+            addedFiles->append(it.key());
+            sources.install(it.key(), objectPath(store, it.value().toString()), it.key());
+        }
+        else if(hashFile(current) != it.value().toString()) {
+            removedFiles->append(it.key());
+            addedFiles->append(it.key());
+            sources.replace(it.key(), objectPath(store, it.value().toString()), it.key());
+        }
+    }
+    for(QJsonObject::const_iterator it = wantedKeyrings.constBegin(); it != wantedKeyrings.constEnd(); ++it) {
+        const QString current = keyringDir.filePath(it.key());
+        if(!QFile::exists(current)) {
+            keyrings.install(current, objectPath(store, it.value().toString()), it.key());
+        }
+        else if(hashFile(current) != it.value().toString()) {
+            keyrings.replace(current, objectPath(store, it.value().toString()), it.key());
+        }
+    }
+    return true;
+}
+
+QString SourcesSnapshot::listsDirectory(const QString& store, const QString& id)
+{
+    return QString("%1/lists/%2").arg(store).arg(id);
+}
+
+int SourcesSnapshot::restoreLists(const QString& store, const QString& id, const QString& listsDir)
+{
+    int restored = 0;
+    if(!isValidId(id)) {
+        return restored;
+    }
+    const QDir kept(listsDirectory(store, id));
+    const QDir lists(listsDir);
+    for(const QString& name : kept.entryList(QDir::Files)) {
+        // Anything apt has since downloaded again is newer than what we have
+        if(lists.exists(name)) {
+            continue;
+        }
+        if(::rename(QFile::encodeName(kept.filePath(name)).constData(), QFile::encodeName(lists.filePath(name)).constData()) == 0
+            || QFile::copy(kept.filePath(name), lists.filePath(name))) {
+            ++restored;
+        }
+    }
+    return restored;
+}
+
+void SourcesSnapshot::prune(const QString& store, int keep)
+{
+    const QVector<SnapshotInfo> snapshots = list(store);
+    QSet<QString> referenced;
+    for(int i = 0; i < snapshots.count(); ++i) {
+        const QString& id = snapshots.at(i).id;
+        if(i >= keep) {
+            QFile::remove(QString("%1/%2.json").arg(store).arg(id));
+            QDir(listsDirectory(store, id)).removeRecursively();
+            continue;
+        }
+        const QJsonObject root = readSnapshot(store, id);
+        for(const QString& key : {QStringLiteral("sources"), QStringLiteral("keyrings")}) {
+            const QJsonObject files = root.value(key).toObject();
+            for(QJsonObject::const_iterator it = files.constBegin(); it != files.constEnd(); ++it) {
+                referenced << it.value().toString();
+            }
+        }
+    }
+    // Only the objects no remaining snapshot needs
+    QDir objects(QString("%1/objects").arg(store));
+    for(const QString& name : objects.entryList(QDir::Files)) {
+        if(!referenced.contains(name)) {
+            objects.remove(name);
+        }
+    }
+}
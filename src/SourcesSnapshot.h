@@ -0,0 +1,177 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SOURCESSNAPSHOT_H
+#define SOURCESSNAPSHOT_H
+
+#include "SourcesTransaction.h"
+
+#include <QDateTime>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * What is known about a single snapshot, without reading any of the files in it
+ */
+struct SnapshotInfo
+{
+    /**
+     * The snapshot's name, which sorts in the order the snapshots were taken in
+     */
+    QString id;
+    QDateTime created;
+    /**
+     * The names of the files which were in sources.list.d at the time
+     */
+    QStringList sources;
+    /**
+     * Whether package lists which were removed after the snapshot was taken were kept with it
+     */
+    bool hasLists = false;
+    /**
+     * The name of the channel profile which was switched to right after the snapshot was
+     * taken, if that is what happened
+     */
+    QString profile;
+    /**
+     * The names of the files the helper itself added to sources.list.d after the snapshot was
+     * taken, as part of the change the snapshot was taken for
+     */
+    QStringList installed;
+};
+
+/**
+ * Snapshots of sources.list.d (and the keyrings in /etc/apt/keyrings), which the helper takes
+ * before every change, so that whatever the change broke can be undone in one go.
+ *
+ * Each snapshot is a small JSON file naming the files which were there, along with the SHA-256
+ * of their contents, and the contents themselves are kept once in an objects directory, by that
+ * hash. As most files are in every snapshot, and do not change between them, a snapshot usually
+ * costs little more than its JSON file. The contents are copied rather than hard linked, as the
+ * files in sources.list.d may well be edited in place later, which would change the snapshot too.
+ *
+ * Package lists which are removed along with a channel are moved in with the snapshot taken
+ * before the removal, so that reverting to it can put them back, rather than download them again.
+ */
+class SourcesSnapshot
+{
+public:
+    /**
+     * Where the helper keeps its snapshots
+     */
+    static QString storeDirectory();
+    /**
+     * How many snapshots the helper keeps
+     */
+    static int keepCount();
+
+    /**
+     * All the snapshots in a store, newest first
+     */
+    static QVector<SnapshotInfo> list(const QString& store);
+
+    /**
+     * Take a snapshot of sources.list.d and the keyrings directory. If they are exactly the way
+     * they were in the newest snapshot, no new one is taken, and that one is used instead.
+     *
+     * @param store The directory to keep the snapshot in
+     * @param sldDir The location of apt's sources.list.d
+     * @param keyringDir The directory keyrings are installed into
+     * @param error Set to why no snapshot could be taken, if none could
+     * @param profile The channel profile which is about to be switched to, if any
+     * @return The id of the snapshot, or an empty string if none could be taken
+     */
+    static QString take(const QString& store, const QString& sldDir, const QString& keyringDir, QString* error, const QString& profile = QString());
+
+    /**
+     * Note down which files the helper added to sources.list.d in the change a snapshot was taken
+     * for, so that reverting to it (or to any older one) knows they are ours to remove again
+     *
+     * @param store The directory the snapshot is kept in
+     * @param id The snapshot taken right before the change
+     * @param fileNames The names of the files in sources.list.d which the change added
+     * @return Whether they could be written into the snapshot
+     */
+    static bool recordInstalled(const QString& store, const QString& id, const QStringList& fileNames);
+
+    /**
+     * The files in sources.list.d which were not there when a snapshot was taken, split into those
+     * the helper added since (which reverting to the snapshot removes), and those which something
+     * else added (which reverting leaves alone)
+     *
+     * @param store The directory the snapshot is kept in
+     * @param id The snapshot to compare against
+     * @param sldDir The location of apt's sources.list.d
+     * @param byHelper Set to the names of the files the helper added since
+     * @param byOthers Set to the names of the files something else added since
+     */
+    static void addedSince(const QString& store, const QString& id, const QString& sldDir, QStringList* byHelper, QStringList* byOthers);
+
+    /**
+     * Whether a string looks like the id of a snapshot (that is, the time it was taken, possibly
+     * with a number on the end), and so cannot possibly name anything outside the store
+     */
+    static bool isValidId(const QString& id);
+
+    /**
+     * Add the steps for putting sources.list.d and the keyrings back the way they were when a
+     * snapshot was taken to two transactions. Files in sources.list.d which were not there are
+     * removed only if the helper added them since (see addedSince()), as anything else was put
+     * there by the user or some package, and is not ours to take away. Keyrings are only ever put
+     * back, never removed.
+     *
+     * Only snapshots which list() finds are restored, and only objects named by a SHA-256 are
+     * used, so whoever asks for a revert cannot make it read anything but the store. The files
+     * always go back into the directories given here, whatever the snapshot says it was taken of.
+     *
+     * @param store The directory the snapshot is kept in
+     * @param id The snapshot to go back to
+     * @param sldDir The location of apt's sources.list.d
+     * @param keyringDir The directory keyrings are installed into
+     * @param sources The transaction for sources.list.d
+     * @param keyrings The transaction for the keyrings directory
+     * @param removedFiles Set to the names of the files in sources.list.d which are removed or replaced
+     * @param addedFiles Set to the names of the files in sources.list.d which are added or replaced
+     * @param error Set to why the snapshot cannot be restored, if it cannot
+     * @return Whether the snapshot can be restored
+     */
+    static bool restore(const QString& store, const QString& id, const QString& sldDir, const QString& keyringDir, SourcesTransaction& sources, SourcesTransaction& keyrings, QStringList* removedFiles, QStringList* addedFiles, QString* error);
+
+    /**
+     * The directory package lists removed after a snapshot was taken are kept in
+     */
+    static QString listsDirectory(const QString& store, const QString& id);
+
+    /**
+     * Move the package lists kept with a snapshot back into apt's lists directory, leaving
+     * alone any which apt has downloaded again since
+     *
+     * @return The number of lists which were put back
+     */
+    static int restoreLists(const QString& store, const QString& id, const QString& listsDir);
+
+    /**
+     * Throw away all but the newest snapshots, and whatever they alone were keeping
+     */
+    static void prune(const QString& store, int keep);
+};
+
+#endif//SOURCESSNAPSHOT_H
@@ -0,0 +1,318 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SourcesTransaction.h"
+
+#include "Logging.h"
+
+#include <KLocalizedString>
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QVector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static bool renameFile(const QString& from, const QString& to)
+{
+    // QFile::rename will happily fall back to copying, which is exactly what we don't want
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+}
+
+// Like renameFile(), but never over an existing file. The check for the file is part of the
+// same system call, so nothing can sneak in between the two.
+static bool placeFile(const QString& from, const QString& to, bool* exists)
+{
+    *exists = false;
+    if(::link(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) != 0) {
+        *exists = errno == EEXIST;
+        return false;
+    }
+    ::unlink(QFile::encodeName(from).constData());
+    return true;
+}
+
+static bool syncPath(const QString& path)
+{
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        qCWarning(KCMREPOTOGGLE_HELPER) << "Could not open" << path << "to flush it to disk";
+        return false;
+    }
+    const bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+class SourcesTransaction::Private {
+public:
+    enum Operation {
+        InstallOperation,
+        ReplaceOperation,
+        RemoveOperation
+    };
+    struct Step {
+        Operation operation;
+        QString id;
+        QString source;
+        QString target;
+        QString staged;
+        QString backup;
+        bool backedUp = false;
+        bool placed = false;
+        QString result = QLatin1String("not-attempted");
+    };
+
+    Private(const QString& targetDir)
+        : targetDir(targetDir)
+        , staging(0)
+        , committed(false)
+    {}
+    ~Private()
+    {
+        delete staging;
+    }
+    QString targetDir;
+    QTemporaryDir* staging;
+    QVector<Step> steps;
+    QString error;
+    bool committed;
+
+    void fail(Step& step, const QString& message)
+    {
+        step.result = QLatin1String("failed");
+        error = message;
+    }
+
+    void undo()
+    {
+        for(int i = steps.count() - 1; i >= 0; --i) {
+            Step& step = steps[i];
+            if(step.operation == ReplaceOperation && step.placed && step.backedUp) {
+                // The old file can go straight back over the new one, so there is never a moment
+                // where there is no file at all
+                if(renameFile(step.backup, step.target)) {
+                    step.placed = false;
+                    step.backedUp = false;
+                }
+                else {
+                    qCWarning(KCMREPOTOGGLE_HELPER) << "Failed to restore" << step.target << "from" << step.backup << "while rolling back";
+                }
+            }
+            if(step.placed) {
+                // Installing never replaces anything, so there's nothing to put back
+                if(::unlink(QFile::encodeName(step.target).constData()) == 0) {
+                    step.placed = false;
+                }
+                else {
+                    qCWarning(KCMREPOTOGGLE_HELPER) << "Failed to take" << step.target << "back out again while rolling back";
+                }
+            }
+            if(step.backedUp) {
+                if(renameFile(step.backup, step.target)) {
+                    step.backedUp = false;
+                }
+                else {
+                    qCWarning(KCMREPOTOGGLE_HELPER) << "Failed to restore" << step.target << "from" << step.backup << "while rolling back";
+                }
+            }
+            if(step.result == QLatin1String("applied")) {
+                step.result = QLatin1String("rolled-back");
+            }
+        }
+        syncPath(targetDir);
+    }
+};
+
+SourcesTransaction::SourcesTransaction(const QString& targetDir)
+    : d(new Private(targetDir))
+{
+    while(d->targetDir.endsWith("/")) {
+        d->targetDir = d->targetDir.left(d->targetDir.length() - 1);
+    }
+}
+
+SourcesTransaction::~SourcesTransaction()
+{
+    delete d;
+}
+
+void SourcesTransaction::install(const QString& id, const QString& source, const QString& fileName)
+{
+    Private::Step step;
+    step.operation = Private::InstallOperation;
+    step.id = id;
+    step.source = source;
+    step.target = QString("%1/%2").arg(d->targetDir).arg(fileName);
+    d->steps << step;
+}
+
+void SourcesTransaction::replace(const QString& id, const QString& source, const QString& fileName)
+{
+    Private::Step step;
+    step.operation = Private::ReplaceOperation;
+    step.id = id;
+    step.source = source;
+    step.target = QString("%1/%2").arg(d->targetDir).arg(fileName);
+    d->steps << step;
+}
+
+void SourcesTransaction::remove(const QString& id, const QString& fileName)
+{
+    Private::Step step;
+    step.operation = Private::RemoveOperation;
+    step.id = id;
+    step.target = QString("%1/%2").arg(d->targetDir).arg(fileName);
+    d->steps << step;
+}
+
+bool SourcesTransaction::isEmpty() const
+{
+    return d->steps.isEmpty();
+}
+
+bool SourcesTransaction::commit()
+{
+    if(d->committed || d->steps.isEmpty()) {
+        return true;
+    }
+
+    // The staging directory lives inside the target directory, so the renames below are guaranteed
+    // to stay on one filesystem (and so be atomic). Apt ignores directories in sources.list.d.
+    d->staging = new QTemporaryDir(QString("%1/.kcmrepotoggle-XXXXXX").arg(d->targetDir));
+    if(!d->staging->isValid()) {
+        d->error = i18nc("Error string used when the temporary directory used for applying changes to software channels could not be created", "Failed to create a staging directory in %1", d->targetDir);
+        return false;
+    }
+
+    // First put everything we need in place without touching anything apt can see
+    for(int i = 0; i < d->steps.count(); ++i) {
+        Private::Step& step = d->steps[i];
+        step.backup = QString("%1/%2.old").arg(d->staging->path()).arg(i);
+        switch(step.operation) {
+        case Private::InstallOperation:
+            step.staged = QString("%1/%2.new").arg(d->staging->path()).arg(i);
+            if(QFile::exists(step.target) || !QFile::copy(step.source, step.staged)) {
+                d->fail(step, i18nc("Error string used when a software channel could not be enabled because the file representing it could not be copied to the apt sources lists directory", "Failed to enable %1 - could not copy it to %2", step.id, step.target));
+                return false;
+            }
+            break;
+        case Private::ReplaceOperation:
+            step.staged = QString("%1/%2.new").arg(d->staging->path()).arg(i);
+            if(!QFile::exists(step.target) || !QFile::copy(step.source, step.staged)) {
+                d->fail(step, i18nc("Error string used when a software channel could not replace the file with the same name in the apt sources lists directory", "Failed to replace %1 with %2", step.target, step.id));
+                return false;
+            }
+            break;
+        case Private::RemoveOperation:
+            if(!QFile::exists(step.target)) {
+                d->fail(step, i18nc("Error string used when a software channel could not be removed because the file representing it could not be deleted", "Failed to disable %1 - could not remove the file %2", step.id, step.target));
+                return false;
+            }
+            break;
+        }
+    }
+    // Each of the staged files needs to be on disk before it can take the place of anything. Only
+    // these files are flushed, rather than the whole filesystem, so a small change does not have
+    // to wait for everything else which happens to be waiting to be written.
+    for(int i = 0; i < d->steps.count(); ++i) {
+        Private::Step& step = d->steps[i];
+        if(!step.staged.isEmpty() && !syncPath(step.staged)) {
+            d->fail(step, i18nc("Error string used when a file for a software channel could not be written to disk before putting it in place", "Failed to write %1 to disk", step.staged));
+            return false;
+        }
+    }
+
+    // Now swap things over, which is only renames and links from here on
+    for(int i = 0; i < d->steps.count(); ++i) {
+        Private::Step& step = d->steps[i];
+        bool exists = false;
+        switch(step.operation) {
+        case Private::InstallOperation:
+            step.placed = placeFile(step.staged, step.target, &exists);
+            if(exists) {
+                d->fail(step, i18nc("Error string used when a software channel could not be enabled because a file by the same name appeared in the apt sources lists directory while enabling it", "Failed to enable %1 - %2 was created by something else in the meantime", step.id, step.target));
+            }
+            else if(!step.placed) {
+                d->fail(step, i18nc("Error string used when a software channel could not be enabled because the file representing it could not be copied to the apt sources lists directory", "Failed to enable %1 - could not copy it to %2", step.id, step.target));
+            }
+            break;
+        case Private::ReplaceOperation:
+            // Keep the old file around under a second name, and then swap the new one over it in
+            // one go, so apt sees either the old file or the new one, and nothing in between
+            step.backedUp = ::link(QFile::encodeName(step.target).constData(), QFile::encodeName(step.backup).constData()) == 0;
+            step.placed = step.backedUp && renameFile(step.staged, step.target);
+            if(!step.placed) {
+                if(step.backedUp && ::unlink(QFile::encodeName(step.backup).constData()) == 0) {
+                    step.backedUp = false;
+                }
+                d->fail(step, i18nc("Error string used when a software channel could not replace the file with the same name in the apt sources lists directory", "Failed to replace %1 with %2", step.target, step.id));
+            }
+            break;
+        case Private::RemoveOperation:
+            step.backedUp = renameFile(step.target, step.backup);
+            if(!step.backedUp) {
+                d->fail(step, i18nc("Error string used when a software channel could not be removed because the file representing it could not be deleted", "Failed to disable %1 - could not remove the file %2", step.id, step.target));
+            }
+            break;
+        }
+        if(step.result == QLatin1String("failed")) {
+            d->undo();
+            return false;
+        }
+        step.result = QLatin1String("applied");
+    }
+    syncPath(d->targetDir);
+    d->committed = true;
+    return true;
+}
+
+bool SourcesTransaction::rollback()
+{
+    if(!d->committed) {
+        return false;
+    }
+    d->undo();
+    d->committed = false;
+    for(const Private::Step& step : d->steps) {
+        if(step.placed || step.backedUp) {
+            d->error = i18nc("Error string used when changes to the software channels could not be completely undone", "Failed to restore the previous state of %1", step.target);
+            return false;
+        }
+    }
+    return true;
+}
+
+QVariantMap SourcesTransaction::results() const
+{
+    QVariantMap results;
+    for(const Private::Step& step : d->steps) {
+        results[step.id] = step.result;
+    }
+    return results;
+}
+
+QString SourcesTransaction::errorString() const
+{
+    return d->error;
+}
@@ -0,0 +1,110 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SOURCESTRANSACTION_H
+#define SOURCESTRANSACTION_H
+
+#include <QString>
+#include <QVariantMap>
+
+/**
+ * A batch of changes to the files in a directory (sources.list.d, in our case), applied
+ * as a whole or not at all.
+ *
+ * New files are first copied to a staging directory inside the target directory (and so
+ * on the same filesystem), and each of them flushed to disk. Only then are they moved into
+ * place with rename() (or link(), for new files, so they never overwrite a file which
+ * appeared in the meantime), and files which are to be removed are moved out of the way into the
+ * staging directory rather than deleted. If anything fails along the way, every step which
+ * was already taken is undone again, so apt never gets to see a half-changed setup.
+ */
+class SourcesTransaction
+{
+public:
+    /**
+     * @param targetDir The directory which the changes should be applied to
+     */
+    explicit SourcesTransaction(const QString& targetDir);
+    /**
+     * Destructor. This throws away the staging directory, so a committed transaction can no
+     * longer be rolled back after this.
+     */
+    ~SourcesTransaction();
+
+    /**
+     * Copy source into the target directory as fileName. This fails if a file by that name
+     * already exists.
+     *
+     * @param id What to report the result for this step as in results()
+     * @param source The file to copy
+     * @param fileName The name the file should have in the target directory
+     */
+    void install(const QString& id, const QString& source, const QString& fileName);
+
+    /**
+     * Copy source into the target directory as fileName, in place of the file which is already
+     * there by that name. This fails if there is no such file. Rolling back puts the old one back.
+     *
+     * @param id What to report the result for this step as in results()
+     * @param source The file to copy
+     * @param fileName The name of the file in the target directory
+     */
+    void replace(const QString& id, const QString& source, const QString& fileName);
+
+    /**
+     * Remove fileName from the target directory. This fails if there is no such file.
+     *
+     * @param id What to report the result for this step as in results()
+     * @param fileName The name of the file in the target directory
+     */
+    void remove(const QString& id, const QString& fileName);
+
+    /**
+     * Whether there are no changes in the transaction at all
+     */
+    bool isEmpty() const;
+
+    /**
+     * Apply all the changes. If this returns false, nothing has been changed, and
+     * errorString() will say why.
+     */
+    bool commit();
+
+    /**
+     * Undo all the changes of a committed transaction
+     */
+    bool rollback();
+
+    /**
+     * The result of each step, by the id it was added with: one of "applied", "failed",
+     * "rolled-back" or "not-attempted"
+     */
+    QVariantMap results() const;
+
+    /**
+     * A human readable description of what went wrong, if anything did
+     */
+    QString errorString() const;
+private:
+    class Private;
+    Private* d;
+};
+
+#endif//SOURCESTRANSACTION_H
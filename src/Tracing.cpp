@@ -0,0 +1,148 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Tracing.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+static QMutex traceMutex;
+static bool collecting = false;
+static QVariantList pendingRecords;
+
+static QString traceFile()
+{
+    static const QString fileName = QFile::decodeName(qgetenv("KCMREPOTOGGLE_TRACE"));
+    return fileName;
+}
+
+// Each event goes on a line of its own, after the opening bracket. The closing bracket is
+// optional in the trace event format, so the file is valid however many processes wrote to it,
+// and whenever they stopped.
+static void writeEvent(const QJsonObject& event)
+{
+    QFile file(traceFile());
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return;
+    }
+    if(file.size() == 0) {
+        file.write("[\n");
+    }
+    file.write(QJsonDocument(event).toJson(QJsonDocument::Compact) + ",\n");
+}
+
+static QJsonObject event(const QString& name, const QString& category, qint64 start, qint64 duration, qint64 pid, qint64 tid)
+{
+    QJsonObject object;
+    object[QLatin1String("name")] = name;
+    object[QLatin1String("cat")] = category;
+    object[QLatin1String("ph")] = QLatin1String("X");
+    object[QLatin1String("ts")] = double(start);
+    object[QLatin1String("dur")] = double(duration);
+    object[QLatin1String("pid")] = double(pid);
+    object[QLatin1String("tid")] = double(tid);
+    return object;
+}
+
+bool Tracing::isEnabled()
+{
+    return !traceFile().isEmpty();
+}
+
+qint64 Tracing::now()
+{
+    return QDateTime::currentMSecsSinceEpoch() * 1000;
+}
+
+void Tracing::record(const QLoggingCategory& category, const QString& name, qint64 start, qint64 duration)
+{
+    qCDebug(category).nospace().noquote() << "timing name=" << name << " duration_ms=" << QString::number(double(duration) / 1000.0, 'f', 3);
+
+    const QString categoryName = QString::fromLatin1(category.categoryName());
+    QMutexLocker locker(&traceMutex);
+    if(collecting) {
+        QVariantMap record;
+        record[QLatin1String("name")] = name;
+        record[QLatin1String("category")] = categoryName;
+        record[QLatin1String("start")] = start;
+        record[QLatin1String("duration")] = duration;
+        record[QLatin1String("pid")] = QCoreApplication::applicationPid();
+        pendingRecords << record;
+    }
+    if(isEnabled()) {
+        writeEvent(event(name, categoryName, start, duration, QCoreApplication::applicationPid(), qint64(quintptr(QThread::currentThreadId()))));
+    }
+}
+
+void Tracing::setCollecting(bool collect)
+{
+    QMutexLocker locker(&traceMutex);
+    collecting = collect;
+}
+
+QVariantList Tracing::takeRecords()
+{
+    QMutexLocker locker(&traceMutex);
+    QVariantList records = pendingRecords;
+    pendingRecords.clear();
+    return records;
+}
+
+void Tracing::addRecords(const QVariantList& records, const QString& process)
+{
+    if(!isEnabled() || records.isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&traceMutex);
+    const qint64 pid = records.first().toMap().value(QLatin1String("pid")).toLongLong();
+    QJsonObject name;
+    name[QLatin1String("name")] = QLatin1String("process_name");
+    name[QLatin1String("ph")] = QLatin1String("M");
+    name[QLatin1String("pid")] = double(pid);
+    QJsonObject args;
+    args[QLatin1String("name")] = process;
+    name[QLatin1String("args")] = args;
+    writeEvent(name);
+    for(const QVariant& value : records) {
+        const QVariantMap record = value.toMap();
+        writeEvent(event(record.value(QLatin1String("name")).toString(), record.value(QLatin1String("category")).toString(),
+                         record.value(QLatin1String("start")).toLongLong(), record.value(QLatin1String("duration")).toLongLong(),
+                         record.value(QLatin1String("pid")).toLongLong(), 0));
+    }
+}
+
+ScopedTimer::ScopedTimer(const QLoggingCategory& category, const QString& name)
+    : category(category)
+    , name(name)
+    , start(Tracing::now())
+{
+    timer.start();
+}
+
+ScopedTimer::~ScopedTimer()
+{
+    Tracing::record(category, name, start, timer.nsecsElapsed() / 1000);
+}
@@ -0,0 +1,95 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QVariantList>
+
+/**
+ * Records of how long things took. Each record is logged as a debug message in its category,
+ * in the form "timing name=<name> duration_ms=<duration>", and can also be collected, which is
+ * how the helper sends its records back to the module.
+ *
+ * If the KCMREPOTOGGLE_TRACE environment variable is set to the name of a file, records are
+ * also appended to that file in the Chrome trace event format, which can be loaded straight
+ * into chrome://tracing or Perfetto. The helper's records are written by the module, as the
+ * helper neither sees our environment nor should it be writing files on our behalf.
+ */
+class Tracing
+{
+public:
+    /**
+     * Whether records are being written to a trace file
+     */
+    static bool isEnabled();
+
+    /**
+     * Record that something took a while
+     *
+     * @param category The category to log the record in
+     * @param name What it was that took a while
+     * @param start When it started, in microseconds since the epoch
+     * @param duration How long it took, in microseconds
+     */
+    static void record(const QLoggingCategory& category, const QString& name, qint64 start, qint64 duration);
+
+    /**
+     * The current time, in microseconds since the epoch, for passing to record() as the start
+     */
+    static qint64 now();
+
+    /**
+     * Whether to keep records for takeRecords(). This is off by default.
+     */
+    static void setCollecting(bool collect);
+
+    /**
+     * All records collected so far, which are then forgotten. This is what the helper sends back.
+     */
+    static QVariantList takeRecords();
+
+    /**
+     * Write records made by another process (that is, the helper) to the trace file
+     *
+     * @param records The records, as returned by takeRecords() in the other process
+     * @param process A name to show the records under
+     */
+    static void addRecords(const QVariantList& records, const QString& process);
+};
+
+/**
+ * Records how long it is between the timer being created and it going out of scope
+ */
+class ScopedTimer
+{
+public:
+    ScopedTimer(const QLoggingCategory& category, const QString& name);
+    ~ScopedTimer();
+private:
+    const QLoggingCategory& category;
+    QString name;
+    qint64 start;
+    QElapsedTimer timer;
+};
+
+#endif//TRACING_H
@@ -0,0 +1,550 @@
+/*
+  Copyright (C) 2017 Dan Leinir Turthra Jensen <admin@leinir.dk>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of
+  the License or (at your option) version 3 or any later version
+  accepted by the membership of KDE e.V. (or its successor approved
+  by the membership of KDE e.V.), which shall act as a proxy
+  defined in Section 14 of version 3 of the license.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "AptConfig.h"
+#include "ChangePlan.h"
+#include "ChannelManifest.h"
+#include "ChannelProfile.h"
+#include "ChannelScanner.h"
+#include "ChannelVerifier.h"
+#include "HelperAction.h"
+#include "OSRelease.h"
+#include "ReleaseValidator.h"
+#include "SourcesSnapshot.h"
+#include "SourcesTransaction.h"
+#include "Version.h"
+
+#include <KAuth/KAuthExecuteJob>
+#include <KLocalizedString>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QTextStream>
+
+static QTextStream& out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+static QTextStream& err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+static QString stateName(const Channel& channel)
+{
+    if(channel.conflict) {
+        return QLatin1String("conflict");
+    }
+    return channel.state == Qt::Checked ? QLatin1String("enabled") : QLatin1String("disabled");
+}
+
+static QJsonObject toJson(const Channel& channel)
+{
+    QJsonObject object;
+    object[QLatin1String("name")] = channel.fileName;
+    object[QLatin1String("path")] = channel.path;
+    object[QLatin1String("title")] = channel.title;
+    object[QLatin1String("description")] = channel.description;
+    object[QLatin1String("state")] = stateName(channel);
+    if(!channel.installedPath.isEmpty()) {
+        object[QLatin1String("installedPath")] = channel.installedPath;
+    }
+    if(channel.conflict) {
+        object[QLatin1String("channelOnlyEntries")] = QJsonArray::fromStringList(channel.channelOnlyEntries);
+        object[QLatin1String("installedOnlyEntries")] = QJsonArray::fromStringList(channel.installedOnlyEntries);
+    }
+    return object;
+}
+
+static void printChannels(const QVector<Channel>& channels, bool json)
+{
+    if(json) {
+        QJsonArray array;
+        for(const Channel& channel : channels) {
+            array << toJson(channel);
+        }
+        out() << QJsonDocument(array).toJson();
+        return;
+    }
+    for(const Channel& channel : channels) {
+        out() << QString("%1\t%2\t%3").arg(stateName(channel), -9).arg(channel.fileName).arg(channel.title) << endl;
+    }
+}
+
+static void printResults(bool success, const QVariantMap& results, const QString& error, bool json)
+{
+    if(json) {
+        QJsonObject object;
+        object[QLatin1String("success")] = success;
+        object[QLatin1String("results")] = QJsonObject::fromVariantMap(results);
+        if(!success) {
+            object[QLatin1String("error")] = error;
+        }
+        out() << QJsonDocument(object).toJson();
+        return;
+    }
+    for(QVariantMap::const_iterator it = results.constBegin(); it != results.constEnd(); ++it) {
+        out() << it.value().toString() << '\t' << it.key() << endl;
+    }
+    if(!success) {
+        err() << error << endl;
+    }
+}
+
+static void printPlan(const QVector<PlannedChange>& plan, bool json)
+{
+    if(json) {
+        QJsonArray array;
+        for(const PlannedChange& change : plan) {
+            QJsonObject object;
+            object[QLatin1String("operation")] = ChangePlan::operationName(change.operation);
+            object[QLatin1String("channel")] = change.channelPath;
+            object[QLatin1String("target")] = change.targetPath;
+            array << object;
+        }
+        out() << QJsonDocument(array).toJson();
+        return;
+    }
+    for(const PlannedChange& change : plan) {
+        out() << QString("%1\t%2").arg(ChangePlan::operationName(change.operation), -9).arg(ChangePlan::describe(change)) << endl;
+    }
+}
+
+/**
+ * Find the channel the user meant, which may be given by its path, the name of its
+ * lists file, or its title, in that order of preference.
+ */
+static const Channel* findChannel(const QVector<Channel>& channels, const QString& name, QString* error)
+{
+    QVector<const Channel*> byFileName;
+    QVector<const Channel*> byTitle;
+    for(const Channel& channel : channels) {
+        if(channel.path == name) {
+            return &channel;
+        }
+        if(channel.fileName == name) {
+            byFileName << &channel;
+        }
+        else if(channel.title == name) {
+            byTitle << &channel;
+        }
+    }
+    const QVector<const Channel*>& found = byFileName.isEmpty() ? byTitle : byFileName;
+    if(found.count() == 1) {
+        return found.first();
+    }
+    if(found.isEmpty()) {
+        *error = i18nc("Error in the command line tool when no channel matches what the user asked for", "There is no channel called %1", name);
+    }
+    else {
+        QStringList paths;
+        for(const Channel* channel : found) {
+            paths << channel->path;
+        }
+        *error = i18nc("Error in the command line tool when more than one channel matches what the user asked for, followed by the paths of the matching channels", "More than one channel is called %1, please use one of these instead: %2", name, paths.join(QLatin1String(", ")));
+    }
+    return 0;
+}
+
+/**
+ * Report how long something took, when asked to. The times go to stderr, so they do not get
+ * mixed up with the output proper (and in particular do not break the JSON).
+ */
+static void reportTime(bool enabled, const QString& what, QElapsedTimer& timer, int items = -1)
+{
+    if(!enabled) {
+        return;
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+    err() << QString("%1: %2 ms").arg(what).arg(double(elapsed) / 1000000.0, 0, 'f', 3);
+    if(items > 0) {
+        err() << QString(" (%1 items, %2 us each)").arg(items).arg(double(elapsed) / 1000.0 / items, 0, 'f', 3);
+    }
+    err() << endl;
+    timer.restart();
+}
+
+/**
+ * Run the helper, and wait for it to finish
+ */
+static int runHelper(KAuth::Action& action, bool json)
+{
+    KAuth::ExecuteJob* job = action.execute();
+    if(!json) {
+        QObject::connect(job, &KAuth::ExecuteJob::newData, [](const QVariantMap& data){
+            if(data.contains(QLatin1String("uri"))) {
+                err() << data.value(QLatin1String("uri")).toString() << ' ' << data.value(QLatin1String("item")).toString() << ": " << data.value(QLatin1String("itemStatus")).toString() << endl;
+            }
+        });
+    }
+    const bool success = job->exec();
+
+    printResults(success, job->data().value(QLatin1String("results")).toMap(), job->errorString(), json);
+    return success ? 0 : 1;
+}
+
+/**
+ * Apply changes straight to a sources.list.d which is not the system one, and so needs
+ * no privileges. This is the same transaction the helper uses, minus the index refresh.
+ */
+static bool applyDirectly(const QString& sldDir, const QVariantMap& changes, QVariantMap* results, QString* error)
+{
+    SourcesTransaction transaction(sldDir);
+    for(QVariantMap::const_iterator it = changes.constBegin(); it != changes.constEnd(); ++it) {
+        const QString fileName = it.key().split("/").last();
+        if(it.value().toInt() == Qt::Checked) {
+            transaction.install(it.key(), it.key(), fileName);
+        }
+        else if(it.value().toInt() == HelperAction::ReplaceInstalled) {
+            transaction.replace(it.key(), it.key(), fileName);
+        }
+        else {
+            transaction.remove(it.key(), fileName);
+        }
+    }
+    const bool committed = transaction.commit();
+    *results = transaction.results();
+    *error = transaction.errorString();
+    return committed;
+}
+
+/**
+ * Check the repositories of the channels about to be enabled, the same way the helper does,
+ * but right here. This is what happens when changing a sources.list.d other than the system
+ * one, which is handy for trying it out against a repository on disk, or on the loopback.
+ */
+static QStringList validateDirectly(const QVariantMap& changes, const QStringList& channelDirs)
+{
+    QVector<SourceEntry> entries;
+    QHash<QString, QString> keyrings;
+    for(QVariantMap::const_iterator it = changes.constBegin(); it != changes.constEnd(); ++it) {
+        if(it.value().toInt() != Qt::Checked && it.value().toInt() != HelperAction::ReplaceInstalled) {
+            continue;
+        }
+        VerifiedChannel verified;
+        QString error;
+        if(!ChannelVerifier::verify(it.key(), channelDirs, &verified, &error)) {
+            return QStringList() << error;
+        }
+        if(!verified.keyring.isEmpty()) {
+            keyrings.insert(verified.keyringTarget, verified.keyring);
+        }
+        entries << SourcesParser::parseFile(verified.path);
+    }
+    return ReleaseValidator::validate(entries, AptConfig::architectures(), keyrings);
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QLatin1String("repotoggle"));
+    app.setApplicationVersion(QLatin1String(global_s_versionStringFull));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(i18nc("Description of the command line tool", "Switch software channels on and off"));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument(QLatin1String("command"), i18nc("Help text for the command argument of the command line tool", "One of list, status, enable, disable, apply, manifest, profiles, profile, save-profile, snapshots or revert"));
+    parser.addPositionalArgument(QLatin1String("channels"), i18nc("Help text for the channels argument of the command line tool", "The channels to enable or disable, by path, file name or title, the directory to write the manifest for, the name of the profile to switch to or save, or the snapshot to revert to"), QLatin1String("[channels...]"));
+    QCommandLineOption jsonOption(QLatin1String("json"), i18nc("Help text for a command line option", "Write the output as JSON"));
+    QCommandLineOption enableOption(QLatin1String("enable"), i18nc("Help text for a command line option", "Enable this channel (apply only, may be given more than once)"), QLatin1String("channel"));
+    QCommandLineOption disableOption(QLatin1String("disable"), i18nc("Help text for a command line option", "Disable this channel (apply only, may be given more than once)"), QLatin1String("channel"));
+    QCommandLineOption refreshOption(QLatin1String("refresh"), i18nc("Help text for a command line option", "Refresh the package lists of the changed channels afterwards"));
+    QCommandLineOption fullRefreshOption(QLatin1String("full-refresh"), i18nc("Help text for a command line option", "Refresh the package lists of all sources afterwards"));
+    QCommandLineOption sourcesDirOption(QLatin1String("sources-dir"), i18nc("Help text for a command line option", "Use this directory instead of apt's sources.list.d, and change it directly rather than through the system helper"), QLatin1String("directory"));
+    QCommandLineOption channelsDirOption(QLatin1String("channels-dir"), i18nc("Help text for a command line option", "Look for channels in this directory instead of the usual ones (may be given more than once, and changes can then only be applied with --sources-dir)"), QLatin1String("directory"));
+    QCommandLineOption timingOption(QLatin1String("timing"), i18nc("Help text for a command line option", "Write how long each step took to standard error"));
+    QCommandLineOption dryRunOption(QLatin1String("dry-run"), i18nc("Help text for a command line option", "Only show what would be changed, without changing anything"));
+    QCommandLineOption validateOption(QLatin1String("validate"), i18nc("Help text for a command line option", "Check that the repositories of the channels to enable work before changing anything"));
+    parser.addOptions({jsonOption, enableOption, disableOption, refreshOption, fullRefreshOption, sourcesDirOption, channelsDirOption, timingOption, dryRunOption, validateOption});
+    parser.process(app);
+
+    const QStringList positional = parser.positionalArguments();
+    if(positional.isEmpty()) {
+        parser.showHelp(2);
+    }
+    const QString command = positional.first();
+    const bool json = parser.isSet(jsonOption);
+    const bool timing = parser.isSet(timingOption);
+
+    if(command == QLatin1String("manifest")) {
+        // For use when packaging channels, so this has nothing to do with the scan at all
+        if(positional.count() != 2) {
+            parser.showHelp(2);
+        }
+        const QString directory = positional.at(1);
+        QSaveFile file(QString("%1/%2").arg(directory).arg(ChannelManifest::fileName()));
+        if(!file.open(QIODevice::WriteOnly) || file.write(ChannelManifest::generate(directory)) < 0 || !file.commit()) {
+            err() << i18nc("Error in the command line tool when the manifest file could not be written, followed by the reason", "Could not write %1: %2", file.fileName(), file.errorString()) << endl;
+            return 1;
+        }
+        return 0;
+    }
+    if(command == QLatin1String("profiles")) {
+        const QVector<ChannelProfile> profiles = ChannelProfiles::load();
+        if(json) {
+            QJsonArray array;
+            for(const ChannelProfile& profile : profiles) {
+                QJsonObject object;
+                object[QLatin1String("name")] = profile.name;
+                object[QLatin1String("title")] = profile.title;
+                object[QLatin1String("description")] = profile.description;
+                object[QLatin1String("path")] = profile.path;
+                object[QLatin1String("channels")] = QJsonArray::fromStringList(profile.channels);
+                array << object;
+            }
+            out() << QJsonDocument(array).toJson();
+            return 0;
+        }
+        for(const ChannelProfile& profile : profiles) {
+            out() << QString("%1\t%2").arg(profile.name).arg(profile.title) << endl;
+        }
+        return 0;
+    }
+    if((command == QLatin1String("profile") || command == QLatin1String("save-profile")) && positional.count() != 2) {
+        parser.showHelp(2);
+    }
+
+    const bool localSources = parser.isSet(sourcesDirOption);
+    if(localSources && (parser.isSet(refreshOption) || parser.isSet(fullRefreshOption))) {
+        err() << i18nc("Error in the command line tool when asked to refresh the package indexes for a sources.list.d other than the system one", "The package indexes can only be refreshed for the system's own sources") << endl;
+        return 2;
+    }
+
+    // Snapshots are only ever taken by the helper, of the system's own sources
+    if(command == QLatin1String("snapshots")) {
+        const QVector<SnapshotInfo> snapshots = SourcesSnapshot::list(SourcesSnapshot::storeDirectory());
+        if(json) {
+            QJsonArray array;
+            for(const SnapshotInfo& snapshot : snapshots) {
+                QJsonObject object;
+                object[QLatin1String("id")] = snapshot.id;
+                object[QLatin1String("created")] = snapshot.created.toString(Qt::ISODate);
+                object[QLatin1String("sources")] = QJsonArray::fromStringList(snapshot.sources);
+                object[QLatin1String("hasLists")] = snapshot.hasLists;
+                if(!snapshot.profile.isEmpty()) {
+                    object[QLatin1String("profile")] = snapshot.profile;
+                }
+                array << object;
+            }
+            out() << QJsonDocument(array).toJson();
+            return 0;
+        }
+        for(const SnapshotInfo& snapshot : snapshots) {
+            out() << QString("%1\t%2\t%3\t%4").arg(snapshot.id, snapshot.created.toLocalTime().toString(Qt::ISODate), snapshot.profile, snapshot.sources.join(QLatin1String(", "))) << endl;
+        }
+        return 0;
+    }
+    if(command == QLatin1String("revert")) {
+        if(positional.count() > 2 || localSources || parser.isSet(fullRefreshOption)) {
+            parser.showHelp(2);
+        }
+        // With no snapshot given, the helper goes back to the newest one
+        KAuth::Action action(HelperAction::actionName());
+        HelperAction::prepareRevert(action, positional.value(1), parser.isSet(refreshOption));
+        return runHelper(action, json);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    if(timing) {
+        // This is cached for the scan to pick up, but on its own it is a lot easier
+        // to see how much it costs
+        const OSRelease os = OSRelease::current();
+        reportTime(timing, QString("os-release (%1)").arg(os.id), timer);
+    }
+
+    ChannelScanState state;
+    if(localSources || parser.isSet(channelsDirOption)) {
+        // None of this is what the module would see, so keep it out of the cache
+        const QString sldDir = localSources ? parser.value(sourcesDirOption) : AptConfig::sourcePartsDirectory();
+        const QStringList channelDirs = parser.isSet(channelsDirOption) ? parser.values(channelsDirOption) : ChannelScanner::channelDirectories();
+        state = ChannelScanner::scan(sldDir, channelDirs, false);
+    }
+    else {
+        state = ChannelScanner::scan(AptConfig::sourcePartsDirectory());
+    }
+    int scannedFiles = state.installed.count();
+    for(const ScannedDirectory& directory : state.channelFiles) {
+        scannedFiles += directory.count();
+    }
+    reportTime(timing, QLatin1String("scan"), timer, scannedFiles);
+
+    const QVector<Channel> channels = ChannelScanner::channels(state);
+    reportTime(timing, QLatin1String("compare"), timer, channels.count());
+
+    if(command == QLatin1String("list")) {
+        printChannels(channels, json);
+        return 0;
+    }
+    if(command == QLatin1String("status")) {
+        // Only the things which are actually in effect, or in the way
+        QVector<Channel> active;
+        for(const Channel& channel : channels) {
+            if(channel.state == Qt::Checked || channel.conflict) {
+                active << channel;
+            }
+        }
+        printChannels(active, json);
+        return 0;
+    }
+
+    if(command == QLatin1String("save-profile")) {
+        QString error;
+        if(!ChannelProfiles::save(ChannelProfiles::fromChannels(positional.at(1), positional.at(1), channels), &error)) {
+            err() << error << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Work out everything that needs changing before asking the helper to do anything, so that
+    // all of it happens in one go (and with one authentication, and at most one refresh)
+    QVariantMap changes;
+    QStringList toEnable;
+    QStringList toDisable;
+    QString profileName;
+    if(command == QLatin1String("profile")) {
+        const QVector<ChannelProfile> profiles = ChannelProfiles::load();
+        const ChannelProfile* profile = ChannelProfiles::find(profiles, positional.at(1));
+        if(!profile) {
+            err() << i18nc("Error in the command line tool when asked for a channel profile which does not exist", "There is no profile called %1", positional.at(1)) << endl;
+            return 1;
+        }
+        profileName = profile->name;
+        QStringList missing;
+        changes = ChannelProfiles::changes(*profile, channels, &missing);
+        for(const QString& name : missing) {
+            err() << i18nc("Warning in the command line tool when a channel profile names a channel which does not exist", "The profile %1 includes %2, which is not an available channel", profile->name, name) << endl;
+        }
+    }
+    else if(command == QLatin1String("enable")) {
+        toEnable = positional.mid(1);
+    }
+    else if(command == QLatin1String("disable")) {
+        toDisable = positional.mid(1);
+    }
+    else if(command == QLatin1String("apply")) {
+        toEnable = parser.values(enableOption);
+        toDisable = parser.values(disableOption);
+    }
+    else {
+        err() << i18nc("Error in the command line tool when given a command it does not know", "Unknown command %1", command) << endl;
+        parser.showHelp(2);
+    }
+
+    QString error;
+    for(const QString& name : toEnable) {
+        const Channel* channel = findChannel(channels, name, &error);
+        if(!channel) {
+            err() << error << endl;
+            return 1;
+        }
+        if(channel->conflict) {
+            err() << i18nc("Error in the command line tool when trying to enable a channel which conflicts with an installed file", "Cannot enable %1, as %2 already exists with different contents", channel->path, channel->installedPath) << endl;
+            return 1;
+        }
+        if(channel->state != Qt::Checked) {
+            changes[channel->path] = Qt::Checked;
+        }
+    }
+    for(const QString& name : toDisable) {
+        const Channel* channel = findChannel(channels, name, &error);
+        if(!channel) {
+            err() << error << endl;
+            return 1;
+        }
+        if(changes.contains(channel->path)) {
+            err() << i18nc("Error in the command line tool when asked to both enable and disable a channel", "Cannot both enable and disable %1", channel->path) << endl;
+            return 1;
+        }
+        // The installed file is not the channel's, so it is not ours to remove
+        if(channel->conflict) {
+            err() << i18nc("Error in the command line tool when trying to disable a channel which conflicts with an installed file", "Cannot disable %1, as %2 has different contents, and was not installed from it", channel->path, channel->installedPath) << endl;
+            return 1;
+        }
+        if(channel->state == Qt::Checked) {
+            changes[channel->path] = Qt::Unchecked;
+        }
+    }
+    // The scan told us what to ask for, but sources.list.d may have changed since, so look
+    // at what it would take right now, and only ever ask for that
+    timer.restart();
+    const QVector<PlannedChange> plan = ChangePlan::compute(state.sldDir, changes);
+    reportTime(timing, QLatin1String("plan"), timer, plan.count());
+    if(parser.isSet(dryRunOption)) {
+        printPlan(plan, json);
+        return 0;
+    }
+    for(const PlannedChange& change : plan) {
+        if(change.operation == PlannedChange::Blocked) {
+            err() << ChangePlan::describe(change) << endl;
+            return 1;
+        }
+    }
+    changes = ChangePlan::helperChanges(plan);
+    if(changes.isEmpty()) {
+        if(!json) {
+            out() << i18nc("Message from the command line tool when all the channels are already in the requested state", "Nothing to do") << endl;
+        }
+        return 0;
+    }
+
+    if(localSources) {
+        if(parser.isSet(validateOption)) {
+            timer.restart();
+            const QStringList problems = validateDirectly(changes, state.channelDirs);
+            reportTime(timing, QLatin1String("validate"), timer, changes.count());
+            if(!problems.isEmpty()) {
+                for(const QString& problem : problems) {
+                    err() << problem << endl;
+                }
+                return 1;
+            }
+        }
+        QVariantMap results;
+        QString error;
+        timer.restart();
+        const bool success = applyDirectly(state.sldDir, changes, &results, &error);
+        reportTime(timing, QLatin1String("apply"), timer, changes.count());
+        printResults(success, results, error, json);
+        return success ? 0 : 1;
+    }
+
+    // The helper only ever installs channels from the usual directories
+    if(parser.isSet(channelsDirOption)) {
+        err() << i18nc("Error in the command line tool when asked to change the system's sources using channels from a directory the system helper does not accept", "Channels from other directories can only be applied to a directory given with --sources-dir") << endl;
+        return 2;
+    }
+    KAuth::Action action(HelperAction::actionName());
+    HelperAction::prepare(action, changes, parser.isSet(refreshOption) || parser.isSet(fullRefreshOption), parser.isSet(fullRefreshOption), parser.isSet(validateOption));
+    if(!profileName.isEmpty()) {
+        HelperAction::setProfile(action, profileName);
+    }
+    return runHelper(action, json);
+}